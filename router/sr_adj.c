@@ -0,0 +1,115 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_adj.c
+ *
+ * Description:
+ *
+ * Adjacency table, see sr_adj.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include "sr_adj.h"
+#include "sr_arpcache.h"
+#include "sr_protocol.h"
+
+/* caller holds the cache lock */
+static void sr_adj_set(struct sr_adj* adj, const unsigned char* mac)
+{
+    __atomic_store_n(&(adj->seq), adj->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (mac)
+    { memcpy(adj->l2, mac, ETHER_ADDR_LEN); }
+    adj->valid = mac != 0;
+    __atomic_store_n(&(adj->seq), adj->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_adj_get(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_adj* sr_adj_get(struct sr_arpcache* cache, int ifindex,
+                          const unsigned char* shost, uint32_t ip)
+{
+    struct sr_adj* adj = 0;
+    uint16_t type = htons(ethertype_ip);
+    unsigned int i;
+
+    /* REQUIRES */
+    assert(cache);
+    assert(shost);
+
+    pthread_mutex_lock(&(cache->lock));
+
+    for (i = 0; i < cache->nadj; i++)
+    {
+        if (cache->adj[i].ip == ip && cache->adj[i].ifindex == ifindex)
+        {
+            adj = &(cache->adj[i]);
+            break;
+        }
+    }
+
+    if (!adj && cache->nadj < SR_ADJ_MAX)
+    {
+        adj = &(cache->adj[cache->nadj++]);
+        memset(adj, 0, sizeof(struct sr_adj));
+        adj->ip = ip;
+        adj->ifindex = ifindex;
+        memcpy(adj->l2 + ETHER_ADDR_LEN, shost, ETHER_ADDR_LEN);
+        memcpy(adj->l2 + 2 * ETHER_ADDR_LEN, &type, sizeof(type));
+
+        /* the latest entry for ip, as sr_arpcache_lookup() would find */
+        for (i = SR_ARPCACHE_SZ; i-- > 0; )
+        {
+            if (cache->entries[i].valid && cache->entries[i].ip == ip)
+            {
+                sr_adj_set(adj, cache->entries[i].mac);
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&(cache->lock));
+    return adj;
+} /* -- sr_adj_get -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_adj_update(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_adj_update(struct sr_arpcache* cache, uint32_t ip,
+                   const unsigned char* mac)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->nadj; i++)
+    {
+        if (cache->adj[i].ip == ip)
+        { sr_adj_set(&(cache->adj[i]), mac); }
+    }
+} /* -- sr_adj_update -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_adj_rewrite(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_adj_rewrite(const struct sr_adj* adj, uint8_t* frame)
+{
+    uint32_t seq = __atomic_load_n(&(adj->seq), __ATOMIC_ACQUIRE);
+
+    if ((seq & 1) || !adj->valid)
+    { return 0; }
+    memcpy(frame, adj->l2, sizeof(sr_ethernet_hdr_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&(adj->seq), __ATOMIC_RELAXED) == seq;
+} /* -- sr_adj_rewrite -- */
@@ -0,0 +1,62 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_adj.h
+ *
+ * Description:
+ *
+ * Adjacencies: one per (interface, next hop) that a forwarding table
+ * entry (sr_fib.h) sends through, shared by every entry with the same
+ * pair.  Each holds the Ethernet header a frame needs to leave by that
+ * interface for that next hop, source address and type filled in when
+ * it is made and the destination patched in by sr_arpcache_insert()
+ * whenever the next hop's address is learnt, so forwarding a frame is
+ * one copy of the header with no ARP cache lookup.
+ *
+ * Adjacencies live in the ARP cache and are never freed, so a table
+ * entry can keep a pointer to one across rebuilds.  Changes are made
+ * under the cache lock and read without it: the header is guarded by
+ * a sequence count that is odd while it is being rewritten, and a
+ * reader that sees it move falls back on the ARP cache.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_ADJ_H
+#define SR_ADJ_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_ADJ_MAX 256
+
+struct sr_arpcache;
+
+struct sr_adj
+{
+    uint8_t  l2[16];            /* dhost, shost, ethertype, 2 spare */
+    uint32_t seq;               /* odd while l2 or valid is changing */
+    int      valid;             /* dhost is known */
+    uint32_t ip;                /* next hop, network byte order */
+    int      ifindex;
+};
+
+/* The adjacency for ip out of ifindex (whose address is shost), made if
+   there is none yet and seeded from the ARP cache.  0 if the table is
+   full; such next hops go through the ARP cache every time. */
+struct sr_adj* sr_adj_get(struct sr_arpcache* cache, int ifindex,
+                          const unsigned char* shost, uint32_t ip);
+
+/* Points every adjacency for ip at mac, or marks them unresolved if mac
+   is 0.  Called with the cache lock held. */
+void sr_adj_update(struct sr_arpcache* cache, uint32_t ip,
+                   const unsigned char* mac);
+
+/* Writes adj's Ethernet header over frame's.  0, with the frame's header
+   in an unknown state, if the next hop is unresolved or was changed while
+   the header was copied. */
+int sr_adj_rewrite(const struct sr_adj* adj, uint8_t* frame);
+
+#endif /* -- SR_ADJ_H -- */
@@ -10,6 +10,11 @@
 #include "sr_router.h"
 #include "sr_if.h"
 #include "sr_protocol.h"
+#include "sr_pbuf.h"
+#include "sr_pkt.h"
+#include "sr_trace.h"
+#include "sr_stats.h"
+#include "sr_latency.h"
 
 /* 
   This function gets called every second. For each request sent out, we keep
@@ -44,31 +49,37 @@ void sr_arpcache_sweepreqs(struct sr_instance *sr)
 */
 void sr_handle_arpreq(struct sr_instance *sr, struct sr_arpreq *request)
 {
-    printf("\n==== sr_handle_arp_request ====\n");
     time_t now = time(NULL);
 
     if(difftime(now, request->sent) > 1.0)
     {
         if (request->times_sent >= 5)
         {
-          struct sr_packet *pckt     = NULL;
-          struct sr_if *interface    = NULL;
-          sr_ethernet_hdr_t *eth_hdr = NULL;
+          struct sr_packet *pckt;
 
-          while(pckt)
+          /* everything still queued is lost; tell whoever sent it, back
+             out the interface it came in on.  Frames we made ourselves
+             (ingress -1) have nobody to tell */
+          for(pckt = request->packets; pckt; pckt = pckt->next)
           {
-            eth_hdr = (sr_ethernet_hdr_t *)(pckt->buf);
-            interface = sr_get_interface_byAddr(sr, eth_hdr->ether_dhost);
-            
-            if(!interface)
-              sr_send_icmp(sr, pckt->buf, pckt->len, 3, 1);
-            
-	    pckt = request->packets;
-	  }
+            struct sr_pbuf *pb = sr_pbuf_of(pckt->buf);
+            struct sr_if *in = pb ? sr_get_interface_byIndex(sr, pb->ifindex) : NULL;
+
+            sr_stat_inc(pckt->ifindex, SR_STAT_DROP_ARP);
+            if (in)
+            {
+              struct sr_pkt pkt;
+              sr_pkt_parse(&pkt, pckt->buf, pckt->len, in);
+              if (pkt.l4)
+                sr_send_icmp(sr, &pkt, 3, 1, 0);
+            }
+          }
           sr_arpreq_destroy(&(sr->cache), request);
         
         } else {   
-            struct sr_if *interface = sr_get_interface(sr, request->packets->iface);
+            struct sr_if *interface = sr_get_interface_byIndex(sr, request->packets->ifindex);
+            sr_trace(SR_TR_ARP_REQ_OUT, interface->ifindex,
+                     request->ip, request->times_sent + 1, 0, 0);
             sr_send_arp_request(sr, interface, request->ip);
             request->sent = time(NULL);
             request->times_sent++;
@@ -80,11 +91,15 @@ void sr_send_arp_request(struct sr_instance *sr,
                          struct sr_if *interface, 
                          uint32_t tip)
 {
-   printf("==== sr_send_arp_request ====\n");   
-    
     unsigned int len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t);
-    uint8_t *buf = (uint8_t *)malloc(len);
-    
+    struct sr_pbuf *pb = sr_pbuf_alloc();
+    if (!pb) {
+        sr_trace(SR_TR_NOBUF, interface->ifindex, 0, 0, 0, 0);
+        sr_stat_inc(interface->ifindex, SR_STAT_DROP_QUEUE);
+        return;
+    }
+    uint8_t *buf = sr_pbuf_mtod(pb);
+    pb->len = len;
     
     sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)buf;
     sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(buf + sizeof(sr_ethernet_hdr_t));
@@ -106,8 +121,8 @@ void sr_send_arp_request(struct sr_instance *sr,
     arp_hdr->ar_tip = tip;
     
     /* print_hdrs(buf, len); */
-    sr_send_packet(sr, buf, len, interface->name);
-    free(buf);
+    sr_send_packet(sr, buf, len, interface);
+    sr_pbuf_free(pb);
 } /* end sr_send_arp_request -- */
 
 
@@ -151,6 +166,7 @@ struct sr_arpentry *sr_arpcache_lookup(struct sr_arpcache *cache, uint32_t ip) {
 /* Adds an ARP request to the ARP request queue. If the request is already on
    the queue, adds the packet to the linked list of packets for this sr_arpreq
    that corresponds to this ARP request. You should free the passed *packet.
+   Pool-backed packets are kept by reference rather than copied.
    
    A pointer to the ARP request is returned; it should not be freed. The caller
    can remove the ARP request from the queue by calling sr_arpreq_destroy. */
@@ -158,7 +174,7 @@ struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
                                        uint32_t ip,
                                        uint8_t *packet,           /* borrowed */
                                        unsigned int packet_len,
-                                       char *iface)
+                                       int ifindex)
 {
     pthread_mutex_lock(&(cache->lock));
     
@@ -175,19 +191,37 @@ struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
         req->ip = ip;
         req->next = cache->requests;
         cache->requests = req;
+        cache->nrequests++;
     }
     
     /* Add the packet to the list of packets for this request */
-    if (packet && packet_len && iface) {
-        struct sr_packet *new_pkt = (struct sr_packet *)malloc(sizeof(struct sr_packet));
-        
-        new_pkt->buf = (uint8_t *)malloc(packet_len);
-        memcpy(new_pkt->buf, packet, packet_len);
-        new_pkt->len = packet_len;
-		new_pkt->iface = (char *)malloc(sr_IFACE_NAMELEN);
-        strncpy(new_pkt->iface, iface, sr_IFACE_NAMELEN);
-        new_pkt->next = req->packets;
-        req->packets = new_pkt;
+    if (packet && packet_len && ifindex >= 0) {
+        struct sr_pbuf *pb = sr_pbuf_of(packet);
+        uint8_t *buf = packet;
+
+        if (pb) {
+            sr_pbuf_ref(pb);
+            pb->path = SR_LAT_ARPQ;
+        }
+        else if (packet_len <= SR_PBUF_ROOM - SR_PBUF_HEADROOM && (pb = sr_pbuf_alloc())) {
+            buf = sr_pbuf_mtod(pb);
+            memcpy(buf, packet, packet_len);
+            pb->len = packet_len;
+        }
+
+        if (pb) {
+            struct sr_packet *new_pkt = (struct sr_packet *)malloc(sizeof(struct sr_packet));
+
+            new_pkt->buf = buf;
+            new_pkt->len = packet_len;
+            new_pkt->ifindex = ifindex;
+            new_pkt->next = req->packets;
+            req->packets = new_pkt;
+            cache->nqueued++;
+        }
+        else {
+            sr_stat_inc(-1, SR_STAT_DROP_QUEUE);
+        }
     }
     
     pthread_mutex_unlock(&(cache->lock));
@@ -233,6 +267,7 @@ struct sr_arpreq *sr_arpcache_insert(struct sr_arpcache *cache,
         cache->entries[i].ip = ip;
         cache->entries[i].added = time(NULL);
         cache->entries[i].valid = 1;
+        sr_adj_update(cache, ip, mac);
     }
     
     pthread_mutex_unlock(&(cache->lock));
@@ -268,13 +303,13 @@ void sr_arpreq_destroy(struct sr_arpcache *cache, struct sr_arpreq *entry) {
         for (pkt = entry->packets; pkt; pkt = nxt) {
             nxt = pkt->next;
             if (pkt->buf)
-                free(pkt->buf);
-            if (pkt->iface)
-                free(pkt->iface);
+                sr_pbuf_free(sr_pbuf_of(pkt->buf));
             free(pkt);
+            cache->nqueued--;
         }
         
         free(entry);
+        cache->nrequests--;
     }
     
     pthread_mutex_unlock(&(cache->lock));
@@ -295,6 +330,22 @@ void sr_arpcache_dump(struct sr_arpcache *cache) {
     fprintf(stderr, "\n");
 }
 
+/* Counts the cache without the lock; each field is read atomically. */
+void sr_arpcache_occupancy(struct sr_arpcache *cache, unsigned int *entries,
+                           unsigned int *requests, unsigned int *queued) {
+    unsigned int n = 0;
+    int i;
+
+    for (i = 0; i < SR_ARPCACHE_SZ; i++) {
+        if (__atomic_load_n(&(cache->entries[i].valid), __ATOMIC_RELAXED))
+            n++;
+    }
+
+    *entries = n;
+    *requests = __atomic_load_n(&(cache->nrequests), __ATOMIC_RELAXED);
+    *queued = __atomic_load_n(&(cache->nqueued), __ATOMIC_RELAXED);
+}
+
 /* Initialize table + table lock. Returns 0 on success. */
 int sr_arpcache_init(struct sr_arpcache *cache) {  
     /* Seed RNG to kick out a random entry if all entries full. */
@@ -303,6 +354,9 @@ int sr_arpcache_init(struct sr_arpcache *cache) {
     /* Invalidate all entries */
     memset(cache->entries, 0, sizeof(cache->entries));
     cache->requests = NULL;
+    cache->nrequests = 0;
+    cache->nqueued = 0;
+    cache->nadj = 0;
     
     /* Acquire mutex lock */
     pthread_mutexattr_init(&(cache->attr));
@@ -317,6 +371,19 @@ int sr_arpcache_destroy(struct sr_arpcache *cache) {
     return pthread_mutex_destroy(&(cache->lock)) && pthread_mutexattr_destroy(&(cache->attr));
 }
 
+/* An entry for ip has timed out: its adjacencies follow the latest entry
+   left for ip, if there is one. */
+static void sr_arpcache_expire_adj(struct sr_arpcache *cache, uint32_t ip) {
+    int i;
+    for (i = SR_ARPCACHE_SZ; i-- > 0; ) {
+        if ((cache->entries[i].valid) && (cache->entries[i].ip == ip)) {
+            sr_adj_update(cache, ip, cache->entries[i].mac);
+            return;
+        }
+    }
+    sr_adj_update(cache, ip, NULL);
+}
+
 /* Thread which sweeps through the cache and invalidates entries that were added
    more than SR_ARPCACHE_TO seconds ago. */
 void *sr_arpcache_timeout(void *sr_ptr) {
@@ -334,6 +401,7 @@ void *sr_arpcache_timeout(void *sr_ptr) {
         for (i = 0; i < SR_ARPCACHE_SZ; i++) {
             if ((cache->entries[i].valid) && (difftime(curtime,cache->entries[i].added) > SR_ARPCACHE_TO)) {
                 cache->entries[i].valid = 0;
+                sr_arpcache_expire_adj(cache, cache->entries[i].ip);
             }
         }
         
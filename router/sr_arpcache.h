@@ -70,14 +70,16 @@
 #include <time.h>
 #include <pthread.h>
 #include "sr_if.h"
+#include "sr_adj.h"
 
 #define SR_ARPCACHE_SZ    100  
 #define SR_ARPCACHE_TO    15.0
 
 struct sr_packet {
-    uint8_t *buf;               /* A raw Ethernet frame, presumably with the dest MAC empty */
+    uint8_t *buf;               /* A raw Ethernet frame, presumably with the dest MAC empty.
+                                   Always lives in a pool buffer (see sr_pbuf.h) */
     unsigned int len;           /* Length of raw Ethernet frame */
-    char *iface;                /* The outgoing interface */
+    int ifindex;                /* The outgoing interface */
     struct sr_packet *next;
 };
 
@@ -102,6 +104,10 @@ struct sr_arpreq {
 struct sr_arpcache {
     struct sr_arpentry entries[SR_ARPCACHE_SZ];
     struct sr_arpreq *requests;
+    unsigned int nrequests;     /* on the request queue, changed under lock */
+    unsigned int nqueued;       /* packets waiting on those requests */
+    struct sr_adj adj[SR_ADJ_MAX];  /* see sr_adj.h */
+    unsigned int nadj;
     pthread_mutex_t lock;
     pthread_mutexattr_t attr;
 };
@@ -121,7 +127,8 @@ struct sr_arpentry *sr_arpcache_lookup(struct sr_arpcache *cache, uint32_t ip);
 /* Adds an ARP request to the ARP request queue. If the request is already on
    the queue, adds the packet to the linked list of packets for this sr_arpreq
    that corresponds to this ARP request. The packet argument should not be
-   freed by the caller.
+   freed by the caller. A packet held in a pool buffer is queued by taking a
+   reference, anything else is copied into one.
 
    A pointer to the ARP request is returned; it should be freed. The caller
    can remove the ARP request from the queue by calling sr_arpreq_destroy. */
@@ -129,12 +136,13 @@ struct sr_arpreq *sr_arpcache_queuereq(struct sr_arpcache *cache,
                          uint32_t ip,
                          uint8_t *packet,               /* borrowed */
                          unsigned int packet_len,
-                         char *iface);
+                         int ifindex);
 
 /* This method performs two functions:
    1) Looks up this IP in the request queue. If it is found, returns a pointer
       to the sr_arpreq with this IP. Otherwise, returns NULL.
-   2) Inserts this IP to MAC mapping in the cache, and marks it valid. */
+   2) Inserts this IP to MAC mapping in the cache, and marks it valid, and
+      patches the adjacencies for this IP to match. */
 struct sr_arpreq *sr_arpcache_insert(struct sr_arpcache *cache,
                                      unsigned char *mac,
                                      uint32_t ip);
@@ -146,6 +154,11 @@ void sr_arpreq_destroy(struct sr_arpcache *cache, struct sr_arpreq *entry);
 /* Prints out the ARP table. */
 void sr_arpcache_dump(struct sr_arpcache *cache);
 
+/* Counts valid entries, pending requests and the packets waiting on them
+   without taking the lock, so the numbers may be a moment out of date. */
+void sr_arpcache_occupancy(struct sr_arpcache *cache, unsigned int *entries,
+                           unsigned int *requests, unsigned int *queued);
+
 /* You shouldn't have to call these methods--they're already called in the
    starter code for you. The init call is a constructor, the destroy call is
    a destructor, and a cleanup thread times out cache entries every 15
@@ -0,0 +1,608 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench.c
+ *
+ * Description:
+ *
+ * Micro benchmarks of the router's own code paths, linked against the
+ * real sources with sr_send_packet() replaced by a stub that only counts
+ * (no sr_main.c, no sr_vns_comm.c):
+ *
+ *   lpm      sr_lpm() over table sizes and prefix length distributions
+ *   fib      sr_fib_lookup_flow() of the same tables compiled, checked
+ *            against sr_lpm() first; every eighth prefix has a second,
+ *            equal cost path
+ *   arp      sr_arpcache_lookup()/sr_arpcache_insert() over occupancy
+ *   cksum    cksum() with the kernel sr_cksum_init() picks, over lengths
+ *   forward  sr_handlepacket() of a frame that is forwarded, from the
+ *            ethernet header to sr_send_packet(), and of malformed ones
+ *            that must be dropped on the way in
+ *
+ * Each case reports ns/op and ops/s (packets/s for forward); -c prints
+ * the same as CSV so runs can be diffed or plotted.
+ *
+ *   make bench
+ *   ./sr_bench [-c] [-t seconds per case] [lpm|fib|arp|cksum|forward ...]
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_if.h"
+#include "sr_arpcache.h"
+#include "sr_protocol.h"
+#include "sr_utils.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+
+#define NDEST 4096              /* lookup keys, cycled through */
+
+static double seconds = 0.2;
+static int csv = 0;
+static unsigned long sent = 0;  /* frames the stub was handed */
+static const char* sent_if = 0; /* and where the last one went */
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the stub sr_vns_comm.c would provide */
+int sr_send_packet(struct sr_instance* sr, uint8_t* buf, unsigned int len,
+                   struct sr_if* iface)
+{
+    sent++;
+    sent_if = iface->name;
+    return 0;
+}
+
+int sr_send_packetv(struct sr_instance* sr, const struct iovec* v, int vcnt,
+                    struct sr_if* iface)
+{
+    sent++;
+    sent_if = iface->name;
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * timing and reporting
+ *---------------------------------------------------------------------*/
+
+typedef void (*bench_fn)(long iters, void* arg);
+
+/* runs fn in growing batches for the configured time, returns ns/op */
+static double run(bench_fn fn, void* arg)
+{
+    long iters = 0, batch = 64;
+    double start = now(), elapsed;
+
+    do
+    {
+        fn(batch, arg);
+        iters += batch;
+        elapsed = now() - start;
+        if (batch < 65536)
+        { batch *= 2; }
+    } while (elapsed < seconds);
+
+    return elapsed * 1e9 / iters;
+}
+
+static void report(const char* bench, const char* param, double ns)
+{
+    if (csv)
+    { printf("%s,%s,%.2f,%.0f\n", bench, param, ns, 1e9 / ns); }
+    else
+    { printf("%-8s %-26s %10.1f ns/op %14.0f ops/s\n", bench, param, ns, 1e9 / ns); }
+    fflush(stdout);
+}
+
+/* xorshift, so every run sees the same tables and keys */
+static uint32_t rnd_state = 2463534242U;
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static uint32_t prefix_mask(int len)
+{ return len ? htonl(0xffffffffU << (32 - len)) : 0; }
+
+/*---------------------------------------------------------------------
+ * lpm
+ *---------------------------------------------------------------------*/
+
+struct lpm_arg
+{
+    struct sr_instance* sr;
+    uint32_t dest[NDEST];
+};
+
+static volatile uintptr_t sink;
+
+static void bench_lpm_fn(long iters, void* p)
+{
+    struct lpm_arg* a = p;
+    long i;
+
+    for (i = 0; i < iters; i++)
+    { sink += (uintptr_t)sr_lpm(a->sr, a->dest[i & (NDEST - 1)]); }
+}
+
+static void bench_fib_fn(long iters, void* p)
+{
+    struct lpm_arg* a = p;
+    long i;
+
+    for (i = 0; i < iters; i++)
+    { sink += (uintptr_t)sr_fib_lookup_flow(a->sr->fib, a->dest[i & (NDEST - 1)], i); }
+}
+
+/* the compiled table must pick the route the walk picks, for every key,
+   or have it among the equal cost paths it picks from */
+static int fib_agrees(struct lpm_arg* a)
+{
+    const struct sr_fib_entry* e;
+    struct sr_rt* rt;
+    unsigned int i;
+
+    for (i = 0; i < NDEST; i++)
+    {
+        e = sr_fib_lookup(a->sr->fib, a->dest[i]);
+        rt = sr_lpm(a->sr, a->dest[i]);
+        while (e && e->rt != rt && e->next)
+        { e = &(a->sr->fib->entries[e->next - 1]); }
+        if ((e ? e->rt : 0) != rt)
+        { return 0; }
+    }
+    return 1;
+}
+
+/* prefix length drawn from a rough BGP table mix: mostly /24s */
+static int internet_len(void)
+{
+    uint32_t r = rnd() % 100;
+
+    if (r < 55) return 24;
+    if (r < 75) return 16 + rnd() % 8;
+    if (r < 85) return 8 + rnd() % 8;
+    return 25 + rnd() % 8;
+}
+
+static void rt_free(struct sr_instance* sr)
+{
+    struct sr_rt* rt;
+
+    while ((rt = sr->routing_table))
+    {
+        sr->routing_table = rt->next;
+        free(rt);
+    }
+}
+
+/* one table at a time, walked (lpm) or compiled (fib) */
+static void bench_tables(int compiled)
+{
+    static const int sizes[] = { 16, 256, 4096 };
+    static const char* dists[] = { "uniform", "internet" };
+    struct sr_instance sr;
+    struct lpm_arg* a = malloc(sizeof(struct lpm_arg));
+    struct sr_rt* rt;
+    unsigned int s, d, i;
+    char param[64];
+
+    memset(&sr, 0, sizeof(sr));
+    a->sr = &sr;
+
+    for (d = 0; d < sizeof(dists) / sizeof(dists[0]); d++)
+    {
+        for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        {
+            struct in_addr dest, gw, mask;
+            int n = sizes[s];
+
+            gw.s_addr = htonl(0x0a000001);  /* not connected: no broadcasts */
+            for (i = 0; i < n; i++)
+            {
+                int len = d == 0 ? 8 + rnd() % 25 : internet_len();
+                mask.s_addr = prefix_mask(len);
+                dest.s_addr = rnd() & mask.s_addr;
+                sr_add_rt_entry(&sr, dest, gw, mask, "eth1");
+                if ((i & 7) == 7)
+                {
+                    gw.s_addr = htonl(0x0a000002);
+                    sr_add_rt_entry(&sr, dest, gw, mask, "eth1");
+                    gw.s_addr = htonl(0x0a000001);
+                }
+            }
+
+            /* half the keys fall inside some prefix, half are random */
+            for (i = 0; i < NDEST; i++)
+            {
+                uint32_t k = rnd();
+                if (i & 1)
+                {
+                    unsigned int pick = rnd() % n;
+                    rt = sr.routing_table;
+                    while (pick--)
+                    { rt = rt->next; }
+                    k = (k & ~rt->mask.s_addr) | rt->dest.s_addr;
+                }
+                a->dest[i] = k;
+            }
+
+            sprintf(param, "%s/%d", dists[d], n);
+            if (!compiled)
+            { report("lpm", param, run(bench_lpm_fn, a)); }
+            else if (sr_fib_build(&sr) != 0 || !fib_agrees(a))
+            { fprintf(stderr, "fib %s: disagrees with sr_lpm()\n", param); }
+            else
+            { report("fib", param, run(bench_fib_fn, a)); }
+            rt_free(&sr);
+        }
+    }
+    sr_fib_free(sr.fib);
+    free(a);
+}
+
+static void bench_lpm(void)
+{ bench_tables(0); }
+
+static void bench_fib(void)
+{ bench_tables(1); }
+
+/*---------------------------------------------------------------------
+ * arp cache
+ *---------------------------------------------------------------------*/
+
+struct arp_arg
+{
+    struct sr_arpcache* cache;
+    uint32_t ip[NDEST];
+    int slot;                   /* first free slot, insert lands there */
+};
+
+static void bench_arp_lookup_fn(long iters, void* p)
+{
+    struct arp_arg* a = p;
+    struct sr_arpentry* e;
+    long i;
+
+    for (i = 0; i < iters; i++)
+    {
+        if ((e = sr_arpcache_lookup(a->cache, a->ip[i & (NDEST - 1)])))
+        {
+            sink += e->mac[0];
+            free(e);
+        }
+    }
+}
+
+/* insert, then free the slot again so occupancy stays put */
+static void bench_arp_insert_fn(long iters, void* p)
+{
+    struct arp_arg* a = p;
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 1 };
+    long i;
+
+    for (i = 0; i < iters; i++)
+    {
+        sr_arpcache_insert(a->cache, mac, a->ip[i & (NDEST - 1)]);
+        if (a->slot < SR_ARPCACHE_SZ)
+        { a->cache->entries[a->slot].valid = 0; }
+    }
+}
+
+static void bench_arp(void)
+{
+    static const int fill[] = { 0, 10, 50, 99, 100 };
+    struct sr_arpcache* cache = malloc(sizeof(struct sr_arpcache));
+    struct arp_arg* a = malloc(sizeof(struct arp_arg));
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    uint32_t present[SR_ARPCACHE_SZ];
+    unsigned int f, i;
+    char param[64];
+
+    a->cache = cache;
+    for (f = 0; f < sizeof(fill) / sizeof(fill[0]); f++)
+    {
+        int n = fill[f] * SR_ARPCACHE_SZ / 100;
+
+        sr_arpcache_init(cache);
+        for (i = 0; i < n; i++)
+        {
+            present[i] = htonl(0x0a000000 | (rnd() & 0xffffff));
+            mac[5] = i;
+            sr_arpcache_insert(cache, mac, present[i]);
+        }
+        a->slot = n;
+
+        /* hits: addresses in the cache, when there are any */
+        if (n)
+        {
+            for (i = 0; i < NDEST; i++)
+            { a->ip[i] = present[rnd() % n]; }
+            sprintf(param, "lookup-hit/%d%%", fill[f]);
+            report("arp", param, run(bench_arp_lookup_fn, a));
+        }
+
+        /* misses: addresses outside 10/8, so never in the cache */
+        for (i = 0; i < NDEST; i++)
+        { a->ip[i] = htonl(0xc0a80000 | (rnd() & 0xffff)); }
+        sprintf(param, "lookup-miss/%d%%", fill[f]);
+        report("arp", param, run(bench_arp_lookup_fn, a));
+
+        sprintf(param, "insert/%d%%", fill[f]);
+        report("arp", param, run(bench_arp_insert_fn, a));
+
+        sr_arpcache_destroy(cache);
+    }
+    free(a);
+    free(cache);
+}
+
+/*---------------------------------------------------------------------
+ * checksum
+ *---------------------------------------------------------------------*/
+
+struct cksum_arg
+{
+    const uint8_t* buf;
+    int len;
+};
+
+static void bench_cksum_fn(long iters, void* p)
+{
+    struct cksum_arg* a = p;
+    long i;
+
+    for (i = 0; i < iters; i++)
+    { sink += cksum(a->buf, a->len); }
+}
+
+static void bench_cksum(void)
+{
+    static const int lens[] = { 20, 64, 576, 1500, 9000 };
+    uint8_t* buf = malloc(9000);
+    struct cksum_arg a;
+    unsigned int i;
+    char param[64];
+
+    for (i = 0; i < 9000; i++)
+    { buf[i] = rnd(); }
+
+    a.buf = buf;
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+    {
+        a.len = lens[i];
+        sprintf(param, "%s/%d", sr_cksum_init(), lens[i]);
+        report("cksum", param, run(bench_cksum_fn, &a));
+    }
+    free(buf);
+}
+
+/*---------------------------------------------------------------------
+ * forwarding
+ *---------------------------------------------------------------------*/
+
+#define FWD_LEN 98              /* the size of a default ping */
+
+struct fwd_arg
+{
+    struct sr_instance* sr;
+    uint8_t frame[FWD_LEN];     /* copied in before each packet */
+    uint8_t* buf;               /* in a pool buffer, as received */
+};
+
+static void bench_forward_fn(long iters, void* p)
+{
+    struct fwd_arg* a = p;
+    long i;
+
+    for (i = 0; i < iters; i++)
+    {
+        memcpy(a->buf, a->frame, FWD_LEN);
+        sr_handlepacket(a->sr, a->buf, FWD_LEN, "eth1");
+    }
+}
+
+static void add_if(struct sr_instance* sr, const char* name, const char* ip,
+                   unsigned char last)
+{
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 0, 0 };
+    struct in_addr addr;
+
+    mac[5] = last;
+    inet_aton(ip, &addr);
+    sr_add_interface(sr, name);
+    sr_set_ether_addr(sr, mac);
+    sr_set_ether_ip(sr, addr.s_addr);
+}
+
+static void add_rt(struct sr_instance* sr, const char* dest, const char* gw,
+                   const char* mask, char* iface)
+{
+    struct in_addr d, g, m;
+
+    inet_aton(dest, &d);
+    inet_aton(gw, &g);
+    inet_aton(mask, &m);
+    sr_add_rt_entry(sr, d, g, m, iface);
+}
+
+static void bench_forward(void)
+{
+    struct sr_instance* sr = calloc(1, sizeof(struct sr_instance));
+    struct fwd_arg* a = malloc(sizeof(struct fwd_arg));
+    unsigned char nh_mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0, 9, 9 };
+    sr_ethernet_hdr_t* ehdr = (sr_ethernet_hdr_t*)a->frame;
+    sr_ip_hdr_t* ihdr = (sr_ip_hdr_t*)(a->frame + sizeof(sr_ethernet_hdr_t));
+    static const char* bad[] = { "bad-cksum/98", "bad-version/98",
+                                 "bad-length/98" };
+    struct in_addr nh, src;
+    struct sr_pbuf* pb;
+    sr_ip_hdr_t good;
+    unsigned long before;
+    unsigned int i;
+    double ns;
+
+    add_if(sr, "eth1", "10.0.1.1", 1);
+    add_if(sr, "eth2", "192.168.2.1", 2);
+    add_if(sr, "eth3", "172.64.3.1", 3);
+    add_rt(sr, "10.0.1.100", "10.0.1.100", "255.255.255.255", "eth1");
+    add_rt(sr, "192.168.2.2", "192.168.2.2", "255.255.255.255", "eth2");
+    add_rt(sr, "172.64.3.10", "172.64.3.10", "255.255.255.255", "eth3");
+    sr_arpcache_init(&(sr->cache));
+    if (sr_init_interfaces(sr) != 0)
+    {
+        fprintf(stderr, "forward: can't build the forwarding table\n");
+        exit(1);
+    }
+    inet_aton("192.168.2.2", &nh);
+    sr_arpcache_insert(&(sr->cache), nh_mac, nh.s_addr);
+
+    /* 10.0.1.100 -> 192.168.2.2, udp */
+    memset(a->frame, 0, FWD_LEN);
+    memcpy(ehdr->ether_dhost, sr->if_list->addr, ETHER_ADDR_LEN);
+    memset(ehdr->ether_shost, 0xaa, ETHER_ADDR_LEN);
+    ehdr->ether_type = htons(ethertype_ip);
+    ihdr->ip_v = 4;
+    ihdr->ip_hl = 5;
+    ihdr->ip_len = htons(FWD_LEN - sizeof(sr_ethernet_hdr_t));
+    ihdr->ip_ttl = 64;
+    ihdr->ip_p = 17;
+    inet_aton("10.0.1.100", &src);
+    ihdr->ip_src = src.s_addr;
+    ihdr->ip_dst = nh.s_addr;
+    ihdr->ip_sum = cksum(ihdr, sizeof(sr_ip_hdr_t));
+
+    sr_pbuf_pool_init(64);
+    pb = sr_pbuf_alloc();
+    pb->ifindex = 0;
+    pb->len = FWD_LEN;
+    a->buf = sr_pbuf_mtod(pb);
+    a->sr = sr;
+
+    before = sent;
+    ns = run(bench_forward_fn, a);
+    if (sent == before || strcmp(sent_if, "eth2") != 0)
+    {
+        fprintf(stderr, "forward: nothing forwarded to sr_send_packet\n");
+        exit(1);
+    }
+    report("forward", "udp/98", ns);
+
+    /* the same frame broken three ways, none of which may get out */
+    good = *ihdr;
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        *ihdr = good;
+        if (i == 0)
+        { ihdr->ip_sum ^= htons(0x0101); }
+        else
+        {
+            if (i == 1)
+            { ihdr->ip_v = 6; }
+            else
+            { ihdr->ip_len = htons(FWD_LEN); }
+            ihdr->ip_sum = 0;
+            ihdr->ip_sum = cksum(ihdr, sizeof(sr_ip_hdr_t));
+        }
+        before = sent;
+        ns = run(bench_forward_fn, a);
+        if (sent != before)
+        {
+            fprintf(stderr, "forward: a %s frame was sent\n", bad[i]);
+            exit(1);
+        }
+        report("forward", bad[i], ns);
+    }
+    sr_pbuf_free(pb);
+}
+
+/*---------------------------------------------------------------------
+ * main
+ *---------------------------------------------------------------------*/
+
+static const struct
+{
+    const char* name;
+    void (*fn)(void);
+} benches[] =
+{
+    { "lpm",     bench_lpm },
+    { "fib",     bench_fib },
+    { "arp",     bench_arp },
+    { "cksum",   bench_cksum },
+    { "forward", bench_forward },
+};
+
+#define NBENCH ((int)(sizeof(benches) / sizeof(benches[0])))
+
+static void usage(const char* argv0)
+{
+    int i;
+
+    fprintf(stderr, "usage: %s [-c] [-t seconds] [bench ...]\n  bench:", argv0);
+    for (i = 0; i < NBENCH; i++)
+    { fprintf(stderr, " %s", benches[i].name); }
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+    int c, i, j;
+
+    while ((c = getopt(argc, argv, "ct:h")) != EOF)
+    {
+        switch (c)
+        {
+            case 'c':
+                csv = 1;
+                break;
+            case 't':
+                seconds = atof(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    for (j = optind; j < argc; j++)
+    {
+        for (i = 0; i < NBENCH && strcmp(argv[j], benches[i].name); i++)
+        ;
+        if (i == NBENCH)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    sr_cksum_init();
+    if (csv)
+    { printf("bench,case,ns_per_op,ops_per_sec\n"); }
+
+    for (i = 0; i < NBENCH; i++)
+    {
+        int want = optind == argc;
+
+        for (j = optind; j < argc; j++)
+        { want |= strcmp(argv[j], benches[i].name) == 0; }
+        if (want)
+        { benches[i].fn(); }
+    }
+    return 0;
+}
@@ -0,0 +1,405 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_capture.c
+ *
+ * Description:
+ *
+ * Asynchronous packet capture, see sr_capture.h
+ *
+ * The ring holds records already in dump file layout (pcap_sf_pkthdr or a
+ * pcapng block around the captured bytes), wrapping byte-wise, so the writer never looks
+ * inside it: it copies whatever lies between tail and head to the file.
+ * Producers (the main loop and the ARP thread) append under the lock;
+ * the writer only takes it to read head and to publish the new tail, and
+ * does its I/O with the lock released.
+ *
+ * Rotating segments have to be cut on record boundaries, so in that mode
+ * the writer walks the records and copies each into the mapped segment.
+ * pcapng interface blocks seen on the way are kept so every new segment
+ * starts with them.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "sr_capture.h"
+
+#define SR_CAPTURE_IDLE 1000000L   /* ns the writer sleeps when idle */
+
+struct sr_capture
+{
+    FILE* fp;                   /* one stdio stream, or */
+    struct sr_dump_seg* seg;    /* rotating mapped segments */
+    int format;                 /* SR_DUMP_PCAP or SR_DUMP_PCAPNG */
+    int snaplen;
+    struct sr_filter* filter;   /* 0 keeps everything */
+    unsigned int sample;        /* keep one in this many matches */
+    unsigned long seen;         /* matches so far */
+    uint8_t* ring;
+    unsigned long head;         /* bytes ever queued */
+    unsigned long tail;         /* bytes ever written */
+    struct sr_capture_stats st;
+    pthread_mutex_t lock;
+    pthread_t writer;
+    volatile int run;
+};
+
+/* append n bytes at head, the caller has checked there is room */
+static void sr_capture_put(struct sr_capture* cap, const void* src, size_t n)
+{
+    size_t off = cap->head & (SR_CAPTURE_RING - 1);
+    size_t first = min(n, SR_CAPTURE_RING - off);
+
+    memcpy(cap->ring + off, src, first);
+    memcpy(cap->ring, (const uint8_t*)src + first, n - first);
+    cap->head += n;
+}
+
+/* copy n bytes starting at ring position pos out of the ring */
+static void sr_capture_get(struct sr_capture* cap, unsigned long pos,
+                           void* dst, size_t n)
+{
+    size_t off = pos & (SR_CAPTURE_RING - 1);
+    size_t first = min(n, SR_CAPTURE_RING - off);
+
+    memcpy(dst, cap->ring + off, first);
+    memcpy((uint8_t*)dst + first, cap->ring, n - first);
+}
+
+/* queue one record made of n pieces, or count it as dropped */
+static void sr_capture_putv(struct sr_capture* cap, const struct iovec* iov,
+                            int n, int ok)
+{
+    size_t need = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    { need += iov[i].iov_len; }
+
+    pthread_mutex_lock(&(cap->lock));
+    if (!ok || SR_CAPTURE_RING - (cap->head - cap->tail) < need)
+    {
+        cap->st.dropped++;
+        cap->st.dropped_bytes += need;
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+        { sr_capture_put(cap, iov[i].iov_base, iov[i].iov_len); }
+        cap->st.packets++;
+    }
+    pthread_mutex_unlock(&(cap->lock));
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_filter(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_capture_filter(struct sr_capture* cap, struct sr_filter* filter,
+                       unsigned int sample)
+{
+    sr_filter_free(cap->filter);
+    cap->filter = filter;
+    cap->sample = sample;
+} /* -- sr_capture_filter -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_wanted(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_capture_wanted(struct sr_capture* cap, const uint8_t* buf,
+                      unsigned int len, const char* iface, int dir)
+{
+    if (cap->filter && !sr_filter_match(cap->filter, buf, len, iface, dir))
+    { return 0; }
+
+    if (cap->sample > 1)
+    { return __sync_fetch_and_add(&(cap->seen), 1) % cap->sample == 0; }
+
+    return 1;
+} /* -- sr_capture_wanted -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_packetv(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_capture_packetv(struct sr_capture* cap, const struct iovec* v,
+                        int vcnt, int ifindex, int dir)
+{
+    struct timespec ts;
+    struct iovec iov[SR_CAPTURE_IOV + 2];
+    uint32_t len = 0, caplen, left;
+    int i, n = 1;
+
+    /* REQUIRES */
+    assert(vcnt > 0 && vcnt <= SR_CAPTURE_IOV);
+
+    for (i = 0; i < vcnt; i++)
+    { len += v[i].iov_len; }
+    caplen = min(len, (uint32_t)cap->snaplen);
+
+    /* -- the pieces, cut off at snaplen, go in behind the record header -- */
+    for (i = 0, left = caplen; i < vcnt && left; i++, n++)
+    {
+        iov[n].iov_base = v[i].iov_base;
+        iov[n].iov_len  = min(v[i].iov_len, left);
+        left -= iov[n].iov_len;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    if (cap->format == SR_DUMP_PCAPNG)
+    {
+        uint8_t hdr[PCAPNG_EPB_HDR], trailer[PCAPNG_EPB_TRAILER_MAX];
+        uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+        iov[0].iov_base = hdr;
+        iov[0].iov_len  = PCAPNG_EPB_HDR;
+        iov[n].iov_base = trailer;
+        iov[n].iov_len  = sr_dump_ng_epb(hdr, trailer, ifindex, ns,
+                                         caplen, len, dir);
+        /* a packet on no known interface has no block to refer to */
+        sr_capture_putv(cap, iov, n + 1, ifindex >= 0);
+    }
+    else
+    {
+        struct pcap_sf_pkthdr sf_hdr;
+
+        sf_hdr.ts.tv_sec  = ts.tv_sec;
+        sf_hdr.ts.tv_usec = ts.tv_nsec / 1000;
+        sf_hdr.caplen     = caplen;
+        sf_hdr.len        = len;
+        iov[0].iov_base = &sf_hdr;
+        iov[0].iov_len  = sizeof(sf_hdr);
+        sr_capture_putv(cap, iov, n, 1);
+    }
+} /* -- sr_capture_packetv -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_packet(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_capture_packet(struct sr_capture* cap, const uint8_t* buf,
+                       unsigned int len, int ifindex, int dir)
+{
+    struct iovec v;
+
+    v.iov_base = (void*)buf;
+    v.iov_len  = len;
+    sr_capture_packetv(cap, &v, 1, ifindex, dir);
+} /* -- sr_capture_packet -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_interface(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_capture_interface(struct sr_capture* cap, const char* name)
+{
+    uint8_t idb[PCAPNG_IDB_MAX];
+    struct iovec iov;
+
+    if (cap->format != SR_DUMP_PCAPNG)
+    { return; }
+
+    iov.iov_base = idb;
+    iov.iov_len = sr_dump_ng_idb(idb, name, cap->snaplen);
+    sr_capture_putv(cap, &iov, 1, 1);
+} /* -- sr_capture_interface -- */
+
+/*---------------------------------------------------------------------
+ * writer thread
+ *---------------------------------------------------------------------*/
+
+/* write out everything queued so far, returns the number of bytes */
+static unsigned long sr_capture_drain(struct sr_capture* cap)
+{
+    unsigned long head, tail = cap->tail;
+
+    pthread_mutex_lock(&(cap->lock));
+    head = cap->head;
+    pthread_mutex_unlock(&(cap->lock));
+
+    /* record by record into the segments */
+    while (cap->seg && tail != head)
+    {
+        uint32_t blk[2];        /* pcapng type and length */
+        struct pcap_sf_pkthdr sf_hdr;
+        uint8_t* dst;
+        size_t n;
+
+        if (cap->format == SR_DUMP_PCAPNG)
+        {
+            sr_capture_get(cap, tail, blk, sizeof(blk));
+            n = blk[1];
+        }
+        else
+        {
+            sr_capture_get(cap, tail, &sf_hdr, sizeof(sf_hdr));
+            n = sizeof(sf_hdr) + sf_hdr.caplen;
+        }
+        if ((dst = sr_dump_seg_reserve(cap->seg, n)))
+        {
+            sr_capture_get(cap, tail, dst, n);
+            if (cap->format == SR_DUMP_PCAPNG && blk[0] == PCAPNG_IDB)
+            { sr_dump_seg_preamble(cap->seg, dst, n); }
+        }
+        else
+        {
+            pthread_mutex_lock(&(cap->lock));
+            cap->st.dropped++;
+            cap->st.dropped_bytes += n;
+            pthread_mutex_unlock(&(cap->lock));
+        }
+        tail += n;
+    }
+
+    /* or at most two runs to the stream, before and after the wrap */
+    while (tail != head)
+    {
+        size_t off = tail & (SR_CAPTURE_RING - 1);
+        size_t n = min(head - tail, SR_CAPTURE_RING - off);
+
+        if (fwrite(cap->ring + off, 1, n, cap->fp) != n)
+        { perror("sr_capture"); }
+        tail += n;
+    }
+
+    pthread_mutex_lock(&(cap->lock));
+    head -= cap->tail;          /* only we move tail, this is what we wrote */
+    cap->tail = tail;
+    pthread_mutex_unlock(&(cap->lock));
+
+    return head;
+}
+
+static void* sr_capture_writer(void* arg)
+{
+    struct sr_capture* cap = arg;
+    struct timespec idle;
+
+    idle.tv_sec = 0;
+    idle.tv_nsec = SR_CAPTURE_IDLE;
+
+    while (cap->run)
+    {
+        if (!sr_capture_drain(cap))
+        {
+            if (cap->fp)
+            { fflush(cap->fp); }
+            nanosleep(&idle, 0);
+        }
+    }
+
+    sr_capture_drain(cap);
+    if (cap->fp)
+    { fflush(cap->fp); }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_open(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_capture* sr_capture_open(const char* fname, int thiszone, int snaplen,
+                                   const struct sr_capture_limits* lim)
+{
+    struct sr_capture* cap = calloc(1, sizeof(struct sr_capture));
+    size_t n;
+
+    if (!cap)
+    { return 0; }
+
+    if (!(cap->ring = malloc(SR_CAPTURE_RING)))
+    {
+        free(cap);
+        return 0;
+    }
+
+    n = strlen(fname);
+    cap->format = (n > 7 && !strcmp(fname + n - 7, ".pcapng")) ?
+                  SR_DUMP_PCAPNG : SR_DUMP_PCAP;
+    cap->snaplen = snaplen;
+
+    if (lim && (lim->seg_size || lim->seconds))
+    {
+        cap->seg = sr_dump_seg_open(fname, cap->format, thiszone, snaplen,
+                                    lim->seg_size, lim->seconds, lim->nfiles);
+    }
+    else if (cap->format == SR_DUMP_PCAPNG)
+    { cap->fp = sr_dump_ng_open(fname); }
+    else
+    { cap->fp = sr_dump_open(fname, thiszone, snaplen); }
+
+    if (!cap->fp && !cap->seg)
+    {
+        free(cap->ring);
+        free(cap);
+        return 0;
+    }
+
+    pthread_mutex_init(&(cap->lock), 0);
+    cap->run = 1;
+    if (pthread_create(&(cap->writer), 0, sr_capture_writer, cap) != 0)
+    {
+        if (cap->fp)
+        { sr_dump_close(cap->fp); }
+        else
+        { sr_dump_seg_close(cap->seg); }
+        free(cap->ring);
+        free(cap);
+        return 0;
+    }
+
+    return cap;
+} /* -- sr_capture_open -- */
+
+void sr_capture_stats(struct sr_capture* cap, struct sr_capture_stats* st)
+{
+    pthread_mutex_lock(&(cap->lock));
+    *st = cap->st;
+    pthread_mutex_unlock(&(cap->lock));
+} /* -- sr_capture_stats -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_capture_close(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_capture_close(struct sr_capture* cap)
+{
+    cap->run = 0;
+    pthread_join(cap->writer, 0);
+
+    if (cap->st.dropped)
+    {
+        fprintf(stderr, "capture: %lu packets, %lu dropped (%lu bytes)\n",
+                cap->st.packets, cap->st.dropped, cap->st.dropped_bytes);
+    }
+
+    if (cap->fp)
+    { sr_dump_close(cap->fp); }
+    else
+    { sr_dump_seg_close(cap->seg); }
+    pthread_mutex_destroy(&(cap->lock));
+    sr_filter_free(cap->filter);
+    free(cap->ring);
+    free(cap);
+} /* -- sr_capture_close -- */
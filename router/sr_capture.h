@@ -0,0 +1,91 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_capture.h
+ *
+ * Description:
+ *
+ * Asynchronous packet capture for -l.  sr_capture_packet() only copies
+ * the record into a ring buffer; a writer thread drains the ring to the
+ * dump file in large sequential writes.
+ *
+ * A file name ending in .pcapng selects pcapng: one interface block per
+ * router interface (sr_capture_interface(), in ifindex order), and
+ * enhanced packet blocks with nanosecond timestamps and the direction in
+ * their flags.  Otherwise the file is classic pcap, the same as
+ * sr_dump_open()/sr_dump() write.
+ *
+ * With a size or time limit the writer instead copies records into
+ * rotating memory mapped segments (sr_dump_seg_open()), each of which is
+ * still a complete dump file.
+ *
+ * A compiled filter and a 1-in-N sampling rate can be attached, and are
+ * checked by sr_capture_wanted() before the packet is touched.  The
+ * filter never reads past SR_FILTER_DEPTH bytes, so a packet still in
+ * pieces (sr_capture_packetv()) only needs that much of it gathered.
+ *
+ * When the writer falls behind and the ring fills, records are dropped
+ * (never blocking the forwarding path) and counted.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_CAPTURE_H
+#define SR_CAPTURE_H
+
+#include <stdio.h>
+#include <sys/uio.h>
+
+#include "sr_dumper.h"
+#include "sr_filter.h"
+
+#define SR_CAPTURE_RING (4 * 1024 * 1024)  /* bytes, power of two */
+#define SR_CAPTURE_IOV  4                  /* most pieces of one packet */
+
+struct sr_capture;
+
+struct sr_capture_stats
+{
+    unsigned long packets;      /* records written to the ring */
+    unsigned long dropped;      /* records lost to a full ring */
+    unsigned long dropped_bytes;
+};
+
+/* rotation limits, all zero for one unbounded file */
+struct sr_capture_limits
+{
+    size_t seg_size;            /* bytes per file */
+    int seconds;                /* seconds per file */
+    int nfiles;                 /* files kept */
+};
+
+/* Opens fname as sr_dump_open() does (or as sr_dump_seg_open() if lim has
+   a size or time limit) and starts the writer, 0 on error. */
+struct sr_capture* sr_capture_open(const char* fname, int thiszone, int snaplen,
+                                   const struct sr_capture_limits* lim);
+
+/* Queues one packet seen on ifindex going dir (SR_DUMP_IN/OUT) for the
+   writer, dropping it if the ring is full. */
+void sr_capture_packet(struct sr_capture* cap, const uint8_t* buf,
+                       unsigned int len, int ifindex, int dir);
+
+/* The same for a packet in vcnt (at most SR_CAPTURE_IOV) pieces, copied
+   straight into the ring. */
+void sr_capture_packetv(struct sr_capture* cap, const struct iovec* v,
+                        int vcnt, int ifindex, int dir);
+
+/* Keeps only packets matching filter (0 for all), then one in sample of
+   those.  The capture owns filter from here on. */
+void sr_capture_filter(struct sr_capture* cap, struct sr_filter* filter,
+                       unsigned int sample);
+
+/* Non zero if the packet passes the filter and sampling. */
+int sr_capture_wanted(struct sr_capture* cap, const uint8_t* buf,
+                      unsigned int len, const char* iface, int dir);
+
+/* Describes the next interface (pcapng only, a no-op for pcap). */
+void sr_capture_interface(struct sr_capture* cap, const char* name);
+
+void sr_capture_stats(struct sr_capture* cap, struct sr_capture_stats* st);
+
+/* Drains the ring, stops the writer, reports drops and closes the file. */
+void sr_capture_close(struct sr_capture* cap);
+
+#endif /* -- SR_CAPTURE_H -- */
@@ -0,0 +1,267 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_cksum.c
+ *
+ * Description:
+ *
+ * Internet checksum kernels, see sr_cksum.h
+ *
+ * All but the reference kernel sum words in host byte order and swap the
+ * folded result at the end, which RFC 1071 (section 2(B)) shows gives the
+ * same one's complement sum as summing in network byte order.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "sr_cksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SR_CKSUM_X86
+#include <immintrin.h>
+#endif
+
+/*---------------------------------------------------------------------
+ * reference: one network order word per iteration
+ *---------------------------------------------------------------------*/
+
+static uint32_t sr_cksum_add_scalar(uint32_t sum, const void* _data, int len)
+{
+    const uint8_t* data = _data;
+
+    for (;len >= 2; data += 2, len -= 2)
+        sum += data[0] << 8 | data[1];
+    if (len > 0)
+        sum += data[0] << 8;
+    while (sum > 0xffff)
+        sum = (sum >> 16) + (sum & 0xffff);
+    return sum;
+}
+
+static int sr_cksum_always(void)
+{
+    return 1;
+}
+
+/*---------------------------------------------------------------------
+ * helpers shared by the host order kernels
+ *---------------------------------------------------------------------*/
+
+/* running network order sum -> host order start value */
+static uint64_t sr_cksum_start(uint32_t sum)
+{
+    while (sum > 0xffff)
+        sum = (sum >> 16) + (sum & 0xffff);
+    return htons((uint16_t)sum);
+}
+
+/* fold a 64 bit host order sum back to a network order running sum */
+static uint32_t sr_cksum_finish(uint64_t acc)
+{
+    acc = (acc >> 32) + (acc & 0xffffffffULL);
+    acc = (acc >> 32) + (acc & 0xffffffffULL);
+    acc = (acc >> 16) + (acc & 0xffff);
+    acc = (acc >> 16) + (acc & 0xffff);
+    acc = (acc >> 16) + (acc & 0xffff);
+    return ntohs((uint16_t)acc);
+}
+
+/* whatever is left after the wide loop, less than 8 bytes */
+static uint64_t sr_cksum_tail(uint64_t acc, const uint8_t* data, int len)
+{
+    uint32_t w32;
+    uint16_t w16;
+
+    if (len >= 4)
+    {
+        memcpy(&w32, data, 4);
+        acc += w32;
+        data += 4;
+        len -= 4;
+    }
+    if (len >= 2)
+    {
+        memcpy(&w16, data, 2);
+        acc += w16;
+        data += 2;
+        len -= 2;
+    }
+    if (len > 0)
+    {
+        /* the odd byte is the first byte of a zero padded word */
+        w16 = 0;
+        memcpy(&w16, data, 1);
+        acc += w16;
+    }
+    return acc;
+}
+
+/*---------------------------------------------------------------------
+ * portable: 64 bit words with end around carry
+ *---------------------------------------------------------------------*/
+
+static uint32_t sr_cksum_add_word64(uint32_t sum, const void* _data, int len)
+{
+    const uint8_t* data = _data;
+    uint64_t acc = sr_cksum_start(sum);
+    uint64_t w0, w1, w2, w3;
+
+    for (; len >= 32; data += 32, len -= 32)
+    {
+        memcpy(&w0, data, 8);
+        memcpy(&w1, data + 8, 8);
+        memcpy(&w2, data + 16, 8);
+        memcpy(&w3, data + 24, 8);
+        acc += w0; acc += (acc < w0);
+        acc += w1; acc += (acc < w1);
+        acc += w2; acc += (acc < w2);
+        acc += w3; acc += (acc < w3);
+    }
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        memcpy(&w0, data, 8);
+        acc += w0; acc += (acc < w0);
+    }
+
+    /* room for the tail: fold to 33 bits first */
+    acc = (acc >> 32) + (acc & 0xffffffffULL);
+    return sr_cksum_finish(sr_cksum_tail(acc, data, len));
+}
+
+#ifdef SR_CKSUM_X86
+
+/* 32 bit lanes take at most 2 words per vector; flush to the 64 bit sum
+   long before they could overflow */
+#define SR_CKSUM_FLUSH 4096
+
+/*---------------------------------------------------------------------
+ * SSE2: 16 bytes per iteration, words widened into 32 bit lanes
+ *---------------------------------------------------------------------*/
+
+__attribute__ ((target ("sse2")))
+static uint32_t sr_cksum_add_sse2(uint32_t sum, const void* _data, int len)
+{
+    const uint8_t* data = _data;
+    uint64_t acc = sr_cksum_start(sum);
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t lanes[4];
+
+    while (len >= 16)
+    {
+        __m128i vacc = zero;
+        int n = len / 16;
+        if (n > SR_CKSUM_FLUSH)
+            n = SR_CKSUM_FLUSH;
+        len -= n * 16;
+
+        for (; n > 0; n--, data += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)data);
+            vacc = _mm_add_epi32(vacc, _mm_unpacklo_epi16(v, zero));
+            vacc = _mm_add_epi32(vacc, _mm_unpackhi_epi16(v, zero));
+        }
+
+        _mm_storeu_si128((__m128i*)lanes, vacc);
+        acc += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    if (len >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, data, 8);
+        acc += (w >> 32) + (w & 0xffffffffULL);
+        data += 8;
+        len -= 8;
+    }
+    return sr_cksum_finish(sr_cksum_tail(acc, data, len));
+}
+
+static int sr_cksum_have_sse2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+/*---------------------------------------------------------------------
+ * AVX2: 32 bytes per iteration, two accumulators
+ *---------------------------------------------------------------------*/
+
+__attribute__ ((target ("avx2")))
+static uint32_t sr_cksum_add_avx2(uint32_t sum, const void* _data, int len)
+{
+    const uint8_t* data = _data;
+    uint64_t acc = sr_cksum_start(sum);
+    const __m256i zero = _mm256_setzero_si256();
+    uint32_t lanes[8];
+    int i;
+
+    while (len >= 32)
+    {
+        __m256i vacc0 = zero, vacc1 = zero;
+        int n = len / 32;
+        if (n > SR_CKSUM_FLUSH)
+            n = SR_CKSUM_FLUSH;
+        len -= n * 32;
+
+        for (; n > 0; n--, data += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)data);
+            vacc0 = _mm256_add_epi32(vacc0, _mm256_unpacklo_epi16(v, zero));
+            vacc1 = _mm256_add_epi32(vacc1, _mm256_unpackhi_epi16(v, zero));
+        }
+
+        _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi32(vacc0, vacc1));
+        for (i = 0; i < 8; i++)
+            acc += lanes[i];
+    }
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        uint64_t w;
+        memcpy(&w, data, 8);
+        acc += (w >> 32) + (w & 0xffffffffULL);
+    }
+    return sr_cksum_finish(sr_cksum_tail(acc, data, len));
+}
+
+static int sr_cksum_have_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* SR_CKSUM_X86 */
+
+const struct sr_cksum_kernel sr_cksum_kernels[] =
+{
+    { "scalar", sr_cksum_add_scalar, sr_cksum_always },
+    { "word64", sr_cksum_add_word64, sr_cksum_always },
+#ifdef SR_CKSUM_X86
+    { "sse2",   sr_cksum_add_sse2,   sr_cksum_have_sse2 },
+    { "avx2",   sr_cksum_add_avx2,   sr_cksum_have_avx2 },
+#endif /* SR_CKSUM_X86 */
+};
+
+const int sr_cksum_nkernels = sizeof(sr_cksum_kernels) / sizeof(sr_cksum_kernels[0]);
+
+sr_cksum_fn sr_cksum_add = sr_cksum_add_scalar;
+
+/*---------------------------------------------------------------------
+ * Method: sr_cksum_init(..)
+ * Scope:  Global
+ *
+ * Point sr_cksum_add at the last (fastest) kernel this CPU can run.
+ *
+ *---------------------------------------------------------------------*/
+
+const char* sr_cksum_init(void)
+{
+    int i;
+
+    for (i = sr_cksum_nkernels - 1; i > 0; i--)
+    {
+        if (sr_cksum_kernels[i].usable())
+        { break; }
+    }
+
+    sr_cksum_add = sr_cksum_kernels[i].add;
+    return sr_cksum_kernels[i].name;
+} /* -- sr_cksum_init -- */
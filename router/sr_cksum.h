@@ -0,0 +1,44 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_cksum.h
+ *
+ * Description:
+ *
+ * Internet checksum (RFC 1071) summing kernels.  Every kernel computes the
+ * same running sum cksum_add() documents in sr_utils.h: words taken in
+ * network byte order, folded to 16 bits, not inverted.  The scalar kernel
+ * is the reference the others are checked against; sr_cksum_init() picks
+ * the fastest one the CPU supports at startup.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_CKSUM_H
+#define SR_CKSUM_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+typedef uint32_t (*sr_cksum_fn)(uint32_t sum, const void* data, int len);
+
+struct sr_cksum_kernel
+{
+    const char* name;
+    sr_cksum_fn add;
+    int (*usable)(void);        /* 0 if the CPU can't run this kernel */
+};
+
+/* every kernel built in, slowest first; entry 0 is the scalar reference */
+extern const struct sr_cksum_kernel sr_cksum_kernels[];
+extern const int sr_cksum_nkernels;
+
+/* kernel cksum_add() dispatches to, the reference until sr_cksum_init() */
+extern sr_cksum_fn sr_cksum_add;
+
+/* Selects the fastest usable kernel and returns its name. */
+const char* sr_cksum_init(void);
+
+#endif /* -- SR_CKSUM_H -- */
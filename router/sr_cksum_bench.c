@@ -0,0 +1,132 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_cksum_bench.c
+ *
+ * Description:
+ *
+ * Checks every checksum kernel the CPU can run against the scalar
+ * reference on random buffers (random lengths, alignments and starting
+ * sums), then times each of them across a range of payload sizes.
+ * Exits non-zero if any kernel disagrees with the reference.
+ *
+ *   make bench
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sr_cksum.h"
+
+#define FUZZ_ROUNDS   200000
+#define FUZZ_MAXLEN   4096
+#define BENCH_SECONDS 0.2
+
+static const int sizes[] = { 20, 64, 128, 576, 1500, 4096, 9000, 65535 };
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------
+ * fuzz each kernel against the reference, returns number of mismatches
+ *---------------------------------------------------------------------*/
+
+static int fuzz(const struct sr_cksum_kernel* k, uint8_t* buf)
+{
+    const sr_cksum_fn ref = sr_cksum_kernels[0].add;
+    int i, bad = 0;
+
+    for (i = 0; i < FUZZ_ROUNDS; i++)
+    {
+        int off = rand() % 64;
+        int len = rand() % FUZZ_MAXLEN;
+        uint32_t sum = (i & 1) ? (uint32_t)rand() : (uint32_t)(rand() & 0xffff);
+        uint32_t want, got;
+        int j;
+
+        /* mostly random bytes, sometimes all 0x00/0xff to hit the carries */
+        if (i % 97 == 0)
+            memset(buf + off, (i & 2) ? 0xff : 0, len);
+        else
+            for (j = 0; j < len; j++)
+                buf[off + j] = rand();
+
+        want = ref(sum, buf + off, len);
+        got  = k->add(sum, buf + off, len);
+        if (want != got)
+        {
+            if (bad++ < 5)
+                fprintf(stderr, "%s: len %d off %d sum %#x: got %#x want %#x\n",
+                        k->name, len, off, sum, got, want);
+        }
+    }
+    return bad;
+}
+
+/*---------------------------------------------------------------------
+ * ns per call for one kernel and size
+ *---------------------------------------------------------------------*/
+
+static double bench(const struct sr_cksum_kernel* k, const uint8_t* buf, int len)
+{
+    volatile uint32_t sink = 0;
+    long iters = 0, batch = 1024;
+    double start = now(), elapsed;
+    long i;
+
+    do
+    {
+        for (i = 0; i < batch; i++)
+            sink += k->add(0, buf, len);
+        iters += batch;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECONDS);
+
+    (void)sink;
+    return elapsed * 1e9 / iters;
+}
+
+int main(int argc, char** argv)
+{
+    uint8_t* buf = malloc(65536 + 64);
+    int i, j, bad = 0;
+
+    srand(1);
+    printf("selected: %s\n\n", sr_cksum_init());
+
+    for (i = 1; i < sr_cksum_nkernels; i++)
+    {
+        const struct sr_cksum_kernel* k = &sr_cksum_kernels[i];
+        int n;
+        if (!k->usable())
+            continue;
+        n = fuzz(k, buf);
+        printf("fuzz %-8s %d/%d mismatches\n", k->name, n, FUZZ_ROUNDS);
+        bad += n;
+    }
+
+    for (j = 0; j < 65536 + 64; j++)
+        buf[j] = rand();
+
+    printf("\n%-8s %8s %12s %10s\n", "kernel", "bytes", "ns/op", "GB/s");
+    for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); j++)
+    {
+        for (i = 0; i < sr_cksum_nkernels; i++)
+        {
+            const struct sr_cksum_kernel* k = &sr_cksum_kernels[i];
+            double ns;
+            if (!k->usable())
+                continue;
+            ns = bench(k, buf, sizes[j]);
+            printf("%-8s %8d %12.1f %10.2f\n", k->name, sizes[j], ns, sizes[j] / ns);
+        }
+    }
+
+    free(buf);
+    return bad ? 1 : 0;
+}
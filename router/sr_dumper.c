@@ -1,35 +1,46 @@
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 #include "sr_dumper.h"
 
+static void
+sf_fill_header(struct pcap_file_header *hdr, int linktype, int thiszone,
+    int snaplen)
+{
+        hdr->magic = TCPDUMP_MAGIC;
+        hdr->version_major = PCAP_VERSION_MAJOR;
+        hdr->version_minor = PCAP_VERSION_MINOR;
+
+        hdr->thiszone = thiszone;
+        hdr->snaplen = snaplen;
+        hdr->sigfigs = 0;
+        hdr->linktype = linktype;
+}
+
 static void
 sf_write_header(FILE *fp, int linktype, int thiszone, int snaplen)
 {
         struct pcap_file_header hdr;
 
-        hdr.magic = TCPDUMP_MAGIC;
-        hdr.version_major = PCAP_VERSION_MAJOR;
-        hdr.version_minor = PCAP_VERSION_MINOR;
-
-        hdr.thiszone = thiszone;
-        hdr.snaplen = snaplen;
-        hdr.sigfigs = 0;
-        hdr.linktype = linktype;
+        sf_fill_header(&hdr, linktype, thiszone, snaplen);
 
         if (fwrite((char *)&hdr, sizeof(hdr), 1, fp) != 1)
                 fprintf(stderr, "sf_write_header: can't write header\n");
 }
 
-/*
- * Initialize so that sf_write_header() will output to the file named 'fname'.
- */
-FILE *
-sr_dump_open(const char *fname, int thiszone, int snaplen)
-{       
+static FILE *
+sf_open(const char *fname)
+{
   FILE *fp;
- 
+
         if (fname[0] == '-' && fname[1] == '\0')
                 fp = stdout;
         else {
@@ -40,6 +51,19 @@ sr_dump_open(const char *fname, int thiszone, int snaplen)
                         return (NULL);
                 }
         }
+        return fp;
+}
+
+/*
+ * Initialize so that sf_write_header() will output to the file named 'fname'.
+ */
+FILE *
+sr_dump_open(const char *fname, int thiszone, int snaplen)
+{       
+  FILE *fp;
+ 
+        if ((fp = sf_open(fname)) == NULL)
+                return (NULL);
 
         sf_write_header(fp, LINKTYPE_ETHERNET, thiszone, snaplen);
 
@@ -69,3 +93,301 @@ sr_dump_close(FILE *fp)
   fclose(fp);
 }
 
+/*
+ * pcapng blocks, host byte order.  Interfaces are described with
+ * nanosecond timestamp resolution.
+ */
+static uint8_t *
+ng_put32(uint8_t *p, uint32_t v)
+{
+        memcpy(p, &v, 4);
+        return (p + 4);
+}
+
+static uint8_t *
+ng_put16(uint8_t *p, uint16_t v)
+{
+        memcpy(p, &v, 2);
+        return (p + 2);
+}
+
+static size_t
+ng_shb(uint8_t *buf)
+{
+        uint8_t *p = buf;
+
+        p = ng_put32(p, PCAPNG_SHB);
+        p = ng_put32(p, PCAPNG_SHB_LEN);
+        p = ng_put32(p, PCAPNG_BYTE_ORDER_MAGIC);
+        p = ng_put16(p, PCAPNG_VERSION_MAJOR);
+        p = ng_put16(p, PCAPNG_VERSION_MINOR);
+        p = ng_put32(p, 0xffffffff);    /* section length unknown */
+        p = ng_put32(p, 0xffffffff);
+        p = ng_put32(p, PCAPNG_SHB_LEN);
+        return (p - buf);
+}
+
+/*
+ * Open 'fname' and write a pcapng section header; interfaces follow as
+ * sr_dump_ng_idb() blocks.
+ */
+FILE *
+sr_dump_ng_open(const char *fname)
+{
+  FILE *fp;
+  uint8_t shb[PCAPNG_SHB_LEN];
+
+        if ((fp = sf_open(fname)) == NULL)
+                return (NULL);
+
+        if (fwrite(shb, ng_shb(shb), 1, fp) != 1)
+                fprintf(stderr, "sr_dump_ng_open: can't write header\n");
+
+        return fp;
+}
+
+/*
+ * Interface description block for the next interface id, into buf
+ * (PCAPNG_IDB_MAX bytes).  Returns its length.
+ */
+size_t
+sr_dump_ng_idb(uint8_t *buf, const char *name, int snaplen)
+{
+        uint8_t *p = buf;
+        size_t nlen = strlen(name), len;
+
+        if (nlen > PCAPNG_NAME_MAX)
+                nlen = PCAPNG_NAME_MAX;
+        len = 16 + 4 + ((nlen + 3) & ~3) + 8 + 4 + 4;
+        memset(buf, 0, len);
+
+        p = ng_put32(p, PCAPNG_IDB);
+        p = ng_put32(p, len);
+        p = ng_put16(p, LINKTYPE_ETHERNET);
+        p = ng_put16(p, 0);
+        p = ng_put32(p, snaplen);
+        p = ng_put16(p, PCAPNG_OPT_IF_NAME);
+        p = ng_put16(p, nlen);
+        memcpy(p, name, nlen);
+        p += (nlen + 3) & ~3;
+        p = ng_put16(p, PCAPNG_OPT_IF_TSRESOL);
+        p = ng_put16(p, 1);
+        *p = 9;                         /* 10^-9 s */
+        p += 4;
+        p = ng_put32(p, 0);             /* opt_endofopt */
+        p = ng_put32(p, len);
+        return (p - buf);
+}
+
+/*
+ * Enhanced packet block framing for caplen bytes of packet data: the
+ * header goes in hdr (PCAPNG_EPB_HDR bytes), the padding, flags option
+ * and trailing length in trailer (PCAPNG_EPB_TRAILER_MAX bytes).
+ * Returns the trailer length.
+ */
+size_t
+sr_dump_ng_epb(uint8_t *hdr, uint8_t *trailer, uint32_t ifid, uint64_t ts_ns,
+    uint32_t caplen, uint32_t len, uint32_t flags)
+{
+        size_t pad = ((caplen + 3) & ~3) - caplen;
+        uint32_t total = PCAPNG_EPB_HDR + caplen + pad + 16;
+        uint8_t *p;
+
+        p = ng_put32(hdr, PCAPNG_EPB);
+        p = ng_put32(p, total);
+        p = ng_put32(p, ifid);
+        p = ng_put32(p, (uint32_t)(ts_ns >> 32));
+        p = ng_put32(p, (uint32_t)ts_ns);
+        p = ng_put32(p, caplen);
+        ng_put32(p, len);
+
+        memset(trailer, 0, pad);
+        p = trailer + pad;
+        p = ng_put16(p, PCAPNG_OPT_EPB_FLAGS);
+        p = ng_put16(p, 4);
+        p = ng_put32(p, flags);
+        p = ng_put32(p, 0);             /* opt_endofopt */
+        p = ng_put32(p, total);
+        return (p - trailer);
+}
+
+/*
+ * Rotating, memory mapped dump files.
+ *
+ * Each segment is preallocated at its full size and mapped, and records
+ * are copied straight into the mapping.  A segment is finished when the
+ * next record would not fit or it has been open for the time limit; it is
+ * then unmapped and truncated to the bytes actually used.  Segments are
+ * named fname, fname1, fname2, ... and with a file count the names are
+ * reused, so the oldest segment is overwritten.
+ */
+struct sr_dump_seg {
+        char    *fname;
+        size_t  size;           /* bytes per segment */
+        int     seconds;        /* rotate after this long, 0 = never */
+        int     nfiles;         /* names to cycle through, 0 = unbounded */
+        uint8_t *pre;           /* file header and interface blocks */
+        size_t  prelen;         /* that every segment starts with */
+        unsigned int seq;       /* segments opened so far */
+        int     fd;
+        uint8_t *map;
+        size_t  off;            /* bytes used in the current segment */
+        time_t  opened;
+};
+
+static int
+sr_dump_seg_next(struct sr_dump_seg *seg)
+{
+        char *name;
+        unsigned int idx;
+
+        idx = seg->nfiles ? seg->seq % seg->nfiles : seg->seq;
+        name = malloc(strlen(seg->fname) + 12);
+        if (name == NULL)
+                return (-1);
+        if (idx == 0)
+                strcpy(name, seg->fname);
+        else
+                sprintf(name, "%s%u", seg->fname, idx);
+
+        seg->fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (seg->fd < 0) {
+                fprintf(stderr, "sr_dump_seg: can't open %s\n", name);
+                free(name);
+                return (-1);
+        }
+        free(name);
+
+        /* reserve the blocks now so a full disk shows up here, not as
+           SIGBUS on a store into the mapping */
+        if (posix_fallocate(seg->fd, 0, seg->size) != 0) {
+                fprintf(stderr, "sr_dump_seg: can't allocate %lu bytes\n",
+                    (unsigned long)seg->size);
+                close(seg->fd);
+                return (-1);
+        }
+
+        seg->map = mmap(0, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+            seg->fd, 0);
+        if (seg->map == MAP_FAILED) {
+                close(seg->fd);
+                return (-1);
+        }
+
+        memcpy(seg->map, seg->pre, seg->prelen);
+        seg->off = seg->prelen;
+        seg->opened = time(0);
+        seg->seq++;
+        return (0);
+}
+
+static void
+sr_dump_seg_finish(struct sr_dump_seg *seg)
+{
+        if (seg->map == NULL)
+                return;
+        munmap(seg->map, seg->size);
+        if (ftruncate(seg->fd, seg->off) != 0)
+                perror("sr_dump_seg: ftruncate");
+        close(seg->fd);
+        seg->map = NULL;
+}
+
+/*
+ * Open the first segment.  seg_size is rounded up so that at least one
+ * full snaplen record fits, with room for a few interface blocks.
+ */
+struct sr_dump_seg *
+sr_dump_seg_open(const char *fname, int format, int thiszone, int snaplen,
+    size_t seg_size, int seconds, int nfiles)
+{
+        struct sr_dump_seg *seg;
+        size_t minsz = 8 * PCAPNG_IDB_MAX + PCAPNG_EPB_HDR + snaplen +
+            PCAPNG_EPB_TRAILER_MAX;
+
+        if (fname[0] == '-' && fname[1] == '\0') {
+                fprintf(stderr, "sr_dump_seg_open: can't rotate stdout\n");
+                return (NULL);
+        }
+
+        seg = calloc(1, sizeof(*seg));
+        if (seg == NULL || (seg->fname = strdup(fname)) == NULL ||
+            (seg->pre = malloc(PCAPNG_SHB_LEN)) == NULL) {
+                if (seg)
+                        free(seg->fname);
+                free(seg);
+                return (NULL);
+        }
+        if (format == SR_DUMP_PCAPNG)
+                seg->prelen = ng_shb(seg->pre);
+        else {
+                struct pcap_file_header hdr;
+                sf_fill_header(&hdr, LINKTYPE_ETHERNET, thiszone, snaplen);
+                memcpy(seg->pre, &hdr, sizeof(hdr));
+                seg->prelen = sizeof(hdr);
+        }
+        seg->size = seg_size ? seg_size : SR_DUMP_SEG_SIZE;
+        if (seg->size < minsz)
+                seg->size = minsz;
+        seg->seconds = seconds;
+        seg->nfiles = nfiles;
+
+        if (sr_dump_seg_next(seg) != 0) {
+                free(seg->pre);
+                free(seg->fname);
+                free(seg);
+                return (NULL);
+        }
+        return (seg);
+}
+
+/*
+ * Room for one record of len bytes, rotating first if needed.  The
+ * caller copies the record in.  Returns NULL if no segment could be
+ * opened or the record is larger than a segment.
+ */
+uint8_t *
+sr_dump_seg_reserve(struct sr_dump_seg *seg, size_t len)
+{
+        uint8_t *p;
+
+        if (seg->map != NULL && (seg->off + len > seg->size ||
+            (seg->seconds && time(0) - seg->opened >= seg->seconds))) {
+                sr_dump_seg_finish(seg);
+        }
+        if (seg->map == NULL && sr_dump_seg_next(seg) != 0)
+                return (NULL);
+        if (seg->off + len > seg->size)
+                return (NULL);
+
+        p = seg->map + seg->off;
+        seg->off += len;
+        return (p);
+}
+
+void
+sr_dump_seg_close(struct sr_dump_seg *seg)
+{
+        sr_dump_seg_finish(seg);
+        free(seg->pre);
+        free(seg->fname);
+        free(seg);
+}
+
+/*
+ * Remember a block (a pcapng interface description) that every later
+ * segment must also start with.  The caller has already written it to
+ * the current segment.
+ */
+int
+sr_dump_seg_preamble(struct sr_dump_seg *seg, const void *blk, size_t len)
+{
+        uint8_t *pre = realloc(seg->pre, seg->prelen + len);
+
+        if (pre == NULL)
+                return (-1);
+        memcpy(pre + seg->prelen, blk, len);
+        seg->pre = pre;
+        seg->prelen += len;
+        return (0);
+}
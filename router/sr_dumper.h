@@ -3,6 +3,8 @@
  * format as well as a set of operations for logging.
  */
 
+#ifndef SR_DUMPER_H
+#define SR_DUMPER_H
 
 #ifdef _LINUX_
 #include <stdint.h>
@@ -13,6 +15,7 @@
 #endif /* _DARWIN_ */
 
 #include <sys/time.h>
+#include <stddef.h>
 
 #define PCAP_VERSION_MAJOR 2
 #define PCAP_VERSION_MINOR 4
@@ -23,6 +26,31 @@
 
 #define LINKTYPE_ETHERNET 1
 
+/* pcapng */
+#define PCAPNG_SHB 0x0A0D0D0A            /* section header block */
+#define PCAPNG_IDB 1                     /* interface description block */
+#define PCAPNG_EPB 6                     /* enhanced packet block */
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_VERSION_MAJOR 1
+#define PCAPNG_VERSION_MINOR 0
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_EPB_FLAGS 2
+
+#define PCAPNG_SHB_LEN 28
+#define PCAPNG_NAME_MAX 32               /* longest if_name kept */
+#define PCAPNG_IDB_MAX (40 + PCAPNG_NAME_MAX)
+#define PCAPNG_EPB_HDR 28
+#define PCAPNG_EPB_TRAILER_MAX 19
+
+/* epb_flags direction bits */
+#define SR_DUMP_IN  1
+#define SR_DUMP_OUT 2
+
+/* file formats */
+#define SR_DUMP_PCAP   0
+#define SR_DUMP_PCAPNG 1
+
 #define min(a,b) ( (a) < (b) ? (a) : (b) )
 
 /* file header */
@@ -77,3 +105,50 @@ void sr_dump(FILE *fp, const struct pcap_pkthdr *h, const unsigned char *sp);
  * Close the file
  */
 void sr_dump_close(FILE *fp);
+
+/**
+ * Open a pcapng dump file and write the section header
+ */
+FILE* sr_dump_ng_open(const char *fname);
+
+/**
+ * Build the interface description block for the next interface id
+ */
+size_t sr_dump_ng_idb(uint8_t *buf, const char *name, int snaplen);
+
+/**
+ * Build the enhanced packet block header and trailer around caplen bytes
+ * of packet data, returns the trailer length
+ */
+size_t sr_dump_ng_epb(uint8_t *hdr, uint8_t *trailer, uint32_t ifid,
+    uint64_t ts_ns, uint32_t caplen, uint32_t len, uint32_t flags);
+
+#define SR_DUMP_SEG_SIZE (64 * 1024 * 1024)  /* default bytes per segment */
+
+struct sr_dump_seg;
+
+/**
+ * Open a set of rotating, memory mapped dump files: a new file is
+ * started when seg_size bytes are used or after seconds (if non zero),
+ * and with nfiles non zero only that many names are cycled through.
+ */
+struct sr_dump_seg* sr_dump_seg_open(const char *fname, int format,
+    int thiszone, int snaplen, size_t seg_size, int seconds, int nfiles);
+
+/**
+ * Reserve len bytes for one record in the current file, the caller
+ * copies it in
+ */
+uint8_t* sr_dump_seg_reserve(struct sr_dump_seg *seg, size_t len);
+
+/**
+ * Close the current file, trimmed to the bytes written
+ */
+void sr_dump_seg_close(struct sr_dump_seg *seg);
+
+/**
+ * Add a block every later file must start with (pcapng interfaces)
+ */
+int sr_dump_seg_preamble(struct sr_dump_seg *seg, const void *blk, size_t len);
+
+#endif /* -- SR_DUMPER_H -- */
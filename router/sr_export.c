@@ -0,0 +1,327 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_export.c
+ *
+ * Description:
+ *
+ * Prometheus text export over a Unix socket, see sr_export.h
+ *
+ * A snapshot is formatted into a heap buffer and written in one go, then
+ * the connection is closed.  The request, if any, is only sniffed to
+ * decide between a bare body and an HTTP response: whatever arrives
+ * within SR_EXPORT_WAIT ms is read, and anything starting "GET " is
+ * answered over HTTP/1.0.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sr_export.h"
+#include "sr_router.h"
+#include "sr_fib.h"
+#include "sr_if.h"
+#include "sr_arpcache.h"
+#include "sr_stats.h"
+#include "sr_latency.h"
+
+#define SR_EXPORT_WAIT 100      /* ms to wait for a request line */
+
+struct sr_export_buf
+{
+    char* p;
+    size_t len;
+    size_t cap;
+    int failed;
+};
+
+static struct sr_instance* export_sr = 0;
+static int export_fd = -1;
+static char export_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static pthread_t export_thread;
+
+/* append to the snapshot, growing it as needed */
+static void sr_export_printf(struct sr_export_buf* b, const char* fmt, ...)
+{
+    va_list ap;
+    char* p;
+    size_t cap;
+    int n;
+
+    while (!b->failed)
+    {
+        va_start(ap, fmt);
+        n = vsnprintf(b->p + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+
+        if (n >= 0 && (size_t)n < b->cap - b->len)
+        {
+            b->len += n;
+            return;
+        }
+
+        /* -- keep the old buffer for the caller to free if this fails -- */
+        cap = b->cap ? b->cap * 2 : 4096;
+        if (!(p = realloc(b->p, cap)))
+        {
+            b->failed = 1;
+            return;
+        }
+        b->p = p;
+        b->cap = cap;
+    }
+}
+
+/*---------------------------------------------------------------------
+ * snapshot
+ *---------------------------------------------------------------------*/
+
+/* every counter, one sample per interface plus the no interface row */
+static void sr_export_counters(struct sr_export_buf* b, struct sr_instance* sr)
+{
+    uint64_t c[SR_STATS_MAXIF + 1][SR_NSTATS];
+    const char* names[SR_STATS_MAXIF + 1];
+    struct sr_if* if_walker;
+    int n = 0, i, j;
+
+    for (if_walker = sr->if_list; if_walker && n < SR_STATS_MAXIF;
+         if_walker = if_walker->next)
+    {
+        names[n] = if_walker->name;
+        sr_stats_read(if_walker->ifindex, c[n++]);
+    }
+    names[n] = "none";
+    sr_stats_read(-1, c[n++]);
+
+    for (i = 0; i < SR_NSTATS; i++)
+    {
+        sr_export_printf(b, "# TYPE sr_%s_total counter\n", sr_stat_names[i]);
+        for (j = 0; j < n; j++)
+        {
+            sr_export_printf(b, "sr_%s_total{iface=\"%s\"} %llu\n",
+                             sr_stat_names[i], names[j],
+                             (unsigned long long)c[j][i]);
+        }
+    }
+}
+
+static void sr_export_gauge(struct sr_export_buf* b, const char* name,
+                            const char* help, unsigned long v)
+{
+    sr_export_printf(b, "# HELP sr_%s %s\n# TYPE sr_%s gauge\nsr_%s %lu\n",
+                     name, help, name, name, v);
+}
+
+/* ARP cache and FIB sizes */
+static void sr_export_tables(struct sr_export_buf* b, struct sr_instance* sr)
+{
+    unsigned int entries, requests, queued;
+    /* tables replaced under us are only retired, never freed */
+    const struct sr_fib* fib = __atomic_load_n(&(sr->fib), __ATOMIC_ACQUIRE);
+
+    sr_arpcache_occupancy(&(sr->cache), &entries, &requests, &queued);
+
+    sr_export_gauge(b, "arp_cache_entries", "Valid ARP cache entries.",
+                    entries);
+    sr_export_gauge(b, "arp_cache_capacity", "ARP cache slots.",
+                    SR_ARPCACHE_SZ);
+    sr_export_gauge(b, "arp_pending_requests",
+                    "Next hops with an ARP request outstanding.", requests);
+    sr_export_gauge(b, "arp_queued_packets",
+                    "Packets waiting for an ARP reply.", queued);
+    sr_export_gauge(b, "fib_routes", "Forwarding table entries, one per "
+                    "equal cost path, own addresses included.",
+                    fib ? fib->nentries : 0);
+}
+
+/* a summary per path, in seconds */
+static void sr_export_latency(struct sr_export_buf* b)
+{
+    static const double q[] = { 0.5, 0.9, 0.99, 0.999 };
+    struct sr_latency_snap* s;
+    unsigned int i;
+    int path;
+
+    if (!(s = malloc(sizeof(struct sr_latency_snap))))
+    {
+        b->failed = 1;
+        return;
+    }
+
+    sr_export_printf(b, "# HELP sr_latency_seconds Time from reading a frame "
+                     "to sending it or its answer.\n"
+                     "# TYPE sr_latency_seconds summary\n");
+    for (path = 0; path < SR_NLAT; path++)
+    {
+        sr_latency_read(path, s);
+        for (i = 0; i < sizeof(q) / sizeof(q[0]); i++)
+        {
+            sr_export_printf(b, "sr_latency_seconds{path=\"%s\",quantile=\"%g\"} %.9f\n",
+                             sr_lat_names[path], q[i],
+                             sr_latency_quantile(s, q[i]) / 1e9);
+        }
+        sr_export_printf(b, "sr_latency_seconds_sum{path=\"%s\"} %.9f\n",
+                         sr_lat_names[path], s->sum / 1e9);
+        sr_export_printf(b, "sr_latency_seconds_count{path=\"%s\"} %llu\n",
+                         sr_lat_names[path], (unsigned long long)s->n);
+    }
+    free(s);
+}
+
+/*---------------------------------------------------------------------
+ * server thread
+ *---------------------------------------------------------------------*/
+
+static int sr_export_write(int fd, const char* p, size_t n)
+{
+    ssize_t w;
+
+    while (n > 0)
+    {
+        if ((w = send(fd, p, n, MSG_NOSIGNAL)) < 0)
+        {
+            if (errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        p += w;
+        n -= w;
+    }
+    return 0;
+}
+
+static void sr_export_serve(int fd)
+{
+    struct sr_export_buf b = { 0, 0, 0, 0 };
+    struct pollfd pfd;
+    char req[512];
+    ssize_t n = 0;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, SR_EXPORT_WAIT) > 0)
+    { n = recv(fd, req, sizeof(req) - 1, 0); }
+
+    sr_export_counters(&b, export_sr);
+    sr_export_tables(&b, export_sr);
+    sr_export_latency(&b);
+    if (b.failed)
+    {
+        free(b.p);
+        return;
+    }
+
+    if (n >= 4 && memcmp(req, "GET ", 4) == 0)
+    {
+        char hdr[128];
+        int hlen = snprintf(hdr, sizeof(hdr), "HTTP/1.0 200 OK\r\n"
+                            "Content-Type: text/plain; version=0.0.4\r\n"
+                            "Content-Length: %lu\r\n\r\n",
+                            (unsigned long)b.len);
+        if (sr_export_write(fd, hdr, hlen) != 0)
+        {
+            free(b.p);
+            return;
+        }
+    }
+    sr_export_write(fd, b.p, b.len);
+    free(b.p);
+}
+
+static void* sr_export_run(void* arg)
+{
+    struct sched_param sp;
+    int fd;
+
+    /* never compete with forwarding for a CPU */
+    memset(&sp, 0, sizeof(sp));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+    /* accept() fails once sr_export_close() shuts the socket down */
+    while ((fd = accept(export_fd, 0, 0)) >= 0 || errno == EINTR)
+    {
+        if (fd < 0)
+        { continue; }
+        sr_export_serve(fd);
+        close(fd);
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_export_open(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_export_open(struct sr_instance* sr, const char* path)
+{
+    struct sockaddr_un addr;
+
+    /* REQUIRES */
+    assert(sr);
+    assert(path);
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "sr_export: socket path too long\n");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((export_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+        perror("sr_export: socket");
+        return -1;
+    }
+    unlink(path);
+    if (bind(export_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(export_fd, 8) != 0)
+    {
+        perror("sr_export: bind");
+        close(export_fd);
+        export_fd = -1;
+        return -1;
+    }
+
+    export_sr = sr;
+    strcpy(export_path, path);
+    if (pthread_create(&export_thread, 0, sr_export_run, 0) != 0)
+    {
+        close(export_fd);
+        unlink(export_path);
+        export_fd = -1;
+        return -1;
+    }
+    return 0;
+} /* -- sr_export_open -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_export_close(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_export_close(void)
+{
+    if (export_fd < 0)
+    { return; }
+
+    shutdown(export_fd, SHUT_RDWR);
+    pthread_join(export_thread, 0);
+    close(export_fd);
+    unlink(export_path);
+    export_fd = -1;
+} /* -- sr_export_close -- */
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_export.h
+ *
+ * Description:
+ *
+ * Runtime statistics over a Unix domain socket, in the Prometheus text
+ * exposition format.  Every connection gets one snapshot: the counters of
+ * sr_stats.h per interface, ARP cache occupancy, the pending ARP queue,
+ * the FIB size and a latency summary per path (sr_latency.h).  A client
+ * that opens with an HTTP GET gets an HTTP response, so
+ *
+ *   curl --unix-socket PATH http://sr/metrics
+ *   socat - UNIX-CONNECT:PATH
+ *
+ * both work.  The server is a single thread at idle priority; it reads
+ * counters and gauges without taking any lock forwarding uses.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_EXPORT_H
+#define SR_EXPORT_H
+
+struct sr_instance;
+
+/* Binds path (replacing a stale socket) and starts serving, 0 on success. */
+int sr_export_open(struct sr_instance* sr, const char* path);
+
+/* Stops the server and removes the socket, if one was opened. */
+void sr_export_close(void);
+
+#endif /* -- SR_EXPORT_H -- */
@@ -0,0 +1,370 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_fib.c
+ *
+ * Description:
+ *
+ * Forwarding table, see sr_fib.h
+ *
+ * A prefix of length plen is stored in the node at depth (plen - 1) / 8
+ * (the root for a default route), in every slot its last partial byte
+ * covers.  A slot keeps the longest prefix stored in it, and a lookup
+ * keeps the last entry it passes on the way down, which is the longest
+ * match.
+ *
+ * Only the first route to a prefix goes into the trie, later ones by
+ * other paths hang off it through next.  Each bucket of the set goes to
+ * the path with the highest weight for it, a hash of the bucket and the
+ * path alone, so it is the same whatever else is in the set.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "sr_fib.h"
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_if.h"
+#include "sr_adj.h"
+#include "sr_log.h"
+
+#define SR_FIB_MAXENTRIES 0xffff    /* entry indexes are 16 bit */
+
+static int sr_fib_plen(uint32_t mask)
+{
+    return __builtin_popcount(mask);
+}
+
+static int sr_fib_add_entry(struct sr_instance* sr, struct sr_fib* fib,
+                            uint8_t type, int ifindex, uint32_t nexthop,
+                            struct sr_rt* rt)
+{
+    struct sr_if* iface;
+
+    struct sr_fib_entry* e;
+
+    if (fib->nentries == SR_FIB_MAXENTRIES)
+    { return -1; }
+    if ((fib->nentries & (fib->nentries - 1)) == 0)
+    {
+        e = realloc(fib->entries, (fib->nentries ? fib->nentries * 2 : 16) *
+                    sizeof(struct sr_fib_entry));
+        if (!e)
+        { return -1; }
+        fib->entries = e;
+    }
+    e = &(fib->entries[fib->nentries]);
+    e->type = type;
+    e->ifindex = ifindex;
+    e->nexthop = nexthop;
+    e->rt = rt;
+    e->adj = 0;
+    e->next = 0;
+    e->buckets = 0;
+    if (type == SR_FIB_FORWARD && nexthop &&
+        (iface = sr_get_interface_byIndex(sr, ifindex)))
+    { e->adj = sr_adj_get(&(sr->cache), ifindex, iface->addr, nexthop); }
+    return ++fib->nentries;
+}
+
+static uint32_t sr_fib_add_node(struct sr_fib* fib)
+{
+    struct sr_fib_slot (*n)[256];
+
+    if ((fib->nnodes & (fib->nnodes - 1)) == 0)
+    {
+        n = realloc(fib->nodes, (fib->nnodes ? fib->nnodes * 2 : 1) *
+                    sizeof(fib->nodes[0]));
+        if (!n)
+        { return 0; }
+        fib->nodes = n;
+    }
+    memset(fib->nodes[fib->nnodes], 0, sizeof(fib->nodes[0]));
+    return ++fib->nnodes;
+}
+
+/* prefix (host byte order) of length plen now leads to entry (index + 1) */
+static int sr_fib_insert(struct sr_fib* fib, uint32_t prefix, int plen,
+                         uint16_t entry)
+{
+    uint32_t node = 0, child;
+    int depth = 0, span;
+    unsigned int i, first;
+
+    while (plen > 8 * (depth + 1))
+    {
+        i = (prefix >> (24 - 8 * depth)) & 0xff;
+        if (!(child = fib->nodes[node][i].child))
+        {
+            if (!(child = sr_fib_add_node(fib)))
+            { return -1; }
+            fib->nodes[node][i].child = child;
+        }
+        node = child - 1;
+        depth++;
+    }
+
+    span = 8 * (depth + 1) - plen;
+    first = ((prefix >> (24 - 8 * depth)) & 0xff) & ~((1U << span) - 1);
+    for (i = first; i < first + (1U << span); i++)
+    {
+        if (!fib->nodes[node][i].entry || fib->nodes[node][i].plen <= plen)
+        {
+            fib->nodes[node][i].entry = entry;
+            fib->nodes[node][i].plen = plen;
+        }
+    }
+    return 0;
+}
+
+/* the entry (index + 1) prefix (host byte order) of length plen is
+   stored as, 0 if none; any slot of its span holding that length holds
+   it, unless longer prefixes hide all of them */
+static unsigned int sr_fib_exact(const struct sr_fib* fib, uint32_t prefix,
+                                 int plen)
+{
+    const struct sr_fib_slot* s;
+    uint32_t node = 0;
+    int depth = 0, span;
+    unsigned int i, first;
+
+    while (plen > 8 * (depth + 1))
+    {
+        if (!(node = fib->nodes[node][(prefix >> (24 - 8 * depth)) & 0xff].child))
+        { return 0; }
+        node--;
+        depth++;
+    }
+
+    span = 8 * (depth + 1) - plen;
+    first = ((prefix >> (24 - 8 * depth)) & 0xff) & ~((1U << span) - 1);
+    for (i = first; i < first + (1U << span); i++)
+    {
+        s = &(fib->nodes[node][i]);
+        if (s->entry && s->plen == plen)
+        { return s->entry; }
+    }
+    return 0;
+}
+
+static uint32_t sr_fib_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    return h ^ (h >> 16);
+}
+
+/* how much a path wants a bucket */
+static uint32_t sr_fib_weight(const struct sr_fib_entry* e, unsigned int bucket)
+{
+    uint32_t path = sr_fib_mix(e->nexthop ^ ((uint32_t)e->ifindex << 24));
+
+    return sr_fib_mix(path ^ (bucket * 0x9e3779b1U));
+}
+
+/* hands each bucket of head's set to the path that weighs it most */
+static int sr_fib_spread(struct sr_fib* fib, unsigned int head)
+{
+    struct sr_fib_entry* h = &(fib->entries[head]);
+    unsigned int b, m, best;
+    uint32_t w, top;
+
+    if (!h->buckets &&
+        !(h->buckets = malloc(SR_FIB_BUCKETS * sizeof(uint16_t))))
+    { return -1; }
+
+    for (b = 0; b < SR_FIB_BUCKETS; b++)
+    {
+        best = head;
+        top = sr_fib_weight(h, b);
+        for (m = h->next; m; m = fib->entries[m - 1].next)
+        {
+            if ((w = sr_fib_weight(&(fib->entries[m - 1]), b)) > top)
+            {
+                best = m - 1;
+                top = w;
+            }
+        }
+        h->buckets[b] = best;
+    }
+    return 0;
+}
+
+/* rt is another route to head's prefix: the same path again replaces
+   the route it was, a new one joins the set */
+static int sr_fib_add_path(struct sr_instance* sr, struct sr_fib* fib,
+                           unsigned int head, struct sr_rt* rt)
+{
+    struct sr_fib_entry* e;
+    unsigned int m, last = head;
+    int entry;
+
+    for (m = head + 1; m; m = e->next)
+    {
+        e = &(fib->entries[m - 1]);
+        if (e->ifindex == rt->ifindex && e->nexthop == rt->gw.s_addr)
+        {
+            e->rt = rt;
+            return 0;
+        }
+        last = m - 1;
+    }
+
+    /* entries may move, so they are held by index */
+    if ((entry = sr_fib_add_entry(sr, fib, SR_FIB_FORWARD, rt->ifindex,
+                                  rt->gw.s_addr, rt)) < 0)
+    { return -1; }
+    fib->entries[last].next = entry;
+    return sr_fib_spread(fib, head);
+}
+
+static int sr_fib_add(struct sr_instance* sr, struct sr_fib* fib,
+                      uint32_t prefix, int plen, uint8_t type, int ifindex,
+                      uint32_t nexthop, struct sr_rt* rt)
+{
+    int entry = sr_fib_add_entry(sr, fib, type, ifindex, nexthop, rt);
+
+    if (entry < 0)
+    { return -1; }
+    return sr_fib_insert(fib, ntohl(prefix), plen, entry);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_build(..)
+ * Scope:  Global
+ *
+ * Routes go in first, in table order, then the broadcasts, then the
+ * interface addresses, so at equal lengths the later kind wins.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_fib_build(struct sr_instance* sr)
+{
+    struct sr_fib* fib = calloc(1, sizeof(struct sr_fib));
+    struct sr_fib* old;
+    struct sr_rt* rt;
+    struct sr_if* if_walker;
+    uint32_t mask;
+    unsigned int head;
+    int ok;
+
+    /* REQUIRES */
+    assert(sr);
+
+    ok = fib && sr_fib_add_node(fib);
+
+    for (rt = sr->routing_table; ok && rt; rt = rt->next)
+    {
+        mask = rt->mask.s_addr;
+        if ((head = sr_fib_exact(fib, ntohl(rt->dest.s_addr & mask),
+                                 sr_fib_plen(mask))))
+        { ok = sr_fib_add_path(sr, fib, head - 1, rt) == 0; }
+        else
+        {
+            ok = sr_fib_add(sr, fib, rt->dest.s_addr & mask, sr_fib_plen(mask),
+                            SR_FIB_FORWARD, rt->ifindex, rt->gw.s_addr, rt) == 0;
+        }
+    }
+    for (rt = sr->routing_table; ok && rt; rt = rt->next)
+    {
+        mask = rt->mask.s_addr;
+        if (rt->gw.s_addr == 0 && sr_fib_plen(mask) <= 30)
+        {
+            ok = sr_fib_add(sr, fib, rt->dest.s_addr | ~mask, 32, SR_FIB_DROP,
+                            -1, 0, 0) == 0;
+        }
+    }
+    if (ok)
+    { ok = sr_fib_add(sr, fib, 0xffffffffU, 32, SR_FIB_DROP, -1, 0, 0) == 0; }
+    for (if_walker = sr->if_list; ok && if_walker; if_walker = if_walker->next)
+    {
+        ok = sr_fib_add(sr, fib, if_walker->ip, 32, SR_FIB_LOCAL,
+                        if_walker->ifindex, 0, 0) == 0;
+    }
+
+    if (!ok)
+    {
+        sr_log(SR_LOG_ERR, "** Error: can't build the forwarding table\n");
+        sr_fib_free(fib);
+        return -1;
+    }
+
+    /* -- a lookup may still be in the old table, it is retired rather
+          than freed (see sr_fib.h) -- */
+    old = sr->fib;
+    fib->retired = old;
+    __atomic_store_n(&(sr->fib), fib, __ATOMIC_RELEASE);
+    return 0;
+} /* -- sr_fib_build -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_lookup(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+const struct sr_fib_entry* sr_fib_lookup(const struct sr_fib* fib, uint32_t dst)
+{
+    const struct sr_fib_slot* s;
+    uint32_t node = 0, ip;
+    unsigned int entry = 0;
+    int depth;
+
+    if (!fib)
+    { return 0; }
+
+    ip = ntohl(dst);
+    for (depth = 0; depth < 4; depth++)
+    {
+        s = &(fib->nodes[node][(ip >> (24 - 8 * depth)) & 0xff]);
+        if (s->entry)
+        { entry = s->entry; }
+        if (!s->child)
+        { break; }
+        node = s->child - 1;
+    }
+    return entry ? &(fib->entries[entry - 1]) : 0;
+} /* -- sr_fib_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_lookup_flow(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+const struct sr_fib_entry* sr_fib_lookup_flow(const struct sr_fib* fib,
+                                              uint32_t dst, uint32_t hash)
+{
+    const struct sr_fib_entry* e = sr_fib_lookup(fib, dst);
+
+    if (e && e->buckets)
+    { e = &(fib->entries[e->buckets[hash & (SR_FIB_BUCKETS - 1)]]); }
+    return e;
+} /* -- sr_fib_lookup_flow -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_fib_free(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_fib_free(struct sr_fib* fib)
+{
+    struct sr_fib* retired;
+    unsigned int i;
+
+    for (; fib; fib = retired)
+    {
+        retired = fib->retired;
+        for (i = 0; i < fib->nentries; i++)
+        { free(fib->entries[i].buckets); }
+        free(fib->nodes);
+        free(fib->entries);
+        free(fib);
+    }
+} /* -- sr_fib_free -- */
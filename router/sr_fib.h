@@ -0,0 +1,109 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_fib.h
+ *
+ * Description:
+ *
+ * The forwarding table: what the routing table (sr_rt.h) and the
+ * interfaces compile down to for the packet path.  One lookup of a
+ * destination says what to do with it:
+ *
+ *   SR_FIB_FORWARD  out of ifindex towards nexthop (the destination
+ *                   itself for connected routes, whose gateway is 0),
+ *                   through the adjacency (sr_adj.h) for the pair when
+ *                   the next hop is fixed
+ *   SR_FIB_LOCAL    one of the router's own addresses, a /32 per
+ *                   interface
+ *   SR_FIB_DROP     limited broadcast, and the directed broadcast of
+ *                   every connected route, neither of which we forward
+ *
+ * and no entry at all means no route.  Prefixes are expanded into a
+ * multibit trie of 8 bit strides, so a lookup is at most four indexed
+ * loads whatever the table size.  Longer prefixes win; between equal
+ * ones local beats drop beats a route.
+ *
+ * Routes to the same prefix by different paths are an equal cost set,
+ * and sr_fib_lookup_flow() picks one by the packet's flow hash
+ * (sr_pkt.h) from SR_FIB_BUCKETS buckets.  Buckets go to paths by
+ * rendezvous hashing, so adding or removing a path and rebuilding only
+ * moves the flows of the buckets it gains or loses.  A repeated route
+ * by the same path replaces the earlier one, as in sr_lpm().
+ *
+ * The table is built whole by sr_fib_build() once the interfaces are
+ * known (sr_init_interfaces()), and is read without locking.  Readers
+ * are not tracked, so a table replaced by a rebuild is never freed
+ * under them: it is kept until the table replacing it is freed.
+ * Rebuilds are expected once per session (VNS hardware info), not per
+ * route change.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_FIB_H
+#define SR_FIB_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_FIB_BUCKETS 256          /* per equal cost set, power of two */
+
+struct sr_instance;
+struct sr_rt;
+struct sr_adj;
+
+enum sr_fib_type
+{
+    SR_FIB_FORWARD,
+    SR_FIB_LOCAL,
+    SR_FIB_DROP
+};
+
+struct sr_fib_entry
+{
+    uint8_t  type;              /* enum sr_fib_type */
+    int      ifindex;           /* out (forward) or owning (local), else -1 */
+    uint32_t nexthop;           /* network byte order, 0 if connected */
+    struct sr_rt* rt;           /* the route a forward entry came from */
+    struct sr_adj* adj;         /* shared, 0 for connected routes */
+    uint16_t next;              /* next path of its set, index + 1 */
+    uint16_t* buckets;          /* flow hash to path index, 0 for one path */
+};
+
+struct sr_fib_slot
+{
+    uint32_t child;             /* node index + 1, 0 for none */
+    uint16_t entry;             /* entry index + 1, 0 for none */
+    uint8_t  plen;              /* prefix length of the entry */
+};
+
+struct sr_fib
+{
+    struct sr_fib_slot (*nodes)[256];   /* nodes[0] is the root */
+    unsigned int nnodes;
+    struct sr_fib_entry* entries;
+    unsigned int nentries;
+    struct sr_fib* retired;     /* the table this one replaced */
+};
+
+/* Compiles sr's routing table and interfaces into sr->fib, replacing
+   (and freeing) any previous table.  0 on success. */
+int sr_fib_build(struct sr_instance* sr);
+
+/* The entry for dst (network byte order), 0 if nothing matches or there
+   is no table. */
+const struct sr_fib_entry* sr_fib_lookup(const struct sr_fib* fib, uint32_t dst);
+
+/* The same, narrowed to one path of an equal cost set by a flow hash. */
+const struct sr_fib_entry* sr_fib_lookup_flow(const struct sr_fib* fib,
+                                              uint32_t dst, uint32_t hash);
+
+/* The next hop of a forward entry for dst. */
+#define sr_fib_nexthop(e, dst) ((e)->nexthop ? (e)->nexthop : (dst))
+
+/* Frees fib and every table it replaced. */
+void sr_fib_free(struct sr_fib* fib);
+
+#endif /* -- SR_FIB_H -- */
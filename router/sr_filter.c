@@ -0,0 +1,436 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_filter.c
+ *
+ * Description:
+ *
+ * Capture filter compiler and interpreter, see sr_filter.h
+ *
+ * A recursive descent parser emits instructions in postfix order: every
+ * test pushes one truth value, and/or pop two and push one, not flips the
+ * top.  The interpreter is a single loop over the program with a small
+ * fixed stack; the parser rejects anything that would need a deeper one.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <arpa/inet.h>
+
+#include "sr_protocol.h"
+#include "sr_dumper.h"
+#include "sr_filter.h"
+
+#define IPPROTO_TCP_ 6
+#define IPPROTO_UDP_ 17
+
+enum sr_filter_op
+{
+    OP_TRUE,
+    OP_ETHERTYPE,       /* ethertype == k */
+    OP_PROTO,           /* ip && ip_p == k */
+    OP_SRCNET,          /* ip && (ip_src & mask) == k */
+    OP_DSTNET,          /* ip && (ip_dst & mask) == k */
+    OP_SRCPORT,         /* tcp/udp && sport == k */
+    OP_DSTPORT,         /* tcp/udp && dport == k */
+    OP_IFACE,           /* interface name == names[k] */
+    OP_DIR,             /* direction == k */
+    OP_AND,
+    OP_OR,
+    OP_NOT
+};
+
+struct sr_filter_insn
+{
+    uint32_t op;
+    uint32_t k;         /* addresses and masks in network byte order */
+    uint32_t mask;
+};
+
+struct sr_filter
+{
+    struct sr_filter_insn* insn;
+    int len;
+    int cap;
+    char names[SR_FILTER_NAMES][sr_IFACE_NAMELEN];
+    int nnames;
+};
+
+/*---------------------------------------------------------------------
+ * compiler
+ *---------------------------------------------------------------------*/
+
+struct sr_filter_parser
+{
+    const char* p;              /* next unread character */
+    char tok[64];               /* current token, "" at the end */
+    struct sr_filter* f;
+    int depth;                  /* stack depth at this point */
+    char* err;
+    size_t errlen;
+    int failed;
+};
+
+static void sr_filter_error(struct sr_filter_parser* ps, const char* what)
+{
+    if (!ps->failed)
+    {
+        snprintf(ps->err, ps->errlen, "%s near '%s'", what,
+                 ps->tok[0] ? ps->tok : "end of expression");
+    }
+    ps->failed = 1;
+}
+
+/* read the next token: a word, or one of ( ) ! && || */
+static void sr_filter_next(struct sr_filter_parser* ps)
+{
+    const char* p = ps->p;
+    size_t n = 0;
+
+    while (isspace((unsigned char)*p))
+    { p++; }
+
+    if (*p == '(' || *p == ')' || *p == '!')
+    { n = 1; }
+    else if ((p[0] == '&' && p[1] == '&') || (p[0] == '|' && p[1] == '|'))
+    { n = 2; }
+    else
+    {
+        while (p[n] && !isspace((unsigned char)p[n]) &&
+               !strchr("()!&|", p[n]))
+        { n++; }
+    }
+
+    if (n >= sizeof(ps->tok))
+    {
+        sr_filter_error(ps, "token too long");
+        n = 0;
+    }
+    memcpy(ps->tok, p, n);
+    ps->tok[n] = 0;
+    ps->p = p + n;
+}
+
+static int sr_filter_is(struct sr_filter_parser* ps, const char* a, const char* b)
+{
+    return !strcmp(ps->tok, a) || (b && !strcmp(ps->tok, b));
+}
+
+static void sr_filter_emit(struct sr_filter_parser* ps, uint32_t op,
+                           uint32_t k, uint32_t mask)
+{
+    struct sr_filter* f = ps->f;
+
+    if (f->len == f->cap)
+    {
+        int cap = f->cap ? f->cap * 2 : 16;
+        struct sr_filter_insn* insn = realloc(f->insn, cap * sizeof(*insn));
+        if (!insn)
+        {
+            sr_filter_error(ps, "out of memory");
+            return;
+        }
+        f->insn = insn;
+        f->cap = cap;
+    }
+    f->insn[f->len].op = op;
+    f->insn[f->len].k = k;
+    f->insn[f->len].mask = mask;
+    f->len++;
+
+    /* tests push, binary operators pop one net, not leaves it alone */
+    if (op == OP_AND || op == OP_OR)
+    { ps->depth--; }
+    else if (op != OP_NOT && ++ps->depth > SR_FILTER_STACK)
+    { sr_filter_error(ps, "expression nested too deeply"); }
+}
+
+/* a test on the source, destination or (side == 0) either */
+static void sr_filter_emit_side(struct sr_filter_parser* ps, int side,
+                                uint32_t src_op, uint32_t dst_op,
+                                uint32_t k, uint32_t mask)
+{
+    if (side != 'd')
+    { sr_filter_emit(ps, src_op, k, mask); }
+    if (side != 's')
+    { sr_filter_emit(ps, dst_op, k, mask); }
+    if (!side)
+    { sr_filter_emit(ps, OP_OR, 0, 0); }
+}
+
+static void sr_filter_expr(struct sr_filter_parser* ps);
+
+static void sr_filter_primitive(struct sr_filter_parser* ps)
+{
+    int side = 0;
+
+    if (sr_filter_is(ps, "ip", 0))
+    { sr_filter_emit(ps, OP_ETHERTYPE, ethertype_ip, 0); }
+    else if (sr_filter_is(ps, "arp", 0))
+    { sr_filter_emit(ps, OP_ETHERTYPE, ethertype_arp, 0); }
+    else if (sr_filter_is(ps, "icmp", 0))
+    { sr_filter_emit(ps, OP_PROTO, ip_protocol_icmp, 0); }
+    else if (sr_filter_is(ps, "tcp", 0))
+    { sr_filter_emit(ps, OP_PROTO, IPPROTO_TCP_, 0); }
+    else if (sr_filter_is(ps, "udp", 0))
+    { sr_filter_emit(ps, OP_PROTO, IPPROTO_UDP_, 0); }
+    else if (sr_filter_is(ps, "in", 0))
+    { sr_filter_emit(ps, OP_DIR, SR_DUMP_IN, 0); }
+    else if (sr_filter_is(ps, "out", 0))
+    { sr_filter_emit(ps, OP_DIR, SR_DUMP_OUT, 0); }
+    else if (sr_filter_is(ps, "iface", 0))
+    {
+        struct sr_filter* f = ps->f;
+
+        sr_filter_next(ps);
+        if (!ps->tok[0] || strlen(ps->tok) >= sr_IFACE_NAMELEN)
+        {
+            sr_filter_error(ps, "expected an interface name");
+            return;
+        }
+        if (f->nnames == SR_FILTER_NAMES)
+        {
+            sr_filter_error(ps, "too many interface names");
+            return;
+        }
+        strcpy(f->names[f->nnames], ps->tok);
+        sr_filter_emit(ps, OP_IFACE, f->nnames++, 0);
+    }
+    else
+    {
+        if (sr_filter_is(ps, "src", 0) || sr_filter_is(ps, "dst", 0))
+        {
+            side = ps->tok[0];
+            sr_filter_next(ps);
+        }
+
+        if (sr_filter_is(ps, "host", 0) || sr_filter_is(ps, "net", 0))
+        {
+            int net = ps->tok[0] == 'n';
+            char* slash;
+            struct in_addr addr;
+            long plen = 32;
+            uint32_t mask;
+
+            sr_filter_next(ps);
+            if ((slash = strchr(ps->tok, '/')))
+            {
+                char* end;
+                *slash = 0;
+                plen = strtol(slash + 1, &end, 10);
+                if (!net || *end || plen < 0 || plen > 32)
+                {
+                    sr_filter_error(ps, "bad prefix length");
+                    return;
+                }
+            }
+            if (!inet_aton(ps->tok, &addr))
+            {
+                sr_filter_error(ps, "expected an IPv4 address");
+                return;
+            }
+            mask = plen ? htonl(0xffffffffU << (32 - plen)) : 0;
+            sr_filter_emit_side(ps, side, OP_SRCNET, OP_DSTNET,
+                                addr.s_addr & mask, mask);
+        }
+        else if (sr_filter_is(ps, "port", 0))
+        {
+            char* end;
+            long port;
+
+            sr_filter_next(ps);
+            port = strtol(ps->tok, &end, 10);
+            if (!ps->tok[0] || *end || port < 0 || port > 65535)
+            {
+                sr_filter_error(ps, "expected a port number");
+                return;
+            }
+            sr_filter_emit_side(ps, side, OP_SRCPORT, OP_DSTPORT, port, 0);
+        }
+        else
+        {
+            sr_filter_error(ps, "unknown primitive");
+            return;
+        }
+    }
+    sr_filter_next(ps);
+}
+
+static void sr_filter_factor(struct sr_filter_parser* ps)
+{
+    if (ps->failed)
+    { return; }
+
+    if (sr_filter_is(ps, "not", "!"))
+    {
+        sr_filter_next(ps);
+        sr_filter_factor(ps);
+        sr_filter_emit(ps, OP_NOT, 0, 0);
+    }
+    else if (sr_filter_is(ps, "(", 0))
+    {
+        sr_filter_next(ps);
+        sr_filter_expr(ps);
+        if (!sr_filter_is(ps, ")", 0))
+        {
+            sr_filter_error(ps, "expected ')'");
+            return;
+        }
+        sr_filter_next(ps);
+    }
+    else
+    { sr_filter_primitive(ps); }
+}
+
+static void sr_filter_term(struct sr_filter_parser* ps)
+{
+    sr_filter_factor(ps);
+    while (!ps->failed && sr_filter_is(ps, "and", "&&"))
+    {
+        sr_filter_next(ps);
+        sr_filter_factor(ps);
+        sr_filter_emit(ps, OP_AND, 0, 0);
+    }
+}
+
+static void sr_filter_expr(struct sr_filter_parser* ps)
+{
+    sr_filter_term(ps);
+    while (!ps->failed && sr_filter_is(ps, "or", "||"))
+    {
+        sr_filter_next(ps);
+        sr_filter_term(ps);
+        sr_filter_emit(ps, OP_OR, 0, 0);
+    }
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_filter_compile(..)
+ * Scope:  Global
+ *
+ * An empty expression compiles to a program that matches everything.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_filter* sr_filter_compile(const char* expr, char* err, size_t errlen)
+{
+    struct sr_filter_parser ps;
+
+    memset(&ps, 0, sizeof(ps));
+    ps.p = expr;
+    ps.err = err;
+    ps.errlen = errlen;
+    if (!(ps.f = calloc(1, sizeof(struct sr_filter))))
+    {
+        snprintf(err, errlen, "out of memory");
+        return 0;
+    }
+
+    sr_filter_next(&ps);
+    if (!ps.tok[0])
+    { sr_filter_emit(&ps, OP_TRUE, 0, 0); }
+    else
+    { sr_filter_expr(&ps); }
+
+    if (!ps.failed && ps.tok[0])
+    { sr_filter_error(&ps, "unexpected token"); }
+
+    if (ps.failed)
+    {
+        sr_filter_free(ps.f);
+        return 0;
+    }
+    return ps.f;
+} /* -- sr_filter_compile -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_filter_match(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_filter_match(const struct sr_filter* f, const uint8_t* frame,
+                    unsigned int len, const char* iface, int dir)
+{
+    const struct sr_filter_insn* in = f->insn;
+    const struct sr_filter_insn* end = f->insn + f->len;
+    const sr_ethernet_hdr_t* ehdr = (const sr_ethernet_hdr_t*)frame;
+    const sr_ip_hdr_t* ihdr = 0;
+    const uint8_t* l4 = 0;      /* tcp/udp ports, first fragment only */
+    uint16_t ethertype = 0, port;
+    uint8_t st[SR_FILTER_STACK];
+    int sp = 0;
+
+    if (len >= sizeof(sr_ethernet_hdr_t))
+    { ethertype = ntohs(ehdr->ether_type); }
+
+    if (ethertype == ethertype_ip &&
+        len >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t))
+    {
+        unsigned int hl;
+
+        ihdr = (const sr_ip_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+        hl = ihdr->ip_hl * 4;
+        if ((ihdr->ip_p == IPPROTO_TCP_ || ihdr->ip_p == IPPROTO_UDP_) &&
+            !(ntohs(ihdr->ip_off) & IP_OFFMASK) &&
+            len >= sizeof(sr_ethernet_hdr_t) + hl + 4)
+        { l4 = (const uint8_t*)ihdr + hl; }
+    }
+
+    for (; in < end; in++)
+    {
+        switch (in->op)
+        {
+            case OP_TRUE:
+                st[sp++] = 1;
+                break;
+            case OP_ETHERTYPE:
+                st[sp++] = ethertype == in->k;
+                break;
+            case OP_PROTO:
+                st[sp++] = ihdr && ihdr->ip_p == in->k;
+                break;
+            case OP_SRCNET:
+                st[sp++] = ihdr && (ihdr->ip_src & in->mask) == in->k;
+                break;
+            case OP_DSTNET:
+                st[sp++] = ihdr && (ihdr->ip_dst & in->mask) == in->k;
+                break;
+            case OP_SRCPORT:
+            case OP_DSTPORT:
+                if (l4)
+                { memcpy(&port, l4 + (in->op == OP_DSTPORT ? 2 : 0), 2); }
+                st[sp++] = l4 && ntohs(port) == in->k;
+                break;
+            case OP_IFACE:
+                st[sp++] = iface &&
+                    !strncmp(iface, f->names[in->k], sr_IFACE_NAMELEN);
+                break;
+            case OP_DIR:
+                st[sp++] = dir == (int)in->k;
+                break;
+            case OP_AND:
+                sp--;
+                st[sp - 1] = st[sp - 1] && st[sp];
+                break;
+            case OP_OR:
+                sp--;
+                st[sp - 1] = st[sp - 1] || st[sp];
+                break;
+            case OP_NOT:
+                st[sp - 1] = !st[sp - 1];
+                break;
+        }
+    }
+    return st[0];
+} /* -- sr_filter_match -- */
+
+void sr_filter_free(struct sr_filter* f)
+{
+    if (f)
+    {
+        free(f->insn);
+        free(f);
+    }
+} /* -- sr_filter_free -- */
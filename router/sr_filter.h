@@ -0,0 +1,53 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_filter.h
+ *
+ * Description:
+ *
+ * Capture filters.  A filter expression is compiled once into a small
+ * postfix bytecode program which is then run against each frame before
+ * it is copied into the capture.  The language is a subset of tcpdump's:
+ *
+ *   primitives   ip  arp  icmp  tcp  udp
+ *                [src|dst] host A.B.C.D
+ *                [src|dst] net A.B.C.D/len
+ *                [src|dst] port N          (tcp or udp, first fragment)
+ *                iface NAME                (interface the frame was on)
+ *                in  out                   (direction)
+ *   operators    not / !   and / &&   or / ||   ( ... )
+ *
+ * Without src/dst, host, net and port match either side.  Address tests
+ * only look at IP headers, not ARP.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_FILTER_H
+#define SR_FILTER_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <stddef.h>
+
+#define SR_FILTER_STACK 32     /* deepest expression nesting */
+#define SR_FILTER_NAMES 8      /* distinct interface names */
+#define SR_FILTER_DEPTH (14 + 60 + 4) /* most of a frame a program reads:
+                                         ethernet, ip with options, ports */
+
+struct sr_filter;
+
+/* Compiles expr, or returns 0 and describes the problem in err. */
+struct sr_filter* sr_filter_compile(const char* expr, char* err, size_t errlen);
+
+/* Runs the program over one frame, non zero if it matches.  dir is
+   SR_DUMP_IN or SR_DUMP_OUT. */
+int sr_filter_match(const struct sr_filter* f, const uint8_t* frame,
+                    unsigned int len, const char* iface, int dir);
+
+void sr_filter_free(struct sr_filter* f);
+
+#endif /* -- SR_FILTER_H -- */
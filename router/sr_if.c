@@ -24,6 +24,7 @@
 
 #include "sr_if.h"
 #include "sr_router.h"
+#include "sr_log.h"
 
 /*--------------------------------------------------------------------- 
  * Method: sr_get_interface
@@ -58,11 +59,13 @@ struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name)
  * Method: sr_add_interface(..)
  * Scope: Global
  *
- * Add and interface to the router's list
+ * Add and interface to the router's list, -1 if there is no room for
+ * it (the names come from the server, so more than SR_IF_MAX is not
+ * ours to assert on)
  *
  *---------------------------------------------------------------------*/
 
-void sr_add_interface(struct sr_instance* sr, const char* name)
+int sr_add_interface(struct sr_instance* sr, const char* name)
 {
     struct sr_if* if_walker = 0;
 
@@ -70,26 +73,29 @@ void sr_add_interface(struct sr_instance* sr, const char* name)
     assert(name);
     assert(sr);
 
-    /* -- empty list special case -- */
-    if(sr->if_list == 0)
+    /* -- the ifindex is the next free slot of the table -- */
+    if(sr->nif == SR_IF_MAX)
     {
-        sr->if_list = (struct sr_if*)malloc(sizeof(struct sr_if));
-        assert(sr->if_list);
-        sr->if_list->next = 0;
-        strncpy(sr->if_list->name,name,sr_IFACE_NAMELEN);
-        return;
+        sr_log(SR_LOG_ERR, "** Error: no room for interface %s, %d is the most\n",
+               name, SR_IF_MAX);
+        return -1;
     }
 
-    /* -- find the end of the list -- */
-    if_walker = sr->if_list;
-    while(if_walker->next)
-    {if_walker = if_walker->next; }
-
-    if_walker->next = (struct sr_if*)malloc(sizeof(struct sr_if));
-    assert(if_walker->next);
-    if_walker = if_walker->next;
-    strncpy(if_walker->name,name,sr_IFACE_NAMELEN);
+    if_walker = (struct sr_if*)malloc(sizeof(struct sr_if));
+    assert(if_walker);
+    strncpy(if_walker->name,name,sr_IFACE_NAMELEN - 1);
+    if_walker->name[sr_IFACE_NAMELEN - 1] = 0;
+    if_walker->ifindex = sr->nif;
+    if_walker->mtu = SR_IF_MTU;
     if_walker->next = 0;
+
+    /* -- the list keeps the same order -- */
+    if(sr->if_list == 0)
+    { sr->if_list = if_walker; }
+    else
+    { sr->if_table[sr->nif - 1]->next = if_walker; }
+    sr->if_table[sr->nif++] = if_walker;
+    return 0;
 } /* -- sr_add_interface -- */ 
 
 /*--------------------------------------------------------------------- 
@@ -107,9 +113,7 @@ void sr_set_ether_addr(struct sr_instance* sr, const unsigned char* addr)
     /* -- REQUIRES -- */
     assert(sr->if_list);
     
-    if_walker = sr->if_list;
-    while(if_walker->next)
-    {if_walker = if_walker->next; }
+    if_walker = sr->if_table[sr->nif - 1];
 
     /* -- copy address -- */
     memcpy(if_walker->addr,addr,6);
@@ -131,15 +135,57 @@ void sr_set_ether_ip(struct sr_instance* sr, uint32_t ip_nbo)
     /* -- REQUIRES -- */
     assert(sr->if_list);
     
-    if_walker = sr->if_list;
-    while(if_walker->next)
-    {if_walker = if_walker->next; }
+    if_walker = sr->if_table[sr->nif - 1];
 
     /* -- copy address -- */
     if_walker->ip = ip_nbo;
 
 } /* -- sr_set_ether_ip -- */
 
+/*--------------------------------------------------------------------- 
+ * Method: sr_set_mtus(..)
+ * Scope: Global
+ *
+ * set interface MTUs from a "name=mtu[,name=mtu...]" list, 0 if every
+ * one named exists and the MTU is one IPv4 allows
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_set_mtus(struct sr_instance* sr, const char* spec)
+{
+    char name[sr_IFACE_NAMELEN + 1];
+    struct sr_if* iface;
+    unsigned int mtu;
+    int n;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(spec);
+
+    while(*spec)
+    {
+        if(sscanf(spec, "%32[^=]=%u%n", name, &mtu, &n) != 2 ||
+           (spec[n] != ',' && spec[n] != 0))
+        {
+            fprintf(stderr, "bad MTU list at %s\n", spec);
+            return -1;
+        }
+        if(!(iface = sr_get_interface(sr, name)))
+        {
+            fprintf(stderr, "no interface %s for its MTU\n", name);
+            return -1;
+        }
+        if(mtu < SR_IF_MINMTU || mtu > 0xffff)
+        {
+            fprintf(stderr, "MTU %u of %s out of range\n", mtu, name);
+            return -1;
+        }
+        iface->mtu = mtu;
+        spec += n + (spec[n] == ',');
+    }
+    return 0;
+} /* -- sr_set_mtus -- */
+
 /*--------------------------------------------------------------------- 
  * Method: sr_print_if_list(..)
  * Scope: Global
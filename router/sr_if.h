@@ -26,8 +26,30 @@
 
 #include "sr_protocol.h"
 
+#define SR_IF_MAX 32            /* size of sr_instance.if_table */
+#define SR_IF_MTU 1500          /* default MTU, ethernet's */
+#define SR_IF_MINMTU 68         /* smallest an IPv4 link may have */
+
 struct sr_instance;
 
+/* ----------------------------------------------------------------------------
+ * struct sr_icmp_tmpl
+ *
+ * Ready-made Ethernet+IP+ICMP(type 3 layout) frame for ICMP errors leaving
+ * an interface.  Only the addresses, type/code, the quoted header and the
+ * checksums are stamped in per error.
+ *
+ * -------------------------------------------------------------------------- */
+
+#define SR_ICMP_ERR_LEN (sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + \
+                         sizeof(sr_icmp_t3_hdr_t))
+
+struct sr_icmp_tmpl
+{
+  uint8_t  frame[SR_ICMP_ERR_LEN];
+  uint32_t ip_sum;              /* IP header sum with both addresses zero */
+};
+
 /* ----------------------------------------------------------------------------
  * struct sr_if
  *
@@ -41,13 +63,17 @@ struct sr_if
   unsigned char addr[ETHER_ADDR_LEN];
   uint32_t ip;
   uint32_t speed;
+  uint16_t mtu;                 /* largest IP datagram it sends */
+  int ifindex;                  /* slot in sr->if_table, dense from 0 */
+  struct sr_icmp_tmpl icmp_tmpl;
   struct sr_if* next;
 };
 
 struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name);
-void sr_add_interface(struct sr_instance*, const char*);
+int  sr_add_interface(struct sr_instance*, const char*);
 void sr_set_ether_addr(struct sr_instance*, const unsigned char*);
 void sr_set_ether_ip(struct sr_instance*, uint32_t ip_nbo);
+int  sr_set_mtus(struct sr_instance*, const char* spec);
 void sr_print_if_list(struct sr_instance*);
 void sr_print_if(struct sr_if*);
 
@@ -0,0 +1,165 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_latency.c
+ *
+ * Description:
+ *
+ * Per thread latency histograms, see sr_latency.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sr_latency.h"
+
+#define SR_LP(id, name) name,
+const char* const sr_lat_names[SR_NLAT] = { SR_LAT_PATHS };
+#undef SR_LP
+
+struct sr_latency_block
+{
+    uint64_t count[SR_NLAT][SR_LAT_BUCKETS];
+    uint64_t sum[SR_NLAT];
+    uint64_t max[SR_NLAT];
+    struct sr_latency_block* next;
+};
+
+static __thread struct sr_latency_block* self = 0;
+
+/* blocks are only ever added, and live until exit since their threads do */
+static struct sr_latency_block* blocks = 0;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* recorded into when a block can't be allocated, never read */
+static struct sr_latency_block sr_latency_lost;
+
+static struct sr_latency_block* sr_latency_attach(void)
+{
+    struct sr_latency_block* b;
+
+    if (posix_memalign((void**)&b, 64, sizeof(struct sr_latency_block)) != 0)
+    { return self = &sr_latency_lost; }
+    memset(b, 0, sizeof(struct sr_latency_block));
+
+    pthread_mutex_lock(&blocks_lock);
+    b->next = blocks;
+    __atomic_store_n(&blocks, b, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&blocks_lock);
+
+    return self = b;
+}
+
+/* exact below 2 * SR_LAT_SUB, then SR_LAT_SUB buckets per power of two */
+static unsigned int sr_latency_bucket(uint64_t v)
+{
+    int m;
+
+    if (v < 2 * SR_LAT_SUB)
+    { return (unsigned int)v; }
+
+    m = 63 - __builtin_clzll(v);
+    if (m > SR_LAT_MAXBIT)
+    { return SR_LAT_BUCKETS - 1; }
+    return 2 * SR_LAT_SUB + (m - SR_LAT_SUB_BITS - 1) * SR_LAT_SUB +
+           (unsigned int)((v >> (m - SR_LAT_SUB_BITS)) - SR_LAT_SUB);
+}
+
+/* largest value that lands in bucket i */
+static uint64_t sr_latency_upper(unsigned int i)
+{
+    unsigned int shift;
+
+    if (i < 2 * SR_LAT_SUB)
+    { return i; }
+
+    i -= 2 * SR_LAT_SUB;
+    shift = i / SR_LAT_SUB + 1;
+    return ((uint64_t)(SR_LAT_SUB + i % SR_LAT_SUB + 1) << shift) - 1;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_latency_now(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+uint64_t sr_latency_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+} /* -- sr_latency_now -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_latency_record(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_latency_record(int path, uint64_t ns)
+{
+    struct sr_latency_block* b = self ? self : sr_latency_attach();
+
+    b->count[path][sr_latency_bucket(ns)]++;
+    b->sum[path] += ns;
+    if (ns > b->max[path])
+    { b->max[path] = ns; }
+} /* -- sr_latency_record -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_latency_read(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_latency_read(int path, struct sr_latency_snap* out)
+{
+    struct sr_latency_block* b;
+    uint64_t c, max;
+    unsigned int i;
+
+    memset(out, 0, sizeof(struct sr_latency_snap));
+    for (b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next)
+    {
+        for (i = 0; i < SR_LAT_BUCKETS; i++)
+        {
+            c = __atomic_load_n(&(b->count[path][i]), __ATOMIC_RELAXED);
+            out->count[i] += c;
+            out->n += c;
+        }
+        out->sum += __atomic_load_n(&(b->sum[path]), __ATOMIC_RELAXED);
+        max = __atomic_load_n(&(b->max[path]), __ATOMIC_RELAXED);
+        if (max > out->max)
+        { out->max = max; }
+    }
+} /* -- sr_latency_read -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_latency_quantile(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+uint64_t sr_latency_quantile(const struct sr_latency_snap* s, double q)
+{
+    uint64_t rank, seen = 0, v;
+    unsigned int i;
+
+    if (s->n == 0)
+    { return 0; }
+
+    rank = (uint64_t)(q * s->n);
+    if (rank < q * s->n || rank == 0)
+    { rank++; }
+
+    for (i = 0; i < SR_LAT_BUCKETS; i++)
+    {
+        if ((seen += s->count[i]) >= rank)
+        { break; }
+    }
+    v = sr_latency_upper(i < SR_LAT_BUCKETS ? i : SR_LAT_BUCKETS - 1);
+    return v < s->max ? v : s->max;
+} /* -- sr_latency_quantile -- */
@@ -0,0 +1,69 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_latency.h
+ *
+ * Description:
+ *
+ * Per packet processing latency, from the moment a frame has been read
+ * off the VNS socket to the moment it (or the frame sent in answer to
+ * it) is written back.  The receive time travels in the pool buffer
+ * (sr_pbuf.rx_ns) together with the path the packet took, and
+ * sr_send_packet() records the difference.
+ *
+ * Each path has an HDR style histogram: exact below 2^(SR_LAT_SUB_BITS+1)
+ * ns, then SR_LAT_SUB buckets per power of two, so any recorded value is
+ * known to within 1/SR_LAT_SUB (under 1%).  As with sr_stats.h every
+ * thread records into its own block and readers sum the blocks.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_LATENCY_H
+#define SR_LATENCY_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_LAT_SUB_BITS 7
+#define SR_LAT_SUB      (1 << SR_LAT_SUB_BITS)
+#define SR_LAT_MAXBIT   39      /* top power of two tracked, ~550s */
+#define SR_LAT_BUCKETS  (2 * SR_LAT_SUB + (SR_LAT_MAXBIT - SR_LAT_SUB_BITS) * SR_LAT_SUB)
+
+/* every path: id, exported name */
+#define SR_LAT_PATHS \
+  SR_LP(SR_LAT_FORWARD,    "forwarded") \
+  SR_LP(SR_LAT_ARPQ,       "arp_queued") \
+  SR_LP(SR_LAT_ICMP,       "icmp_generated") \
+  SR_LP(SR_LAT_ARP_REPLY,  "arp_reply")
+
+#define SR_LP(id, name) id,
+enum sr_lat_path { SR_LAT_PATHS SR_NLAT };
+#undef SR_LP
+
+extern const char* const sr_lat_names[SR_NLAT];
+
+/* one path's histogram, summed over all threads */
+struct sr_latency_snap
+{
+    uint64_t count[SR_LAT_BUCKETS];
+    uint64_t n;
+    uint64_t sum;               /* ns */
+    uint64_t max;               /* ns */
+};
+
+/* CLOCK_MONOTONIC in ns, what sr_pbuf.rx_ns holds */
+uint64_t sr_latency_now(void);
+
+/* Adds one sample of ns to path's histogram of the calling thread. */
+void sr_latency_record(int path, uint64_t ns);
+
+/* Sums path's histograms over all threads. */
+void sr_latency_read(int path, struct sr_latency_snap* out);
+
+/* Value at quantile q (0..1) of a snapshot, to histogram precision. */
+uint64_t sr_latency_quantile(const struct sr_latency_snap* s, double q);
+
+#endif /* -- SR_LATENCY_H -- */
@@ -0,0 +1,47 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_log.c
+ *
+ * Description:
+ *
+ * Leveled logging, see sr_log.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "sr_log.h"
+
+int sr_log_level = SR_LOG_LEVEL;
+
+static const char* sr_log_names[] =
+{ "none", "err", "warn", "info", "debug", "trace" };
+
+void sr_log_write(int level, const char* fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(level <= SR_LOG_WARN ? stderr : stdout, fmt, ap);
+    va_end(ap);
+} /* -- sr_log_write -- */
+
+int sr_log_parse_level(const char* s)
+{
+    int i;
+    char* end;
+
+    for (i = SR_LOG_NONE; i <= SR_LOG_TRACE; i++)
+    {
+        if (!strcmp(s, sr_log_names[i]))
+        { return i; }
+    }
+
+    i = strtol(s, &end, 10);
+    if (*s && !*end && i >= SR_LOG_NONE && i <= SR_LOG_TRACE)
+    { return i; }
+
+    return -1;
+} /* -- sr_log_parse_level -- */
@@ -0,0 +1,51 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_log.h
+ *
+ * Description:
+ *
+ * Leveled logging.  Anything above SR_LOG_LEVEL is compiled out entirely
+ * (the level test is a constant the compiler folds away), anything at or
+ * below it is still filtered at runtime against sr_log_level.
+ *
+ * Per-packet chatter belongs at SR_LOG_DEBUG (anomalies: bad lengths,
+ * checksums, drops) or SR_LOG_TRACE (narration of the path a packet takes),
+ * so a release build, which compiles at SR_LOG_WARN, formats nothing
+ * per packet.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_LOG_H
+#define SR_LOG_H
+
+#define SR_LOG_NONE  0
+#define SR_LOG_ERR   1
+#define SR_LOG_WARN  2
+#define SR_LOG_INFO  3
+#define SR_LOG_DEBUG 4
+#define SR_LOG_TRACE 5
+
+/* compile time threshold, override with -DSR_LOG_LEVEL=... */
+#ifndef SR_LOG_LEVEL
+#ifdef _DEBUG_
+#define SR_LOG_LEVEL SR_LOG_TRACE
+#else
+#define SR_LOG_LEVEL SR_LOG_WARN
+#endif
+#endif
+
+/* runtime threshold, defaults to SR_LOG_LEVEL */
+extern int sr_log_level;
+
+#define sr_log(level, x, args...) \
+  do { if ((level) <= SR_LOG_LEVEL && (level) <= sr_log_level) \
+         sr_log_write((level), x, ## args); } while (0)
+
+/* Writes one message, errors and warnings to stderr, the rest to stdout.
+   Use sr_log() rather than calling this directly. */
+void sr_log_write(int level, const char* fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+/* Parses a level given by name ("warn") or number, -1 if invalid. */
+int sr_log_parse_level(const char* s);
+
+#endif /* -- SR_LOG_H -- */
@@ -23,15 +23,26 @@
 #include <string.h>
 #include <unistd.h>
 #include <pwd.h>
+#include <signal.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 
 #ifdef _LINUX_
 #include <getopt.h>
 #endif /* _LINUX_ */
 
-#include "sr_dumper.h"
+#include "sr_capture.h"
 #include "sr_router.h"
 #include "sr_rt.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+#include "sr_log.h"
+#include "sr_trace.h"
+#include "sr_stats.h"
+#include "sr_export.h"
+#include "sr_latency.h"
+#include "sr_if.h"
+#include "sr_slow.h"
 
 extern char* optarg;
 
@@ -50,6 +61,11 @@ static void sr_init_instance(struct sr_instance* );
 static void sr_destroy_instance(struct sr_instance* );
 static void sr_set_user(struct sr_instance* );
 static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable);
+static void sr_stop(int sig);
+static void sr_print_stats(struct sr_instance* sr);
+
+/* socket sr_stop() shuts down to end the main loop */
+static volatile int sr_stop_fd = -1;
 
 /*-----------------------------------------------------------------------------
  *---------------------------------------------------------------------------*/
@@ -65,11 +81,21 @@ int main(int argc, char **argv)
     unsigned int port = DEFAULT_PORT;
     unsigned int topo = DEFAULT_TOPO;
     char *logfile = 0;
+    char *tracefile = 0;
+    char *metrics = 0;
+    char *mtus = 0;
+    struct sr_capture_limits caplim = { 0, 0, 0 };
+    char *capfilter = 0;
+    unsigned int capsample = 1;
+    unsigned int icmp_rate = SR_ICMP_RL_RATE;
+    unsigned int icmp_burst = SR_ICMP_RL_BURST;
+    unsigned int icmp_plen = SR_ICMP_RL_PREFIXLEN;
+    unsigned int icmp_total = SR_ICMP_RL_TOTAL;
     struct sr_instance sr;
 
     printf("Using %s\n", VERSION_INFO);
 
-    while ((c = getopt(argc, argv, "hs:v:p:u:t:r:l:T:")) != EOF)
+    while ((c = getopt(argc, argv, "hs:v:p:u:t:r:l:C:G:W:f:N:T:R:d:b:m:M:")) != EOF)
     {
         switch (c)
         {
@@ -95,17 +121,55 @@ int main(int argc, char **argv)
             case 'l':
                 logfile = optarg;
                 break;
+            case 'C':
+                caplim.seg_size = (size_t)atoi((char *) optarg) * 1000000;
+                break;
+            case 'G':
+                caplim.seconds = atoi((char *) optarg);
+                break;
+            case 'W':
+                caplim.nfiles = atoi((char *) optarg);
+                break;
+            case 'f':
+                capfilter = optarg;
+                break;
+            case 'N':
+                capsample = atoi((char *) optarg);
+                break;
+            case 'b':
+                tracefile = optarg;
+                break;
+            case 'm':
+                metrics = optarg;
+                break;
             case 'r':
                 rtable = optarg;
                 break;
+            case 'M':
+                mtus = optarg;
+                break;
             case 'T':
                 template = optarg;
                 break;
+            case 'R':
+                sscanf(optarg, "%u:%u:%u:%u", &icmp_rate, &icmp_burst, &icmp_plen,
+                       &icmp_total);
+                break;
+            case 'd':
+                if((sr_log_level = sr_log_parse_level(optarg)) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
         } /* switch */
     } /* -- while -- */
 
     /* -- zero out sr instance -- */
     sr_init_instance(&sr);
+    sr_icmp_rl_init(&(sr.icmp_rl), icmp_rate, icmp_burst, icmp_plen,
+                    icmp_total);
+    sr.mtus = mtus;
 
     /* -- set up routing table from file -- */
     if(template == NULL) {
@@ -113,26 +177,67 @@ int main(int argc, char **argv)
         sr_load_rt_wrap(&sr, rtable);
     }
     else
-        strncpy(sr.template, template, 30);
+    {
+        strncpy(sr.template, template, sizeof(sr.template) - 1);
+        sr.template[sizeof(sr.template) - 1] = '\0';
+    }
 
     sr.topo_id = topo;
-    strncpy(sr.host,host,32);
+    strncpy(sr.host,host,sizeof(sr.host) - 1);
+    sr.host[sizeof(sr.host) - 1] = '\0';
 
     if(! user )
     { sr_set_user(&sr); }
     else
-    { strncpy(sr.user, user, 32); }
+    {
+        strncpy(sr.user, user, sizeof(sr.user) - 1);
+        sr.user[sizeof(sr.user) - 1] = '\0';
+    }
 
     /* -- set up file pointer for logging of raw packets -- */
     if(logfile != 0)
     {
-        sr.logfile = sr_dump_open(logfile,0,PACKET_DUMP_SIZE);
+        sr.logfile = sr_capture_open(logfile,0,PACKET_DUMP_SIZE,&caplim);
         if(!sr.logfile)
         {
             fprintf(stderr,"Error opening up dump file %s\n",
                     logfile);
             exit(1);
         }
+
+        if(capfilter != 0 || capsample > 1)
+        {
+            struct sr_filter* filter = 0;
+            char err[128];
+
+            if(capfilter && !(filter = sr_filter_compile(capfilter, err, sizeof(err))))
+            {
+                fprintf(stderr,"Error in capture filter: %s\n", err);
+                exit(1);
+            }
+            sr_capture_filter(sr.logfile, filter, capsample);
+        }
+    }
+
+    /* -- binary event trace, decode with sr_tracedump -- */
+    if(tracefile != 0)
+    {
+        if(sr_trace_open(tracefile) != 0)
+        {
+            fprintf(stderr,"Error opening up trace file %s\n",
+                    tracefile);
+            exit(1);
+        }
+    }
+
+    /* -- pick the checksum kernel for this CPU -- */
+    printf("Checksum kernel: %s\n", sr_cksum_init());
+
+    /* -- packet buffers must exist before the first frame is read -- */
+    if(sr_pbuf_pool_init(SR_PBUF_NUM) != 0)
+    {
+        fprintf(stderr,"Error allocating packet buffer pool\n");
+        exit(1);
     }
 
     Debug("Client %s connecting to Server %s:%d\n", sr.user, server, port);
@@ -159,6 +264,22 @@ int main(int argc, char **argv)
     /* call router init (for arp subsystem etc.) */
     sr_init(&sr);
 
+    /* -- stats for scraping, once interfaces and routes are known -- */
+    if(metrics != 0)
+    {
+        if(sr_export_open(&sr, metrics) != 0)
+        {
+            fprintf(stderr,"Error opening up metrics socket %s\n",
+                    metrics);
+            exit(1);
+        }
+    }
+
+    /* -- leave the main loop on ^C/kill so captures are closed cleanly -- */
+    sr_stop_fd = sr.sockfd;
+    signal(SIGINT, sr_stop);
+    signal(SIGTERM, sr_stop);
+
     /* -- whizbang main loop ;-) */
     while( sr_read_from_server(&sr) == 1);
 
@@ -178,11 +299,37 @@ static void usage(char* argv0)
     printf("Format: %s [-h] [-v host] [-s server] [-p port] \n",argv0);
     printf("           [-T template_name] [-u username] \n");
     printf("           [-t topo id] [-r routing table] \n");
-    printf("           [-l log file] \n");
+    printf("           [-l log file, .pcapng for pcapng] [-b binary trace file] \n");
+    printf("           [-C MB per log file] [-G seconds per log file] \n");
+    printf("           [-W log files kept] [-f capture filter] \n");
+    printf("           [-N capture 1 in N matching packets] \n");
+    printf("           [-m metrics unix socket] \n");
+    printf("           [-R icmp errors/s[:burst[:source prefix len[:total/s]]]] \n");
+    printf("           [-M iface=mtu[,iface=mtu...]] \n");
+    printf("           [-d log level: none|err|warn|info|debug|trace] \n");
     printf("   defaults server=%s port=%d host=%s  \n",
             DEFAULT_SERVER, DEFAULT_PORT, DEFAULT_HOST );
+    printf("   icmp limit=%d:%d:%d:%d (0 disables)\n",
+            SR_ICMP_RL_RATE, SR_ICMP_RL_BURST, SR_ICMP_RL_PREFIXLEN,
+            SR_ICMP_RL_TOTAL);
+    printf("   mtu=%d\n", SR_IF_MTU);
+    printf("   log level=%d, levels above it are compiled out\n", SR_LOG_LEVEL);
 } /* -- usage -- */
 
+/*-----------------------------------------------------------------------------
+ * Method: sr_stop(..)
+ * Scope: local
+ *
+ * Signal handler: shutting the socket down makes sr_read_from_server()
+ * see end of file, so main returns through sr_destroy_instance().
+ *---------------------------------------------------------------------------*/
+
+static void sr_stop(int sig)
+{
+    if(sr_stop_fd >= 0)
+    { shutdown(sr_stop_fd, SHUT_RDWR); }
+} /* -- sr_stop -- */
+
 /*-----------------------------------------------------------------------------
  * Method: sr_set_user(..)
  * Scope: local
@@ -199,11 +346,12 @@ void sr_set_user(struct sr_instance* sr)
     if(( pw = getpwuid(uid) ) == 0)
     {
         fprintf (stderr, "Error getting username, using something silly\n");
-        strncpy(sr->user, "something_silly", 32);
+        strcpy(sr->user, "something_silly");
     }
     else
     {
-        strncpy(sr->user, pw->pw_name, 32);
+        strncpy(sr->user, pw->pw_name, sizeof(sr->user) - 1);
+        sr->user[sizeof(sr->user) - 1] = '\0';
     }
 
 } /* -- sr_set_user -- */
@@ -220,16 +368,84 @@ static void sr_destroy_instance(struct sr_instance* sr)
     /* REQUIRES */
     assert(sr);
 
+    sr_export_close();
+
+    sr_slow_close(sr->slow);
+
     if(sr->logfile)
     {
-        sr_dump_close(sr->logfile);
+        sr_capture_close(sr->logfile);
     }
 
+    sr_print_stats(sr);
+
+    sr_trace_close();
+
     /*
     fprintf(stderr,"sr_destroy_instance leaking memory\n");
     */
 } /* -- sr_destroy_instance -- */
 
+/*-----------------------------------------------------------------------------
+ * Method: sr_print_stats(..)
+ * Scope: Local
+ *
+ * Non zero counters of every interface, then of packets on none, then
+ * the latency of each path.
+ *
+ *----------------------------------------------------------------------------*/
+
+static void sr_print_stats_row(const char* name, int ifindex)
+{
+    uint64_t c[SR_NSTATS];
+    int i;
+
+    sr_stats_read(ifindex, c);
+    for(i = 0; i < SR_NSTATS; i++)
+    {
+        if(c[i])
+        { printf("%-6s %-20s %llu\n", name, sr_stat_names[i], (unsigned long long)c[i]); }
+    }
+}
+
+/* microsecond percentiles of every path that saw traffic */
+static void sr_print_latency(void)
+{
+    struct sr_latency_snap* s;
+    int path;
+
+    if(!(s = malloc(sizeof(struct sr_latency_snap))))
+    { return; }
+
+    for(path = 0; path < SR_NLAT; path++)
+    {
+        sr_latency_read(path, s);
+        if(s->n == 0)
+        { continue; }
+        printf("latency %-15s n=%llu p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+               sr_lat_names[path], (unsigned long long)s->n,
+               sr_latency_quantile(s, 0.5) / 1e3,
+               sr_latency_quantile(s, 0.99) / 1e3,
+               sr_latency_quantile(s, 0.999) / 1e3, s->max / 1e3);
+    }
+    free(s);
+}
+
+static void sr_print_stats(struct sr_instance* sr)
+{
+    struct sr_if* if_walker;
+
+    /* REQUIRES */
+    assert(sr);
+
+    printf("Counters:\n");
+    for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+    { sr_print_stats_row(if_walker->name, if_walker->ifindex); }
+    sr_print_stats_row("-", -1);
+
+    sr_print_latency();
+} /* -- sr_print_stats -- */
+
 /*-----------------------------------------------------------------------------
  * Method: sr_init_instance(..)
  * Scope: Local
@@ -247,8 +463,12 @@ static void sr_init_instance(struct sr_instance* sr)
     sr->host[0] = 0;
     sr->topo_id = 0;
     sr->if_list = 0;
+    sr->nif = 0;
     sr->routing_table = 0;
+    sr->fib = 0;
+    sr->slow = 0;
     sr->logfile = 0;
+    sr->mtus = 0;
 } /* -- sr_init_instance -- */
 
 /*-----------------------------------------------------------------------------
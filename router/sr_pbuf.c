@@ -0,0 +1,184 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pbuf.c
+ *
+ * Description:
+ *
+ * Packet buffer pool, see sr_pbuf.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "sr_pbuf.h"
+
+#define SR_PBUF_HUGEPAGE_SZ (2*1024*1024)
+
+/* shared depot, only touched when a thread cache runs dry or overflows */
+static struct
+{
+    uint8_t* base;
+    size_t   size;
+    struct sr_pbuf* free_list;
+    pthread_mutex_t lock;
+} pool = { 0, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+/* per-thread cache, lock free since only its owner ever touches it */
+static __thread struct sr_pbuf* cache_head = 0;
+static __thread unsigned int    cache_count = 0;
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_pool_init(..)
+ * Scope:  Global
+ *
+ * Map the pool and thread every buffer onto the depot free list. Try
+ * for explicit hugepages first and fall back to ordinary pages (with a
+ * transparent hugepage hint) if none are reserved.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_pbuf_pool_init(unsigned int nbufs)
+{
+    size_t size;
+    uint8_t* base = MAP_FAILED;
+    unsigned int i;
+
+    assert(nbufs);
+    assert(!pool.base);
+
+    size = (size_t)nbufs * SR_PBUF_SIZE;
+    size = (size + SR_PBUF_HUGEPAGE_SZ - 1) & ~((size_t)SR_PBUF_HUGEPAGE_SZ - 1);
+
+#ifdef MAP_HUGETLB
+    base = mmap(0, size, PROT_READ|PROT_WRITE,
+                MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif /* MAP_HUGETLB */
+    if (base == MAP_FAILED)
+    {
+        base = mmap(0, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            perror("mmap(..):sr_pbuf.c::sr_pbuf_pool_init");
+            return -1;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(base, size, MADV_HUGEPAGE);
+#endif /* MADV_HUGEPAGE */
+    }
+
+    pool.base = base;
+    pool.size = (size_t)nbufs * SR_PBUF_SIZE;
+
+    /* thread in reverse so the list hands out ascending addresses */
+    for (i = nbufs; i > 0; i--)
+    {
+        struct sr_pbuf* pb = (struct sr_pbuf*)(base + (size_t)(i-1) * SR_PBUF_SIZE);
+        pb->next = pool.free_list;
+        pool.free_list = pb;
+    }
+
+    return 0;
+} /* -- sr_pbuf_pool_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_alloc(..)
+ * Scope:  Global
+ *
+ * Take a buffer from this thread's cache, refilling the cache from the
+ * depot with a batch when it is empty.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pbuf* sr_pbuf_alloc(void)
+{
+    struct sr_pbuf* pb;
+
+    if (!cache_head)
+    {
+        pthread_mutex_lock(&pool.lock);
+        while (pool.free_list && cache_count < SR_PBUF_BATCH)
+        {
+            pb = pool.free_list;
+            pool.free_list = pb->next;
+            pb->next = cache_head;
+            cache_head = pb;
+            cache_count++;
+        }
+        pthread_mutex_unlock(&pool.lock);
+
+        if (!cache_head)
+        { return 0; }
+    }
+
+    pb = cache_head;
+    cache_head = pb->next;
+    cache_count--;
+
+    pb->next = 0;
+    pb->refcnt = 1;
+    pb->ifindex = -1;
+    pb->headroom = SR_PBUF_HEADROOM;
+    pb->len = 0;
+    pb->path = 0;
+    pb->rx_ns = 0;
+
+    return pb;
+} /* -- sr_pbuf_alloc -- */
+
+void sr_pbuf_ref(struct sr_pbuf* pb)
+{
+    assert(pb);
+    __sync_add_and_fetch(&pb->refcnt, 1);
+} /* -- sr_pbuf_ref -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_free(..)
+ * Scope:  Global
+ *
+ * Drop a reference. The last reference puts the buffer on this thread's
+ * cache, and a full cache spills a batch back to the depot.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pbuf_free(struct sr_pbuf* pb)
+{
+    assert(pb);
+    assert(pb->refcnt > 0);
+
+    if (__sync_sub_and_fetch(&pb->refcnt, 1) != 0)
+    { return; }
+
+    pb->next = cache_head;
+    cache_head = pb;
+    cache_count++;
+
+    if (cache_count > SR_PBUF_CACHE_SZ)
+    {
+        pthread_mutex_lock(&pool.lock);
+        while (cache_count > SR_PBUF_CACHE_SZ - SR_PBUF_BATCH)
+        {
+            pb = cache_head;
+            cache_head = pb->next;
+            cache_count--;
+            pb->next = pool.free_list;
+            pool.free_list = pb;
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+} /* -- sr_pbuf_free -- */
+
+struct sr_pbuf* sr_pbuf_of(const void* p)
+{
+    const uint8_t* ptr = p;
+
+    if (ptr < pool.base || ptr >= pool.base + pool.size)
+    { return 0; }
+
+    return (struct sr_pbuf*)(pool.base +
+            ((size_t)(ptr - pool.base) / SR_PBUF_SIZE) * SR_PBUF_SIZE);
+} /* -- sr_pbuf_of -- */
@@ -0,0 +1,81 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pbuf.h
+ *
+ * Description:
+ *
+ * Fixed-size packet buffers carved out of a single preallocated region
+ * (hugepage backed when the kernel lets us have one).  Each buffer starts
+ * with a small header holding the frame length, the ingress interface, the
+ * headroom in front of the frame and a reference count, followed by the
+ * frame data itself.
+ *
+ * Buffers are handed out from a per-thread cache, so the common alloc/free
+ * touches no lock and no shared cache line.  The caches refill from, and
+ * spill back to, a shared depot in batches.
+ *
+ * Because the region is contiguous any pointer into a buffer can be mapped
+ * back to its header with sr_pbuf_of(), which is how code that only sees a
+ * raw uint8_t* frame finds out whether it may take a reference instead of
+ * copying.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_PBUF_H
+#define SR_PBUF_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_PBUF_SIZE      2048  /* bytes per buffer, header included      */
+#define SR_PBUF_NUM       4096  /* buffers in the pool                     */
+#define SR_PBUF_HEADROOM  64    /* default room left in front of a frame   */
+#define SR_PBUF_CACHE_SZ  128   /* most buffers a thread cache will hold   */
+#define SR_PBUF_BATCH     32    /* buffers moved per depot refill/spill    */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_pbuf
+ *
+ * Header of a pool buffer.  The frame lives at data + headroom and is len
+ * bytes long.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_pbuf
+{
+    struct sr_pbuf* next;   /* free list link, only valid while free */
+    int      refcnt;        /* references held, buffer is free at 0 */
+    int      ifindex;       /* ingress interface, -1 if generated locally */
+    uint16_t headroom;      /* offset of the frame within data[] */
+    uint16_t len;           /* length of the frame */
+    uint16_t path;          /* latency histogram it counts in, SR_LAT_* */
+    uint64_t rx_ns;         /* when the frame it carries or answers was
+                               read (sr_latency_now()), 0 if not timed */
+    uint8_t  data[0] __attribute__ ((aligned (64)));
+};
+
+#define SR_PBUF_ROOM (SR_PBUF_SIZE - sizeof(struct sr_pbuf))
+
+/* start of the frame held in a buffer */
+#define sr_pbuf_mtod(pb) ((pb)->data + (pb)->headroom)
+
+/* Maps the pool. Returns 0 on success. */
+int sr_pbuf_pool_init(unsigned int nbufs);
+
+/* Returns a buffer with one reference, SR_PBUF_HEADROOM bytes of headroom,
+   no data and no ingress interface, or NULL if the pool is exhausted. */
+struct sr_pbuf* sr_pbuf_alloc(void);
+
+/* Takes / drops a reference. The buffer goes back to the calling thread's
+   cache when the last reference is dropped. */
+void sr_pbuf_ref(struct sr_pbuf* pb);
+void sr_pbuf_free(struct sr_pbuf* pb);
+
+/* Returns the buffer containing p, or NULL if p is not pool memory. */
+struct sr_pbuf* sr_pbuf_of(const void* p);
+
+#endif /* -- SR_PBUF_H -- */
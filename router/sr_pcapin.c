@@ -0,0 +1,341 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pcapin.c
+ *
+ * Description:
+ *
+ * Dump file reader, see sr_pcapin.h
+ *
+ * Records are read one at a time into a buffer that grows to the largest
+ * record seen.  pcapng files may hold several sections; interfaces are
+ * numbered per section as the format says, and their timestamp
+ * resolution is honoured.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sr_pcapin.h"
+#include "sr_dumper.h"
+
+#define SR_PCAPIN_MAXIF  64                 /* interfaces per section */
+#define SR_PCAPIN_MAXREC (16 * 1024 * 1024) /* larger blocks are damage */
+
+#define TCPDUMP_MAGIC_NS 0xa1b23c4d
+#define PCAPNG_SPB 3                        /* simple packet block */
+
+struct sr_pcapin_if
+{
+    char name[PCAPNG_NAME_MAX + 1];
+    uint64_t res;               /* timestamp ticks per second */
+    int ethernet;
+};
+
+struct sr_pcapin
+{
+    FILE* fp;
+    char* fname;
+    int ng;                     /* pcapng rather than pcap */
+    int swap;                   /* written in the other byte order */
+    uint64_t res;               /* classic pcap ticks per second */
+    uint8_t* buf;
+    size_t cap;
+    int nif;
+    struct sr_pcapin_if ifs[SR_PCAPIN_MAXIF];
+};
+
+static uint32_t get32(const struct sr_pcapin* in, const uint8_t* p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return in->swap ? __builtin_bswap32(v) : v;
+}
+
+static uint16_t get16(const struct sr_pcapin* in, const uint8_t* p)
+{
+    uint16_t v;
+
+    memcpy(&v, p, 2);
+    return in->swap ? (uint16_t)((v << 8) | (v >> 8)) : v;
+}
+
+static uint64_t to_ns(uint64_t ticks, uint64_t res)
+{
+    return ticks / res * 1000000000ULL + ticks % res * 1000000000ULL / res;
+}
+
+/* read n more bytes into the buffer at off, growing it first */
+static int fill(struct sr_pcapin* in, size_t off, size_t n)
+{
+    if (off + n > SR_PCAPIN_MAXREC)
+    { return -1; }
+    if (off + n > in->cap)
+    {
+        uint8_t* p = realloc(in->buf, off + n);
+        if (!p)
+        { return -1; }
+        in->buf = p;
+        in->cap = off + n;
+    }
+    return fread(in->buf + off, 1, n, in->fp) == n ? 0 : -1;
+}
+
+static int damaged(struct sr_pcapin* in, const char* why)
+{
+    fprintf(stderr, "%s: %s\n", in->fname, why);
+    return -1;
+}
+
+/*---------------------------------------------------------------------
+ * pcapng
+ *---------------------------------------------------------------------*/
+
+/* interface description block body (after type and length) */
+static void ng_idb(struct sr_pcapin* in, const uint8_t* p, size_t n)
+{
+    struct sr_pcapin_if* ifp;
+    size_t off = 8;
+
+    if (in->nif == SR_PCAPIN_MAXIF || n < 8)
+    { return; }
+    ifp = &(in->ifs[in->nif++]);
+    memset(ifp, 0, sizeof(*ifp));
+    ifp->res = 1000000;
+    ifp->ethernet = get16(in, p) == LINKTYPE_ETHERNET;
+
+    while (off + 4 <= n)
+    {
+        uint16_t code = get16(in, p + off);
+        uint16_t olen = get16(in, p + off + 2);
+
+        off += 4;
+        if (code == 0 || off + olen > n)
+        { break; }
+        if (code == PCAPNG_OPT_IF_NAME)
+        { memcpy(ifp->name, p + off, min(olen, PCAPNG_NAME_MAX)); }
+        else if (code == PCAPNG_OPT_IF_TSRESOL && olen >= 1)
+        {
+            uint8_t v = p[off];
+            int i;
+
+            ifp->res = 1;
+            for (i = 0; i < (v & 0x7f); i++)
+            { ifp->res *= (v & 0x80) ? 2 : 10; }
+        }
+        off += (olen + 3) & ~3;
+    }
+}
+
+/* the epb_flags direction of an enhanced packet block's options */
+static int ng_dir(struct sr_pcapin* in, const uint8_t* p, size_t n)
+{
+    size_t off = 0;
+
+    while (off + 4 <= n)
+    {
+        uint16_t code = get16(in, p + off);
+        uint16_t olen = get16(in, p + off + 2);
+
+        off += 4;
+        if (code == 0 || off + olen > n)
+        { break; }
+        if (code == PCAPNG_OPT_EPB_FLAGS && olen == 4)
+        { return get32(in, p + off) & 3; }
+        off += (olen + 3) & ~3;
+    }
+    return 0;
+}
+
+static int ng_next(struct sr_pcapin* in, struct sr_pcapin_rec* rec)
+{
+    for (;;)
+    {
+        uint32_t type, len, body;
+        const uint8_t* p;
+
+        if (fill(in, 0, 8) != 0)
+        { return feof(in->fp) ? 0 : damaged(in, "read error"); }
+
+        memcpy(&type, in->buf, 4);
+        if (type == PCAPNG_SHB)
+        {
+            uint32_t bom;
+
+            if (fill(in, 8, 4) != 0)
+            { return damaged(in, "truncated section header"); }
+            memcpy(&bom, in->buf + 8, 4);
+            if (bom == PCAPNG_BYTE_ORDER_MAGIC)
+            { in->swap = 0; }
+            else if (bom == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC))
+            { in->swap = 1; }
+            else
+            { return damaged(in, "bad byte order magic"); }
+            in->nif = 0;
+            len = get32(in, in->buf + 4);
+            if (len < 28 || len % 4 || fill(in, 12, len - 12) != 0)
+            { return damaged(in, "truncated section header"); }
+            continue;
+        }
+
+        type = get32(in, in->buf);
+        len = get32(in, in->buf + 4);
+        if (len < 12 || len % 4 || fill(in, 8, len - 8) != 0)
+        { return damaged(in, "truncated block"); }
+        p = in->buf + 8;
+        body = len - 12;
+
+        if (type == PCAPNG_IDB)
+        { ng_idb(in, p, body); }
+        else if (type == PCAPNG_EPB && body >= 20)
+        {
+            uint32_t ifid = get32(in, p);
+            uint64_t ts = ((uint64_t)get32(in, p + 4) << 32) | get32(in, p + 8);
+            struct sr_pcapin_if* ifp;
+
+            rec->caplen = get32(in, p + 12);
+            rec->len = get32(in, p + 16);
+            if (ifid >= (uint32_t)in->nif || rec->caplen > body - 20)
+            { return damaged(in, "bad packet block"); }
+            ifp = &(in->ifs[ifid]);
+            if (!ifp->ethernet)
+            { continue; }
+            rec->data = p + 20;
+            rec->ts_ns = to_ns(ts, ifp->res);
+            rec->ifname = ifp->name[0] ? ifp->name : 0;
+            rec->dir = ng_dir(in, p + 20 + ((rec->caplen + 3) & ~3),
+                              body - 20 - ((rec->caplen + 3) & ~3));
+            return 1;
+        }
+        else if (type == PCAPNG_SPB && body >= 4 && in->nif > 0)
+        {
+            if (!in->ifs[0].ethernet)
+            { continue; }
+            rec->len = get32(in, p);
+            rec->caplen = min(rec->len, body - 4);
+            rec->data = p + 4;
+            rec->ts_ns = 0;
+            rec->ifname = in->ifs[0].name[0] ? in->ifs[0].name : 0;
+            rec->dir = 0;
+            return 1;
+        }
+        /* anything else is of no interest */
+    }
+}
+
+/*---------------------------------------------------------------------
+ * classic pcap
+ *---------------------------------------------------------------------*/
+
+static int sf_next(struct sr_pcapin* in, struct sr_pcapin_rec* rec)
+{
+    uint32_t sec, frac;
+
+    if (fill(in, 0, sizeof(struct pcap_sf_pkthdr)) != 0)
+    { return feof(in->fp) ? 0 : damaged(in, "read error"); }
+
+    sec = get32(in, in->buf);
+    frac = get32(in, in->buf + 4);
+    rec->caplen = get32(in, in->buf + 8);
+    rec->len = get32(in, in->buf + 12);
+    if (fill(in, sizeof(struct pcap_sf_pkthdr), rec->caplen) != 0)
+    { return damaged(in, "truncated packet"); }
+
+    rec->data = in->buf + sizeof(struct pcap_sf_pkthdr);
+    rec->ts_ns = (uint64_t)sec * 1000000000ULL +
+                 (in->res == 1000000 ? (uint64_t)frac * 1000 : frac);
+    rec->ifname = 0;
+    rec->dir = 0;
+    return 1;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcapin_open(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pcapin* sr_pcapin_open(const char* fname)
+{
+    struct sr_pcapin* in = calloc(1, sizeof(struct sr_pcapin));
+    uint32_t magic;
+
+    if (!in || !(in->fname = strdup(fname)))
+    {
+        free(in);
+        return 0;
+    }
+    if (!(in->fp = fopen(fname, "rb")))
+    {
+        perror(fname);
+        sr_pcapin_close(in);
+        return 0;
+    }
+
+    if (fill(in, 0, 4) != 0)
+    {
+        damaged(in, "empty file");
+        sr_pcapin_close(in);
+        return 0;
+    }
+    memcpy(&magic, in->buf, 4);
+
+    if (magic == PCAPNG_SHB)
+    {
+        /* the section header is read as the first block */
+        in->ng = 1;
+        rewind(in->fp);
+        return in;
+    }
+
+    if (magic == TCPDUMP_MAGIC || magic == TCPDUMP_MAGIC_NS)
+    { in->swap = 0; }
+    else if (magic == __builtin_bswap32(TCPDUMP_MAGIC) ||
+             magic == __builtin_bswap32(TCPDUMP_MAGIC_NS))
+    { in->swap = 1; }
+    else
+    {
+        damaged(in, "not a pcap or pcapng file");
+        sr_pcapin_close(in);
+        return 0;
+    }
+    in->res = get32(in, in->buf) == TCPDUMP_MAGIC ? 1000000 : 1000000000;
+
+    if (fill(in, 4, sizeof(struct pcap_file_header) - 4) != 0 ||
+        get32(in, in->buf + 20) != LINKTYPE_ETHERNET)
+    {
+        damaged(in, "not an ethernet capture");
+        sr_pcapin_close(in);
+        return 0;
+    }
+    return in;
+} /* -- sr_pcapin_open -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcapin_next(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_pcapin_next(struct sr_pcapin* in, struct sr_pcapin_rec* rec)
+{
+    return in->ng ? ng_next(in, rec) : sf_next(in, rec);
+} /* -- sr_pcapin_next -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pcapin_close(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pcapin_close(struct sr_pcapin* in)
+{
+    if (!in)
+    { return; }
+    if (in->fp)
+    { fclose(in->fp); }
+    free(in->buf);
+    free(in->fname);
+    free(in);
+} /* -- sr_pcapin_close -- */
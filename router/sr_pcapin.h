@@ -0,0 +1,44 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pcapin.h
+ *
+ * Description:
+ *
+ * Reads dump files back in: classic pcap (microsecond or nanosecond,
+ * either byte order) and pcapng, including what sr -l writes.  Only
+ * ethernet captures are accepted.  For pcapng the interface name and
+ * the direction flag of each packet are passed on when present.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_PCAPIN_H
+#define SR_PCAPIN_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+struct sr_pcapin;
+
+struct sr_pcapin_rec
+{
+    const uint8_t* data;        /* valid until the next call */
+    uint32_t caplen;
+    uint32_t len;               /* on the wire */
+    uint64_t ts_ns;
+    const char* ifname;         /* 0 if the file doesn't say */
+    int dir;                    /* SR_DUMP_IN, SR_DUMP_OUT or 0 */
+};
+
+/* Opens fname and reads its file header, or returns 0 saying why. */
+struct sr_pcapin* sr_pcapin_open(const char* fname);
+
+/* The next packet: 1, 0 at the end of the file, -1 if it is damaged. */
+int sr_pcapin_next(struct sr_pcapin* in, struct sr_pcapin_rec* rec);
+
+void sr_pcapin_close(struct sr_pcapin* in);
+
+#endif /* -- SR_PCAPIN_H -- */
@@ -0,0 +1,111 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pkt.c
+ *
+ * Description:
+ *
+ * Packet descriptor, see sr_pkt.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+#include "sr_pkt.h"
+#include "sr_if.h"
+#include "sr_utils.h"
+
+static uint32_t sr_pkt_hash(uint32_t src, uint32_t dst, uint32_t ports,
+                            uint8_t proto)
+{
+    uint32_t h = src * 0x9e3779b1U;
+
+    h = (h ^ dst) * 0x85ebca6bU;
+    h = (h ^ ports ^ proto) * 0xc2b2ae35U;
+    return h ^ (h >> 16);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_pkt_parse(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pkt_parse(struct sr_pkt* pkt, uint8_t* buf, unsigned int len,
+                  struct sr_if* iface)
+{
+    sr_ip_hdr_t* ihdr;
+    unsigned int hl, ip_len;
+    uint32_t ports = 0;
+
+    /* REQUIRES */
+    assert(pkt);
+    assert(buf);
+
+    memset(pkt, 0, sizeof(struct sr_pkt));
+    pkt->buf = buf;
+    pkt->len = len;
+    pkt->iface = iface;
+    pkt->ifindex = iface ? iface->ifindex : -1;
+
+    if (len < sizeof(sr_ethernet_hdr_t))
+    { return; }
+    pkt->ethertype = ntohs(((sr_ethernet_hdr_t*)buf)->ether_type);
+
+    if (pkt->ethertype != ethertype_ip ||
+        len < sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t))
+    { return; }
+    pkt->l3 = sizeof(sr_ethernet_hdr_t);
+    ihdr = (sr_ip_hdr_t*)(buf + pkt->l3);
+
+    hl = ihdr->ip_hl * 4;
+    if (hl < sizeof(sr_ip_hdr_t) || pkt->l3 + hl > len)
+    { return; }
+    pkt->l4 = pkt->l3 + hl;
+    pkt->proto = ihdr->ip_p;
+
+    ip_len = ntohs(ihdr->ip_len);
+    if (ip_len >= hl && pkt->l3 + ip_len <= len)
+    { pkt->ip_len = ip_len; }
+
+    /* fragments of a datagram hash alike, only the first has the ports */
+    if ((pkt->proto == ip_protocol_tcp || pkt->proto == ip_protocol_udp) &&
+        !(ihdr->ip_off & htons(IP_MF | IP_OFFMASK)) &&
+        pkt->l4 + sizeof(uint32_t) <= len)
+    { memcpy(&ports, buf + pkt->l4, sizeof(uint32_t)); }
+    pkt->hash = sr_pkt_hash(ihdr->ip_src, ihdr->ip_dst, ports, pkt->proto);
+} /* -- sr_pkt_parse -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pkt_check_ip(..)
+ * Scope:  Global
+ *
+ * The structural tests are or'ed into one branch; a good packet pays
+ * for that and one pass of the checksum over its header, which sums to
+ * all ones when it is right so nothing has to be zeroed first.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_pkt_check_ip(const struct sr_pkt* pkt)
+{
+    const sr_ip_hdr_t* ihdr;
+
+    /* REQUIRES */
+    assert(pkt);
+
+    if (!pkt->l3)
+    { return SR_PKT_IP_SHORT; }
+    ihdr = sr_pkt_ip(pkt);
+
+    /* ip_len is only kept if it covers the header and fits the frame,
+       and it can't unless the header is all there (l4) */
+    if ((ihdr->ip_v != 4) | (ihdr->ip_hl < 5) | (pkt->ip_len == 0))
+    {
+        return (ihdr->ip_hl >= 5 && !pkt->l4) ? SR_PKT_IP_SHORT
+                                              : SR_PKT_IP_BADHDR;
+    }
+
+    if (cksum(ihdr, pkt->l4 - pkt->l3) != 0xffff)
+    { return SR_PKT_IP_BADSUM; }
+    return SR_PKT_IP_OK;
+} /* -- sr_pkt_check_ip -- */
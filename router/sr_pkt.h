@@ -0,0 +1,76 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pkt.h
+ *
+ * Description:
+ *
+ * Packet descriptor: what sr_handlepacket() finds out about a frame the
+ * one time it parses it, handed to every handler after it so that none
+ * goes back to the raw headers to work the same things out again.
+ *
+ * Offsets are from the start of the frame, and each one that is set has
+ * been checked to lie within it: l3 only if a whole IPv4 header (sans
+ * options) is there, l4 only if the header with its options is, ip_len
+ * only if the datagram's own length fits the frame and covers its
+ * header.  Nothing else is judged by the parse; sr_pkt_check_ip() says
+ * whether an IPv4 packet is fit to be handled at all.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_PKT_H
+#define SR_PKT_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include "sr_protocol.h"
+
+struct sr_if;
+
+struct sr_pkt
+{
+    uint8_t* buf;               /* the frame, lent */
+    unsigned int len;           /* bytes in it */
+    struct sr_if* iface;        /* ingress, 0 if not known */
+    int ifindex;                /* ingress, -1 if not known */
+    uint16_t ethertype;         /* host byte order */
+    uint16_t l3;                /* IPv4 header, 0 if none */
+    uint16_t l4;                /* transport header, 0 if none */
+    uint16_t ip_len;            /* ntohs(ip_len), 0 if it can't be right */
+    uint8_t  proto;             /* ip_p, if l4 */
+    uint32_t hash;              /* addresses, protocol and ports, if l4
+                                   and not a fragment */
+};
+
+#define sr_pkt_eth(pkt)       ((sr_ethernet_hdr_t*)((pkt)->buf))
+#define sr_pkt_ip(pkt)        ((sr_ip_hdr_t*)((pkt)->buf + (pkt)->l3))
+#define sr_pkt_l4(pkt, type)  ((type*)((pkt)->buf + (pkt)->l4))
+
+/* Transport bytes the datagram says it has, 0 if ip_len is not to be
+   trusted. */
+#define sr_pkt_l4_len(pkt) \
+    ((pkt)->ip_len ? (pkt)->ip_len - ((pkt)->l4 - (pkt)->l3) : 0)
+
+/* What sr_pkt_check_ip() finds wrong with an IPv4 packet */
+enum sr_pkt_ip_err
+{
+    SR_PKT_IP_OK,
+    SR_PKT_IP_SHORT,            /* the frame ends inside the header */
+    SR_PKT_IP_BADHDR,           /* version, header or total length */
+    SR_PKT_IP_BADSUM            /* header checksum */
+};
+
+/* Fills pkt in for the len byte frame buf that arrived on iface (0 for
+   frames of our own). */
+void sr_pkt_parse(struct sr_pkt* pkt, uint8_t* buf, unsigned int len,
+                  struct sr_if* iface);
+
+/* Checks a parsed IPv4 packet's length, version, header length, total
+   length and header checksum, the last only if the rest are right. */
+int sr_pkt_check_ip(const struct sr_pkt* pkt);
+
+#endif /* -- SR_PKT_H -- */
@@ -133,6 +133,11 @@ struct sr_ip_hdr
   } __attribute__ ((packed)) ;
 typedef struct sr_ip_hdr sr_ip_hdr_t;
 
+/* option types that matter when fragmenting */
+#define IP_OPT_EOL    0                 /* end of option list */
+#define IP_OPT_NOP    1                 /* no operation */
+#define IP_OPT_COPIED 0x80              /* copy into every fragment */
+
 /* 
  *  Ethernet packet header prototype.  Too many O/S's define this differently.
  *  Easy enough to solve that and define it here.
@@ -152,6 +157,8 @@ typedef struct sr_ethernet_hdr sr_ethernet_hdr_t;
 
 enum sr_ip_protocol {
   ip_protocol_icmp = 0x0001,
+  ip_protocol_tcp = 0x0006,
+  ip_protocol_udp = 0x0011,
 };
 
 enum sr_ethertype {
@@ -0,0 +1,159 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_ratelimit.c
+ *
+ * Description:
+ *
+ * ICMP error rate limiting, see sr_ratelimit.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "sr_ratelimit.h"
+
+#define SR_ICMP_RL_TOKEN 1000000ULL   /* one whole token */
+
+static uint64_t sr_icmp_rl_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* top b up for the time since it was last touched */
+static void sr_icmp_rl_refill(struct sr_icmp_rl_bucket* b, uint64_t now,
+                              uint32_t rate, uint64_t depth)
+{
+    b->tokens += (now - b->stamp) * rate;
+    if (b->tokens > depth)
+    { b->tokens = depth; }
+    b->stamp = now;
+}
+
+/* the aggregate bucket's depth, in millionths of a token */
+static uint64_t sr_icmp_rl_total_depth(const struct sr_icmp_rl* rl)
+{
+    uint64_t depth = rl->total / 10;
+
+    if (depth < rl->burst)
+    { depth = rl->burst; }
+    return depth * SR_ICMP_RL_TOKEN;
+}
+
+static unsigned int sr_icmp_rl_hash(uint32_t prefix, uint8_t type)
+{
+    uint32_t h = (prefix ^ ((uint32_t)type << 24)) * 0x9e3779b1U;
+    return (h >> 16) & (SR_ICMP_RL_SZ - 1);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_icmp_rl_init(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_icmp_rl_init(struct sr_icmp_rl* rl, uint32_t rate, uint32_t burst,
+                     unsigned int prefixlen, uint32_t total)
+{
+    assert(rl);
+
+    memset(rl->buckets, 0, sizeof(rl->buckets));
+    if (prefixlen > 32)
+    { prefixlen = 32; }
+    rl->mask = prefixlen ? htonl(0xffffffffU << (32 - prefixlen)) : 0;
+    rl->rate = rate;
+    rl->burst = burst ? burst : 1;
+    rl->total = total;
+    memset(&(rl->all), 0, sizeof(rl->all));
+    rl->all.used = 1;
+    rl->all.tokens = sr_icmp_rl_total_depth(rl);
+    rl->all.stamp = sr_icmp_rl_now();
+    rl->dropped = 0;
+    pthread_mutex_init(&(rl->lock), 0);
+} /* -- sr_icmp_rl_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_icmp_rl_allow(..)
+ * Scope:  Global
+ *
+ * Find (or recycle) the bucket for this source prefix and type, top it
+ * up for the time elapsed since it was last touched and take a token.
+ * The aggregate bucket must have a token to spare as well; a source is
+ * only charged for errors that are actually sent.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_icmp_rl_allow(struct sr_icmp_rl* rl, uint32_t src, uint8_t type)
+{
+    struct sr_icmp_rl_bucket *b = 0, *victim = 0;
+    uint32_t prefix;
+    uint64_t now, depth;
+    unsigned int i, slot;
+    int ok;
+
+    assert(rl);
+
+    if (!rl->rate)
+    { return 1; }
+
+    prefix = src & rl->mask;
+    depth = (uint64_t)rl->burst * SR_ICMP_RL_TOKEN;
+
+    pthread_mutex_lock(&(rl->lock));
+    /* read under the lock so no bucket is ever stamped in the future */
+    now = sr_icmp_rl_now();
+
+    slot = sr_icmp_rl_hash(prefix, type);
+    for (i = 0; i < SR_ICMP_RL_PROBES; i++)
+    {
+        struct sr_icmp_rl_bucket *cur =
+            &(rl->buckets[(slot + i) & (SR_ICMP_RL_SZ - 1)]);
+
+        if (!cur->used)
+        {
+            victim = cur;
+            break;
+        }
+        if (cur->prefix == prefix && cur->type == type)
+        {
+            b = cur;
+            break;
+        }
+        if (!victim || cur->stamp < victim->stamp)
+        { victim = cur; }
+    }
+
+    if (!b)
+    {
+        /* new source, or the stalest bucket of a full run: start full */
+        b = victim;
+        b->prefix = prefix;
+        b->type = type;
+        b->used = 1;
+        b->tokens = depth;
+        b->stamp = now;
+    }
+    sr_icmp_rl_refill(b, now, rl->rate, depth);
+
+    ok = b->tokens >= SR_ICMP_RL_TOKEN;
+    if (ok && rl->total)
+    {
+        sr_icmp_rl_refill(&(rl->all), now, rl->total,
+                          sr_icmp_rl_total_depth(rl));
+        ok = rl->all.tokens >= SR_ICMP_RL_TOKEN;
+        if (ok)
+        { rl->all.tokens -= SR_ICMP_RL_TOKEN; }
+    }
+    if (ok)
+    { b->tokens -= SR_ICMP_RL_TOKEN; }
+    else
+    { rl->dropped++; }
+
+    pthread_mutex_unlock(&(rl->lock));
+
+    return ok;
+} /* -- sr_icmp_rl_allow -- */
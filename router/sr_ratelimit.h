@@ -0,0 +1,70 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_ratelimit.h
+ *
+ * Description:
+ *
+ * Token buckets limiting the ICMP errors we generate (RFC 1812 4.3.2.8).
+ * There is one bucket per (source prefix, ICMP type), where the source is
+ * the host that will receive the error.  Buckets live in a small open
+ * addressed hash table. When a probe run is full the stalest bucket in it
+ * is recycled, so a spray of sources can't grow the table or evict hot
+ * buckets wholesale.
+ *
+ * New buckets start full so a host's first error is never held back,
+ * which lets a spray of (spoofed) sources each spend a burst.  One more
+ * bucket, taken from after the per source one, bounds the total.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_RATELIMIT_H
+#define SR_RATELIMIT_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#define SR_ICMP_RL_SZ        1024  /* buckets, power of two */
+#define SR_ICMP_RL_PROBES    8     /* slots searched before recycling one */
+#define SR_ICMP_RL_RATE      100   /* default errors/s per bucket */
+#define SR_ICMP_RL_BURST     20    /* default bucket depth */
+#define SR_ICMP_RL_PREFIXLEN 24    /* default source aggregation */
+#define SR_ICMP_RL_TOTAL     1000  /* default errors/s over all sources */
+
+struct sr_icmp_rl_bucket
+{
+    uint32_t prefix;            /* source prefix, network byte order */
+    uint8_t  type;              /* ICMP type */
+    uint8_t  used;
+    uint64_t tokens;            /* in millionths of a token */
+    uint64_t stamp;             /* last refill, microseconds */
+};
+
+struct sr_icmp_rl
+{
+    struct sr_icmp_rl_bucket buckets[SR_ICMP_RL_SZ];
+    struct sr_icmp_rl_bucket all;   /* every error, whatever its source */
+    uint32_t mask;              /* source prefix mask, network byte order */
+    uint32_t rate;              /* tokens per second, 0 disables limiting */
+    uint32_t burst;             /* bucket depth in tokens */
+    uint32_t total;             /* tokens per second for all, 0 unbounded */
+    unsigned long dropped;      /* errors suppressed so far */
+    pthread_mutex_t lock;
+};
+
+/* Sets up an empty table. rate == 0 turns limiting off, total == 0 leaves
+   only the per source limit.  The aggregate bucket holds a tenth of a
+   second of total, or burst if that is more. */
+void sr_icmp_rl_init(struct sr_icmp_rl* rl, uint32_t rate, uint32_t burst,
+                     unsigned int prefixlen, uint32_t total);
+
+/* Returns 1 and takes a token if an ICMP error of this type may be sent to
+   src (network byte order), 0 if it should be suppressed. */
+int sr_icmp_rl_allow(struct sr_icmp_rl* rl, uint32_t src, uint8_t type);
+
+#endif /* -- SR_RATELIMIT_H -- */
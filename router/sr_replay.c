@@ -0,0 +1,529 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_replay.c
+ *
+ * Description:
+ *
+ * Offline forwarding harness.  Loads a routing table and a set of
+ * synthetic interfaces, then feeds frames straight into sr_handlepacket()
+ * as fast as it will take them, with sr_send_packet() replaced by a stub
+ * that keeps what the router sends.  No VNS server, POX or Mininet.
+ *
+ * Input is a capture (pcap or pcapng) or generated traffic (-G).  In a
+ * pcapng written by sr -l every inbound packet is replayed on the
+ * interface it was captured on and every outbound packet becomes the
+ * expected output, so a capture of a good run is its own regression
+ * test.  Without direction flags every packet is input, on the -I
+ * interface unless the file names one we have.
+ *
+ * Reports throughput over all passes, the per path latency from
+ * sr_latency.h, and compares the first pass's output frame by frame
+ * with the expected output (or a -g golden file), exiting 1 on any
+ * difference.  -w saves the output as pcapng to serve as a later golden.
+ *
+ * The ARP sweep thread is not started and ICMP errors are not rate
+ * limited unless -R asks, so a replay is deterministic.
+ *
+ *   sr_replay [-r rtable] [-i iface file] [-I ingress iface] [-n passes]
+ *             [-G count] [-s size] [-g golden] [-w out.pcapng]
+ *             [-R rate:burst:len:total] [-M name=mtu,...] [capture]
+ *
+ * The interface file has one "name ip mac" line per interface; without
+ * one the usual three interface lab topology is assumed.  -M lowers
+ * interface MTUs as sr's own -M does, and with -s for generated frames
+ * larger than that it exercises fragmentation.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_if.h"
+#include "sr_arpcache.h"
+#include "sr_protocol.h"
+#include "sr_utils.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+#include "sr_dumper.h"
+#include "sr_latency.h"
+#include "sr_pcapin.h"
+
+#define GEN_LEN   98            /* generated frames, a default ping's size */
+#define GEN_MAX   1514          /* and the largest, a full ethernet frame */
+#define SHOW_DIFF 5             /* differences printed in full */
+
+struct frame
+{
+    uint8_t* data;
+    unsigned int len;
+    char iface[sr_IFACE_NAMELEN];
+};
+
+struct frames
+{
+    struct frame* f;
+    unsigned int n;
+    unsigned int cap;
+};
+
+static struct frames input, expect, output;
+static int recording = 0;       /* keep what sr_send_packet() gets */
+
+static const char* default_ifs[][3] =
+{
+    { "eth1", "192.168.2.1", "02:00:00:00:01:01" },
+    { "eth2", "172.64.3.1",  "02:00:00:00:02:01" },
+    { "eth3", "10.0.1.1",    "02:00:00:00:03:01" },
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void frames_add(struct frames* fs, const uint8_t* data,
+                       unsigned int len, const char* iface)
+{
+    struct frame* f;
+
+    if (fs->n == fs->cap)
+    {
+        fs->cap = fs->cap ? fs->cap * 2 : 1024;
+        if (!(fs->f = realloc(fs->f, fs->cap * sizeof(struct frame))))
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    f = &(fs->f[fs->n++]);
+    if (!(f->data = malloc(len)))
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(f->data, data, len);
+    f->len = len;
+    strncpy(f->iface, iface ? iface : "", sr_IFACE_NAMELEN - 1);
+    f->iface[sr_IFACE_NAMELEN - 1] = 0;
+}
+
+/* what sr_vns_comm.c would provide: the frame is kept, not sent */
+int sr_send_packet(struct sr_instance* sr, uint8_t* buf, unsigned int len,
+                   struct sr_if* iface)
+{
+    struct sr_pbuf* pb = sr_pbuf_of(buf);
+
+    if (pb && pb->rx_ns)
+    {
+        sr_latency_record(pb->path, sr_latency_now() - pb->rx_ns);
+        pb->rx_ns = 0;
+    }
+    if (recording)
+    { frames_add(&output, buf, len, iface->name); }
+    return 0;
+}
+
+/* fragments arrive in pieces, they are kept whole */
+int sr_send_packetv(struct sr_instance* sr, const struct iovec* v, int vcnt,
+                    struct sr_if* iface)
+{
+    uint8_t buf[SR_PBUF_SIZE];
+    unsigned int len = 0;
+    int i;
+
+    for (i = 0; i < vcnt; i++)
+    {
+        assert(len + v[i].iov_len <= sizeof(buf));
+        memcpy(buf + len, v[i].iov_base, v[i].iov_len);
+        len += v[i].iov_len;
+    }
+    if (recording)
+    { frames_add(&output, buf, len, iface->name); }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * setup
+ *---------------------------------------------------------------------*/
+
+static int parse_mac(const char* s, unsigned char* mac)
+{
+    unsigned int b[ETHER_ADDR_LEN];
+    int i;
+
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3],
+               &b[4], &b[5]) != ETHER_ADDR_LEN)
+    { return -1; }
+    for (i = 0; i < ETHER_ADDR_LEN; i++)
+    { mac[i] = b[i]; }
+    return 0;
+}
+
+static int add_if(struct sr_instance* sr, const char* name, const char* ip,
+                  const char* mac)
+{
+    unsigned char addr[ETHER_ADDR_LEN];
+    struct in_addr in;
+
+    if (!inet_aton(ip, &in) || parse_mac(mac, addr) != 0)
+    {
+        fprintf(stderr, "bad interface %s %s %s\n", name, ip, mac);
+        return -1;
+    }
+    if (sr_add_interface(sr, name) != 0)
+    { return -1; }
+    sr_set_ether_addr(sr, addr);
+    sr_set_ether_ip(sr, in.s_addr);
+    return 0;
+}
+
+static int load_ifs(struct sr_instance* sr, const char* fname)
+{
+    char line[256], name[64], ip[64], mac[64];
+    FILE* fp;
+    unsigned int i;
+
+    if (!fname)
+    {
+        for (i = 0; i < sizeof(default_ifs) / sizeof(default_ifs[0]); i++)
+        { add_if(sr, default_ifs[i][0], default_ifs[i][1], default_ifs[i][2]); }
+        return 0;
+    }
+
+    if (!(fp = fopen(fname, "r")))
+    {
+        perror(fname);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#' || sscanf(line, "%63s %63s %63s", name, ip, mac) != 3)
+        { continue; }
+        if (add_if(sr, name, ip, mac) != 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return sr->if_list ? 0 : -1;
+}
+
+/* inbound (or undirected) packets into in, outbound ones into out,
+   either may be 0 to skip them */
+static int load_capture(const char* fname, const char* ingress,
+                        struct frames* in_to, struct frames* out_to)
+{
+    struct sr_pcapin* in;
+    struct sr_pcapin_rec rec;
+    unsigned int cut = 0;
+    int ret;
+
+    if (!(in = sr_pcapin_open(fname)))
+    { return -1; }
+    while ((ret = sr_pcapin_next(in, &rec)) == 1)
+    {
+        if (rec.caplen < rec.len)
+        {
+            cut++;
+            continue;
+        }
+        if (in_to && rec.dir != SR_DUMP_OUT)
+        { frames_add(in_to, rec.data, rec.len, rec.ifname ? rec.ifname : ingress); }
+        else if (out_to && rec.dir != SR_DUMP_IN)
+        { frames_add(out_to, rec.data, rec.len, rec.ifname); }
+    }
+    sr_pcapin_close(in);
+    if (cut)
+    { fprintf(stderr, "%s: skipped %u packets cut short by the snaplen\n", fname, cut); }
+    return ret;
+}
+
+/* xorshift, so generated traffic is the same every run */
+static uint32_t rnd_state = 2463534242U;
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/* n udp frames from a host behind ingress to hosts behind every other
+   route, with the next hops already in the ARP cache */
+static int generate(struct sr_instance* sr, const char* ingress, unsigned int n,
+                    unsigned int len)
+{
+    struct sr_if* in_if = sr_get_interface(sr, ingress);
+    struct sr_rt* rt;
+    struct sr_rt* routes[1024];
+    unsigned char mac[ETHER_ADDR_LEN] = { 2, 0, 0, 0xaa, 0, 0 };
+    uint8_t frame[GEN_MAX];
+    sr_ethernet_hdr_t* ehdr = (sr_ethernet_hdr_t*)frame;
+    sr_ip_hdr_t* ihdr = (sr_ip_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+    unsigned int nroutes = 0, i;
+
+    if (!in_if)
+    {
+        fprintf(stderr, "no interface %s\n", ingress);
+        return -1;
+    }
+    if (len < sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + 8 || len > GEN_MAX)
+    {
+        fprintf(stderr, "generated frames must be %u to %u bytes\n",
+                (unsigned int)(sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + 8),
+                GEN_MAX);
+        return -1;
+    }
+    for (rt = sr->routing_table; rt && nroutes < 1024; rt = rt->next)
+    {
+        if (strcmp(rt->interface, ingress) == 0)
+        { continue; }
+        routes[nroutes++] = rt;
+        mac[4] = nroutes >> 8;
+        mac[5] = nroutes;
+        sr_arpcache_insert(&(sr->cache), mac, rt->gw.s_addr);
+    }
+    if (nroutes == 0)
+    {
+        fprintf(stderr, "no routes out of anything but %s\n", ingress);
+        return -1;
+    }
+
+    memset(frame, 0, sizeof(frame));
+    memcpy(ehdr->ether_dhost, in_if->addr, ETHER_ADDR_LEN);
+    memset(ehdr->ether_shost, 0xaa, ETHER_ADDR_LEN);
+    ehdr->ether_type = htons(ethertype_ip);
+    ihdr->ip_v = 4;
+    ihdr->ip_hl = 5;
+    ihdr->ip_len = htons(len - sizeof(sr_ethernet_hdr_t));
+    ihdr->ip_ttl = 64;
+    ihdr->ip_p = 17;            /* udp */
+
+    for (i = 0; i < n; i++)
+    {
+        rt = routes[rnd() % nroutes];
+        ihdr->ip_src = (in_if->ip & htonl(0xffffff00)) | htonl(2 + rnd() % 250);
+        ihdr->ip_dst = (rnd() & ~rt->mask.s_addr) | (rt->dest.s_addr & rt->mask.s_addr);
+        ihdr->ip_id = htons(i);
+        ihdr->ip_sum = 0;
+        ihdr->ip_sum = cksum(ihdr, sizeof(sr_ip_hdr_t));
+        frames_add(&input, frame, len, ingress);
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * replay and report
+ *---------------------------------------------------------------------*/
+
+static void replay(struct sr_instance* sr)
+{
+    struct sr_pbuf* pb;
+    unsigned int i;
+
+    for (i = 0; i < input.n; i++)
+    {
+        struct frame* f = &(input.f[i]);
+        struct sr_if* iface = sr_get_interface(sr, f->iface);
+
+        if (!iface || !(pb = sr_pbuf_alloc()))
+        { continue; }
+        if (f->len > SR_PBUF_ROOM - pb->headroom)
+        {
+            sr_pbuf_free(pb);
+            continue;
+        }
+        memcpy(sr_pbuf_mtod(pb), f->data, f->len);
+        pb->len = f->len;
+        pb->ifindex = iface->ifindex;
+        pb->path = SR_LAT_FORWARD;
+        pb->rx_ns = sr_latency_now();
+        sr_handlepacket(sr, sr_pbuf_mtod(pb), f->len, f->iface);
+        sr_pbuf_free(pb);
+    }
+}
+
+static void print_frame(const char* what, const struct frame* f)
+{
+    unsigned int i;
+
+    printf("  %s %s len %u:", what, f->iface[0] ? f->iface : "?", f->len);
+    for (i = 0; i < f->len && i < 48; i++)
+    { printf("%s%02x", i % 4 ? "" : " ", f->data[i]); }
+    printf("%s\n", f->len > 48 ? " ..." : "");
+}
+
+/* frame by frame, in order; returns the number of differences */
+static unsigned int compare(void)
+{
+    unsigned int i, diffs = 0, n = output.n > expect.n ? output.n : expect.n;
+
+    for (i = 0; i < n; i++)
+    {
+        const struct frame* got = i < output.n ? &(output.f[i]) : 0;
+        const struct frame* want = i < expect.n ? &(expect.f[i]) : 0;
+
+        if (got && want && got->len == want->len &&
+            memcmp(got->data, want->data, got->len) == 0 &&
+            (!want->iface[0] || strcmp(got->iface, want->iface) == 0))
+        { continue; }
+
+        if (diffs++ < SHOW_DIFF)
+        {
+            printf("output %u differs\n", i);
+            if (want)
+            { print_frame("want", want); }
+            if (got)
+            { print_frame("got ", got); }
+        }
+    }
+    return diffs;
+}
+
+static void save(const char* fname, struct sr_instance* sr)
+{
+    uint8_t idb[PCAPNG_IDB_MAX], hdr[PCAPNG_EPB_HDR], trailer[PCAPNG_EPB_TRAILER_MAX];
+    struct sr_if* if_walker;
+    unsigned int i;
+    size_t n;
+    FILE* fp;
+
+    if (!(fp = sr_dump_ng_open(fname)))
+    { return; }
+    for (if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+    { fwrite(idb, sr_dump_ng_idb(idb, if_walker->name, 65535), 1, fp); }
+
+    for (i = 0; i < output.n; i++)
+    {
+        struct frame* f = &(output.f[i]);
+        struct sr_if* iface = sr_get_interface(sr, f->iface);
+
+        n = sr_dump_ng_epb(hdr, trailer, iface ? iface->ifindex : 0,
+                           (uint64_t)i * 1000, f->len, f->len, SR_DUMP_OUT);
+        fwrite(hdr, PCAPNG_EPB_HDR, 1, fp);
+        fwrite(f->data, f->len, 1, fp);
+        fwrite(trailer, n, 1, fp);
+    }
+    fclose(fp);
+}
+
+static void print_latency(void)
+{
+    struct sr_latency_snap* s = malloc(sizeof(struct sr_latency_snap));
+    int path;
+
+    for (path = 0; s && path < SR_NLAT; path++)
+    {
+        sr_latency_read(path, s);
+        if (s->n == 0)
+        { continue; }
+        printf("latency %-15s n=%llu p50=%.0fns p99=%.0fns p99.9=%.0fns max=%.0fns\n",
+               sr_lat_names[path], (unsigned long long)s->n,
+               (double)sr_latency_quantile(s, 0.5),
+               (double)sr_latency_quantile(s, 0.99),
+               (double)sr_latency_quantile(s, 0.999), (double)s->max);
+    }
+    free(s);
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [-r rtable] [-i iface file] [-I ingress iface] [-n passes]\n"
+                    "          [-G count] [-s size] [-g golden] [-w out.pcapng]\n"
+                    "          [-R rate:burst:len:total] [-M name=mtu,...] [capture]\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    struct sr_instance* sr = calloc(1, sizeof(struct sr_instance));
+    const char* rtable = "rtable";
+    const char* iffile = 0;
+    const char* ingress = 0;
+    const char* golden = 0;
+    const char* outfile = 0;
+    const char* mtus = 0;
+    unsigned int passes = 1, gen = 0, gen_len = GEN_LEN, pass, diffs = 0;
+    unsigned int rate = 0, burst = SR_ICMP_RL_BURST, plen = SR_ICMP_RL_PREFIXLEN;
+    unsigned int total = SR_ICMP_RL_TOTAL;
+    unsigned int entries, requests, queued;
+    double start, elapsed;
+    int c;
+
+    while ((c = getopt(argc, argv, "r:i:I:n:G:s:g:w:R:M:h")) != EOF)
+    {
+        switch (c)
+        {
+            case 'r': rtable = optarg; break;
+            case 'i': iffile = optarg; break;
+            case 'I': ingress = optarg; break;
+            case 'n': passes = atoi(optarg); break;
+            case 'G': gen = atoi(optarg); break;
+            case 's': gen_len = atoi(optarg); break;
+            case 'g': golden = optarg; break;
+            case 'w': outfile = optarg; break;
+            case 'R': sscanf(optarg, "%u:%u:%u:%u", &rate, &burst, &plen, &total); break;
+            case 'M': mtus = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((optind == argc) == (gen == 0) || passes == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sr_cksum_init();
+    if (sr_pbuf_pool_init(SR_PBUF_NUM) != 0 || load_ifs(sr, iffile) != 0 ||
+        sr_load_rt(sr, rtable) != 0 || (mtus && sr_set_mtus(sr, mtus) != 0))
+    { return 1; }
+    sr_arpcache_init(&(sr->cache));
+    if (sr_init_interfaces(sr) != 0)
+    { return 1; }
+    sr_icmp_rl_init(&(sr->icmp_rl), rate, burst, plen, total);
+    if (!ingress)
+    { ingress = sr->if_list->name; }
+
+    if (gen ? generate(sr, ingress, gen, gen_len) != 0
+            : load_capture(argv[optind], ingress, &input,
+                           golden ? 0 : &expect) != 0)
+    { return 1; }
+    if (golden && load_capture(golden, 0, 0, &expect) != 0)
+    { return 1; }
+
+    start = now();
+    for (pass = 0; pass < passes; pass++)
+    {
+        recording = pass == 0;
+        replay(sr);
+    }
+    elapsed = now() - start;
+
+    printf("replayed %u frames x %u in %.3fs: %.0f frames/s, %.1f ns/frame\n",
+           input.n, passes, elapsed, input.n * (double)passes / elapsed,
+           elapsed * 1e9 / ((double)input.n * passes));
+    print_latency();
+
+    sr_arpcache_occupancy(&(sr->cache), &entries, &requests, &queued);
+    printf("output %u frames, %u left waiting on %u ARP requests\n",
+           output.n, queued, requests);
+
+    if (outfile)
+    { save(outfile, sr); }
+    if (golden || expect.n)
+    {
+        diffs = compare();
+        printf("%u expected frames, %u differences\n", expect.n, diffs);
+    }
+    return diffs ? 1 : 0;
+}
@@ -18,10 +18,18 @@
 
 #include "sr_if.h"
 #include "sr_rt.h"
+#include "sr_fib.h"
+#include "sr_pkt.h"
+#include "sr_slow.h"
 #include "sr_router.h"
 #include "sr_protocol.h"
 #include "sr_arpcache.h"
 #include "sr_utils.h"
+#include "sr_pbuf.h"
+#include "sr_trace.h"
+#include "sr_stats.h"
+#include "sr_latency.h"
+#include "sr_log.h"
 
 
 /*---------------------------------------------------------------------
@@ -50,8 +58,56 @@ void sr_init(struct sr_instance* sr)
     
     /* Add initialization code here! */
 
+    /* exceptions are handled inline if there is no thread for them */
+    if (!(sr->slow = sr_slow_open(sr)))
+    { sr_log(SR_LOG_WARN, "** Warning: no slow path thread, handling inline\n"); }
+
 } /* -- sr_init -- */
 
+/*---------------------------------------------------------------------
+ * Method: sr_init_interfaces(void)
+ * Scope:  Global
+ *
+ * Called once the hardware info has arrived and every interface has its
+ * addresses. Prebuilds the per-interface ICMP error frames, points the
+ * routes at their interfaces' ifindexes and compiles the forwarding
+ * table.  Without a table nothing could be forwarded or answered, so
+ * failing to build one is fatal to the caller: -1.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_init_interfaces(struct sr_instance* sr)
+{
+    struct sr_if *if_walker = 0;
+
+    /* REQUIRES */
+    assert(sr);
+
+    for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+    {
+        struct sr_icmp_tmpl *tmpl = &(if_walker->icmp_tmpl);
+        sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)tmpl->frame;
+        sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(tmpl->frame + sizeof(sr_ethernet_hdr_t));
+
+        memset(tmpl, 0, sizeof(*tmpl));
+
+        memcpy(ehdr->ether_shost, if_walker->addr, ETHER_ADDR_LEN);
+        ehdr->ether_type = htons(ethertype_ip);
+
+        ihdr->ip_v = 4;
+        ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
+        ihdr->ip_len = htons(sizeof(sr_ip_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
+        ihdr->ip_off = htons(IP_DF);
+        ihdr->ip_ttl = 64;
+        ihdr->ip_p = ip_protocol_icmp;
+        /* src/dst stay zero, they are added to this sum per error */
+        tmpl->ip_sum = cksum_add(0, ihdr, sizeof(sr_ip_hdr_t));
+    }
+
+    sr_rt_bind_interfaces(sr);
+    return sr_fib_build(sr);
+} /* -- sr_init_interfaces -- */
+
 /*---------------------------------------------------------------------
  * Method: sr_handlepacket(uint8_t* p,char* interface)
  * Scope:  Global
@@ -78,139 +134,380 @@ void sr_handlepacket(struct sr_instance* sr,
   assert(packet);
   assert(interface);
 
-  printf("\n*** -> Received packet of length %d \n",len);
+  /* frames read by sr_vns_comm.c arrive with the interface resolved */
+  struct sr_pbuf *pb = sr_pbuf_of(packet);
+  struct sr_if *interface_detail = pb ? sr_get_interface_byIndex(sr, pb->ifindex)
+                                      : sr_get_interface(sr, interface);
+  struct sr_pkt pkt;
+
+  /* sr_replay and sr_bench hand frames in by name, unchecked */
+  if (!interface_detail) {
+    sr_stat_inc(-1, SR_STAT_DROP_NOIF);
+    return;
+  }
+
+  /* headers are parsed here once, the handlers read the descriptor */
+  sr_pkt_parse(&pkt, packet, len, interface_detail);
 
   if (len <  sizeof(sr_ethernet_hdr_t)) {
-    fprintf(stderr, "***** -> Failed to process ETHERNET header, insufficient length\n");
+    sr_trace(SR_TR_RX_SHORT, pkt.ifindex, len, 0, 0, 0);
+    sr_stat_inc(pkt.ifindex, SR_STAT_DROP_SHORT);
     return;
   }
     
-  sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet; 
-    
-  uint16_t ether_type = ntohs(eth_hdr->ether_type);
-  struct sr_if *interface_detail = sr_get_interface(sr, interface);
+  sr_trace(SR_TR_RX, pkt.ifindex, len, pkt.ethertype, 0, 0);
     
-  if (ether_type == ethertype_arp) 
+  if (pkt.ethertype == ethertype_arp) 
   {
-      printf("***** -> Going to sr_handle_ARP_packet \n");
-      sr_handle_arp_packet(sr, packet, len, interface);
+      sr_handle_arp_packet(sr, packet, len, interface_detail);
 
-  } else if (ether_type == ethertype_ip) {
+  } else if (pkt.ethertype == ethertype_ip) {
 
-      printf("***** -> Going to sr_handle_IP_packet \n");
-      sr_handle_ip_packet(sr, packet, len, interface_detail);
+      sr_handle_ip_packet(sr, &pkt);
   }
 
 }/* end sr_ForwardPacket */
 
 
+/* counts (and traces) a packet sr_pkt_check_ip() turned down */
+static void sr_ip_drop_invalid(struct sr_pkt *pkt, int err)
+{
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+
+  if(err == SR_PKT_IP_SHORT){
+    sr_trace(SR_TR_IP_BADLEN, pkt->ifindex, pkt->len,
+             pkt->l3 ? ihdr->ip_hl : 0, 0, 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_SHORT);
+
+  } else if(err == SR_PKT_IP_BADHDR){
+    sr_trace(SR_TR_IP_BADHDR, pkt->ifindex, ihdr->ip_v, ihdr->ip_hl,
+             ntohs(ihdr->ip_len), 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_BADHDR);
+
+  } else {
+    /* what the sum should have been is only worked out for the trace */
+    if(sr_trace_on){
+      uint16_t sum = ihdr->ip_sum;
+      ihdr->ip_sum = 0;
+      uint16_t ck_sum = cksum(ihdr,pkt->l4 - pkt->l3);
+      ihdr->ip_sum = sum;
+      sr_trace(SR_TR_IP_BADSUM, pkt->ifindex, ntohs(sum), ntohs(ck_sum), 0, 0);
+    }
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_CKSUM);
+  }
+}
+
+/* hands a packet the fast path won't take to the slow path thread, or
+   deals with it here when there is no thread (sr_replay, sr_bench) or
+   the frame is not in a pool buffer */
+static void sr_ip_punt(struct sr_instance *sr, struct sr_pkt *pkt, int why)
+{
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+
+  sr_trace(SR_TR_IP_SLOW, pkt->ifindex, ihdr->ip_src, ihdr->ip_dst, why, 0);
+  sr_stat_inc(pkt->ifindex, SR_STAT_SLOW_PATH);
+
+  if(!sr->slow || !sr_pbuf_of(pkt->buf)){
+    sr_handle_ip_exception(sr, pkt, why);
+
+  } else if(sr_slow_enqueue(sr->slow, pkt, why) != 0){
+    sr_trace(SR_TR_SLOW_FULL, pkt->ifindex, why, 0, 0, 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_SLOW);
+  }
+}
+
+
 void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-                         unsigned int len,
-                         struct sr_if *interface){
+                         struct sr_pkt *pkt){
 
   assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_handle_ip_packet() ====\n");
+  assert(pkt);
+  assert(pkt->iface);
+
+  struct sr_if *interface = pkt->iface;
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+  const struct sr_fib_entry *fe;
+  struct sr_if *out = 0;
+  int err;
+
+  /* nothing is looked up for a packet that fails here */
+  if((err = sr_pkt_check_ip(pkt)) != SR_PKT_IP_OK){
+    sr_ip_drop_invalid(pkt, err);
+    return;
+  }
+
+  /* one lookup says whether it is ours, not to be forwarded, or where
+     it goes, by which of equal cost paths for its flow */
+  fe = sr_fib_lookup_flow(sr->fib, ihdr->ip_dst, pkt->hash);
 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_if *dest_interface = sr_get_interface_byIP(sr,ihdr->ip_dst);
+  /* fast path: plain transit, no options, no fragment bits, TTL to spare
+     and no bigger than the way out takes */
+  if(fe && fe->type == SR_FIB_FORWARD &&
+     (out = sr_get_interface_byIndex(sr, fe->ifindex)) &&
+     ((pkt->l4 - pkt->l3 - sizeof(sr_ip_hdr_t)) |
+      (ihdr->ip_off & htons(IP_MF | IP_OFFMASK)) |
+      (ihdr->ip_ttl <= 1) |
+      (pkt->ip_len > out->mtu)) == 0){
+    sr_trace(SR_TR_IP_FORWARD, interface->ifindex,
+             ihdr->ip_src, ihdr->ip_dst, ihdr->ip_ttl, 0);
+    sr_ip_forward(sr,pkt,fe);
 
-  unsigned int check_len1 = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t);
-  unsigned int check_len2 = sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl*4);
-  uint16_t sum = ihdr->ip_sum;
-  ihdr->ip_sum = 0;
-  uint16_t ck_sum = cksum(ihdr,ihdr->ip_hl*4);
-  ihdr->ip_sum = sum;
+  } else if(fe && fe->type == SR_FIB_DROP){
+    sr_trace(SR_TR_IP_BCAST, interface->ifindex, ihdr->ip_src, ihdr->ip_dst, 0, 0);
+    sr_stat_inc(interface->ifindex, SR_STAT_DROP_BCAST);
 
-  if(len < check_len1 || len < check_len2){
-    printf("*** -> ERROR!!!! -> not enough length or check sum not mach\n");
+  } else if(fe && fe->type == SR_FIB_LOCAL){
+    sr_ip_punt(sr, pkt, SR_SLOW_LOCAL);
+
+  } else {
+    sr_ip_punt(sr, pkt,
+               pkt->l4 - pkt->l3 > sizeof(sr_ip_hdr_t) ? SR_SLOW_OPTIONS :
+               (ihdr->ip_off & htons(IP_MF | IP_OFFMASK)) ? SR_SLOW_FRAGMENT :
+               !out ? SR_SLOW_NOROUTE :
+               ihdr->ip_ttl <= 1 ? SR_SLOW_TTL : SR_SLOW_MTU);
   }
-  if (sum != ck_sum){
-   printf("ERROR!!!!!!!!!!!!!!!!!!!!!1, check sum not match");}
-  /* find address , directly forward*/
-  if(!dest_interface){
-    printf("***** -> Find dest_interface address, Going to sr_ip_forward \n");
-    sr_ip_forward(sr,packet,len);
-  
-  /*if address is not found*/
+}/* end sr_handle_ip packets*/
+
+
+/*---------------------------------------------------------------------
+ * Method: sr_handle_ip_exception(..)
+ * Scope:  Global
+ *
+ * Everything the fast path in sr_handle_ip_packet() leaves, on the slow
+ * path thread.  The packet is looked up again as the table may have
+ * changed since.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_handle_ip_exception(struct sr_instance *sr,
+                            struct sr_pkt *pkt,
+                            int why){
+
+  assert(sr);
+  assert(pkt);
+
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+  const struct sr_fib_entry *fe = sr_fib_lookup_flow(sr->fib, ihdr->ip_dst,
+                                                     pkt->hash);
+
+  /* forwarded the long way round: options, fragments, TTL, no route,
+     MTU */
+  if(why != SR_SLOW_LOCAL){
+    sr_trace(SR_TR_IP_FORWARD, pkt->ifindex,
+             ihdr->ip_src, ihdr->ip_dst, ihdr->ip_ttl, 0);
+    sr_ip_forward(sr,pkt,(fe && fe->type == SR_FIB_FORWARD) ? fe : 0);
+
+  /* addressed to us */
   } else {
-    printf("***** -> IP address not found, checking for ICMP \n");
+    sr_trace(SR_TR_IP_LOCAL, pkt->ifindex,
+             ihdr->ip_src, ihdr->ip_dst, ihdr->ip_p, 0);
     
-    if(ihdr->ip_p == ip_protocol_icmp)
+    if(pkt->proto == ip_protocol_icmp)
     {
-      printf("****** -> It's a ICMP message \n");
-      sr_icmp_handler(sr,packet,len);
+      sr_icmp_handler(sr,pkt);
 
-    } else if (ihdr->ip_p == 0x0006 || ihdr->ip_p == 0x0001){
+    } else if (pkt->proto == ip_protocol_tcp){
       /* icmp type   unreachable = 3
          icmp code = unreachable = 3  */
-      printf("****** -> IP address not found and not a ICMP msg, Preparing icmp 3 3 \n");
-      sr_send_icmp(sr,packet, len, 3, 3);
+      sr_send_icmp(sr,pkt, 3, 3, 0);
+    }
+  }
+}/* end sr_handle_ip_exception */
+
+
+
+/* the options of a first fragment that every later one repeats, those
+   with the copied flag (RFC 791), padded out to a whole header word */
+static unsigned int sr_ip_copied_options(const uint8_t *opt,
+                                         unsigned int len,
+                                         uint8_t *to)
+{
+  unsigned int i = 0, n = 0, olen;
+
+  while(i < len && opt[i] != IP_OPT_EOL){
+    if(opt[i] == IP_OPT_NOP){
+      i++;
+      continue;
+    }
+    if(i + 1 >= len || (olen = opt[i + 1]) < 2 || i + olen > len)
+      break;
+    if(opt[i] & IP_OPT_COPIED){
+      memcpy(to + n, opt + i, olen);
+      n += olen;
+    }
+    i += olen;
+  }
+  while(n & 3)
+    to[n++] = IP_OPT_EOL;
+  return n;
+}
+
+/* splits a datagram too big for out into fragments sent straight from
+   its own payload, each behind a header of its own.  The next hop is
+   resolved once for all of them; if it has to be asked for, each
+   fragment is copied into a buffer of its own to wait on the ARP queue */
+static void sr_ip_fragment(struct sr_instance *sr,
+                           struct sr_pkt *pkt,
+                           struct sr_if *out,
+                           const struct sr_fib_entry *fe)
+{
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+  uint32_t nexthop = sr_fib_nexthop(fe, ihdr->ip_dst);
+  unsigned int hl = pkt->l4 - pkt->l3;
+  unsigned int total = pkt->ip_len - hl;
+  const uint8_t *payload = pkt->buf + pkt->l4;
+  uint16_t off = ntohs(ihdr->ip_off);
+  uint8_t hdr[sizeof(sr_ethernet_hdr_t) + 60];
+  sr_ethernet_hdr_t *fehdr = (sr_ethernet_hdr_t *)hdr;
+  sr_ip_hdr_t *fihdr = (sr_ip_hdr_t *)(hdr + sizeof(sr_ethernet_hdr_t));
+  unsigned int done, size, fhl = hl, nfrags = 0;
+  struct sr_arpentry *arp = 0;
+  struct sr_pbuf *in_pb = sr_pbuf_of(pkt->buf);
+  struct iovec iov[2];
+  int resolved;
+
+  memcpy(hdr, pkt->buf, sizeof(sr_ethernet_hdr_t) + hl);
+  resolved = fe->adj && sr_adj_rewrite(fe->adj, hdr);
+  if(!resolved && (arp = sr_arpcache_lookup(&(sr->cache), nexthop))){
+    memcpy(fehdr->ether_dhost, arp->mac, ETHER_ADDR_LEN);
+    memcpy(fehdr->ether_shost, out->addr, ETHER_ADDR_LEN);
+    free(arp);
+    resolved = 1;
+  }
+
+  for(done = 0; done < total; done += size){
+    size = total - done;
+    if(fhl + size > out->mtu)
+      size = (out->mtu - fhl) & ~7;
+
+    fihdr->ip_len = htons(fhl + size);
+    fihdr->ip_off = htons(((off & IP_MF) || done + size < total ? IP_MF : 0) |
+                          ((off & IP_OFFMASK) + (done >> 3)));
+    fihdr->ip_sum = 0;
+    fihdr->ip_sum = cksum(fihdr, fhl);
+
+    if(resolved){
+      iov[0].iov_base = hdr;
+      iov[0].iov_len  = sizeof(sr_ethernet_hdr_t) + fhl;
+      iov[1].iov_base = (void *)(payload + done);
+      iov[1].iov_len  = size;
+      sr_send_packetv(sr, iov, 2, out);
+    } else {
+      struct sr_pbuf *pb = sr_pbuf_alloc();
+      if(!pb){
+        sr_trace(SR_TR_NOBUF, out->ifindex, 0, 0, 0, 0);
+        sr_stat_inc(out->ifindex, SR_STAT_DROP_QUEUE);
+        break;
+      }
+      uint8_t *data = sr_pbuf_mtod(pb);
+      pb->len = sizeof(sr_ethernet_hdr_t) + fhl + size;
+      pb->ifindex = pkt->ifindex;   /* so an ARP give-up can answer */
+      memcpy(data, hdr, sizeof(sr_ethernet_hdr_t) + fhl);
+      memcpy(data + sizeof(sr_ethernet_hdr_t) + fhl, payload + done, size);
+      sr_sending(sr, data, pb->len, out, nexthop, 0);
+      sr_pbuf_free(pb);
+    }
+    nfrags++;
+
+    /* later fragments carry only the options marked to be copied */
+    if(done == 0 && hl > sizeof(sr_ip_hdr_t)){
+      fhl = sizeof(sr_ip_hdr_t) +
+            sr_ip_copied_options(pkt->buf + pkt->l3 + sizeof(sr_ip_hdr_t),
+                                 hl - sizeof(sr_ip_hdr_t),
+                                 (uint8_t *)fihdr + sizeof(sr_ip_hdr_t));
+      fihdr->ip_hl = fhl >> 2;
     }
   }
-}/* end sr_handle_ip packets*/
 
+  sr_trace(SR_TR_IP_FRAG, out->ifindex, ihdr->ip_dst, pkt->ip_len, out->mtu, nfrags);
+  sr_stat_inc(out->ifindex, SR_STAT_FRAG_OK);
+  sr_stat_add(out->ifindex, SR_STAT_FRAG_CREATED, nfrags);
+
+  /* sent in pieces, so the latency is taken here rather than on send */
+  if(resolved && in_pb && in_pb->rx_ns){
+    sr_latency_record(in_pb->path, sr_latency_now() - in_pb->rx_ns);
+    in_pb->rx_ns = 0;
+  }
+}
 
 
 void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len){
+                   struct sr_pkt *pkt,
+                   const struct sr_fib_entry *fe){
 
   assert(sr);
-  assert(packet);
-  printf("\n==== sr_ip_forward ====\n");
+  assert(pkt);
 
-  sr_ip_hdr_t *ihdr =(sr_ip_hdr_t *) (sizeof(sr_ethernet_hdr_t) + packet);
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
+  /* ttl shares a 16 bit word with the protocol, patch the sum for it */
+  uint16_t old_word, new_word;
+  int expired = ihdr->ip_ttl <= 1;
+  memcpy(&old_word, &ihdr->ip_ttl, sizeof(uint16_t));
   ihdr->ip_ttl--;
-  ihdr->ip_sum = 0;
-  ihdr->ip_sum = cksum(ihdr,ihdr->ip_hl*4);
-  struct sr_rt *lpm = sr_lpm(sr, ihdr->ip_dst);
+  memcpy(&new_word, &ihdr->ip_ttl, sizeof(uint16_t));
+  ihdr->ip_sum = cksum_update16(ihdr->ip_sum, old_word, new_word);
+  struct sr_if *out_interface = fe ? sr_get_interface_byIndex(sr, fe->ifindex) : 0;
+  int in_ifindex = pkt->ifindex;
 
-  if(ihdr->ip_ttl == 0){
+  if(expired){
     /* 
     icmp type : time excceded = 11
     icmp code : time exceeded_ttl = 0
     */
-    printf("**** -> IP packet TTL == 0 \n");
-    sr_send_icmp(sr,packet,len, 11, 0);
+    sr_trace(SR_TR_TTL_EXPIRED, in_ifindex, ihdr->ip_src, ihdr->ip_dst, 0, 0);
+    sr_stat_inc(in_ifindex, SR_STAT_DROP_TTL);
+    sr_send_icmp(sr,pkt, 11, 0, 0);
     return;
   }
   
-  if (!lpm)
+  if (!out_interface)
   {
     /*
     icmp type : unreachable = 3
     icmp code : unreachable-net = 0
     */
-    printf("**** -> IP packet not LMP, preparing ICMP 3 0 Destination Net unreachable\n");
-    sr_send_icmp(sr, packet, len, 3, 0);
+    sr_trace(SR_TR_NO_ROUTE, in_ifindex, ihdr->ip_dst, 0, 0, 0);
+    sr_stat_inc(in_ifindex, SR_STAT_DROP_NOROUTE);
+    sr_send_icmp(sr, pkt, 3, 0, 0);
+    return;
+  }
+
+  if (pkt->ip_len > out_interface->mtu)
+  {
+    if (ihdr->ip_off & htons(IP_DF)){
+      /*
+      icmp type : unreachable = 3
+      icmp code : fragmentation needed and DF set = 4
+      */
+      sr_trace(SR_TR_NEEDS_FRAG, in_ifindex, ihdr->ip_dst, pkt->ip_len,
+               out_interface->mtu, 0);
+      sr_stat_inc(in_ifindex, SR_STAT_DROP_DF);
+      sr_send_icmp(sr, pkt, 3, 4, out_interface->mtu);
+    } else {
+      sr_ip_fragment(sr, pkt, out_interface, fe);
+    }
     return;
   }
 
-  printf("**** -> Sending ip Packet L:185\n");
-  struct sr_if *out_interface =  sr_get_interface(sr, lpm->interface);
-  sr_sending(sr, packet, len, out_interface, lpm->gw.s_addr);
+  sr_sending(sr, pkt->buf, pkt->len, out_interface, sr_fib_nexthop(fe, ihdr->ip_dst),
+             fe->adj);
 
 } /* end sr_ip_forward */
 
 
 void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
+                  struct sr_pkt *pkt,
                   uint8_t type,
-                  uint8_t code)
+                  uint8_t code,
+                  uint16_t next_mtu)
 {
   assert(sr);
-  assert(packet);
-  printf("\n==== sr_send_icmp() ====\n");
+  assert(pkt);
+  assert(pkt->l4);
 
-  sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet; 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_rt *lpm = sr_lpm(sr,ihdr->ip_src);
-  struct sr_if *out_interface = sr_get_interface(sr,lpm->interface);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t)+ sizeof(ihdr->ip_hl *4) + packet);
+  uint8_t *packet = pkt->buf;
+  sr_ethernet_hdr_t *ehdr = sr_pkt_eth(pkt);
+  sr_ip_hdr_t *ihdr = sr_pkt_ip(pkt);
   /*
     handle ICMP according to following type and code. 
     Type 
@@ -222,145 +519,154 @@ void sr_send_icmp(struct sr_instance *sr,
     unreachable_host = 1
     unreachable_net = 0
     unreachable_port = 3
+    frag_needed = 4, with the next hop's MTU
     time_exceed = 0
     echo reply = 0 */
 
-  /* type = unreachable*/
-  if(type == 3){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-    /* icmp code = unrachable_port = 3*/
-    if(code == 3){
-      new_ihdr->ip_src = ihdr->ip_dst;
-    }else{
-      new_ihdr->ip_src = out_interface->ip;
+  /* errors are rate limited per (source prefix, type) before any work
+     is done on them, so a flood can't turn us into an amplifier */
+  if (type != 0 && !sr_icmp_rl_allow(&(sr->icmp_rl), ihdr->ip_src, type)){
+    sr_trace(SR_TR_ICMP_LIMITED, pkt->ifindex, ihdr->ip_src, type, code, 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_ICMP_LIMITED);
+    return;
+  }
+
+  /* echo reply, turned around in place */
+  if (type == 0){
+    const struct sr_fib_entry *fe = sr_fib_lookup_flow(sr->fib, ihdr->ip_src,
+                                                       pkt->hash);
+    struct sr_if *out_interface = (fe && fe->type == SR_FIB_FORWARD) ?
+                                  sr_get_interface_byIndex(sr, fe->ifindex) : 0;
+    sr_icmp_hdr_t *ichdr = sr_pkt_l4(pkt, sr_icmp_hdr_t);
+
+    if(!out_interface){
+      sr_trace(SR_TR_NO_ROUTE, pkt->ifindex, ihdr->ip_src, 0, 0, 0);
+      sr_stat_inc(pkt->ifindex, SR_STAT_DROP_NOROUTE);
+      return;
     }
 
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /*type = time exceed*/
-  }else if (type == 11){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_src = out_interface->ip;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /* echo reply*/
-  }else if (type == 0){
-
-    /*update ip hearder*/
+    sr_trace(SR_TR_ICMP_ECHO, out_interface->ifindex, ihdr->ip_src, 0, 0, 0);
+    sr_stat_inc(out_interface->ifindex, SR_STAT_ICMP_OUT);
+
+    /*update ip hearder, swapping the addresses leaves the sum alone*/
     uint32_t ip_dst = ihdr->ip_src;
     ihdr->ip_src = ihdr->ip_dst;
     ihdr->ip_dst = ip_dst;
 
-    /*update icmp header*/
-
+    /*update icmp header, only the type/code word changes*/
+    uint16_t old_word, new_word;
+    memcpy(&old_word, &ichdr->icmp_type, sizeof(uint16_t));
     ichdr->icmp_type = 0;
     ichdr->icmp_code = 0;
-    ichdr->icmp_sum = 0;
-    ichdr->icmp_sum = cksum(ichdr,ntohs(ihdr->ip_len)-(ihdr->ip_hl*4));
+    memcpy(&new_word, &ichdr->icmp_type, sizeof(uint16_t));
+    ichdr->icmp_sum = cksum_update16(ichdr->icmp_sum, old_word, new_word);
     /*update ethernet header*/
     memset(ehdr->ether_shost,0,ETHER_ADDR_LEN);
     memset(ehdr->ether_dhost,0,ETHER_ADDR_LEN);  
 
-    sr_sending(sr,packet,len,out_interface,lpm->gw.s_addr);
+    struct sr_pbuf *echo_pb = sr_pbuf_of(packet);
+    if(echo_pb)
+      echo_pb->path = SR_LAT_ICMP;
+
+    sr_sending(sr,packet,pkt->len,out_interface,sr_fib_nexthop(fe, ihdr->ip_dst),fe->adj);
+    return;
+  }
+
+  /* unreachable (3) and time exceeded (11) share one layout, stamp it
+     onto the template of the interface the offending packet came in on
+     and hand it straight back to the neighbour that sent it. Only
+     packets we did not receive ourselves need a route lookup. */
+  struct sr_pbuf *in_pb = sr_pbuf_of(packet);
+  struct sr_if *out_interface = pkt->iface;
+  const struct sr_fib_entry *fe = 0;
+
+  if(!out_interface){
+    fe = sr_fib_lookup_flow(sr->fib, ihdr->ip_src, pkt->hash);
+    if(fe && fe->type == SR_FIB_FORWARD)
+      out_interface = sr_get_interface_byIndex(sr, fe->ifindex);
+    if(!out_interface){
+      sr_trace(SR_TR_NO_ROUTE, pkt->ifindex, ihdr->ip_src, 0, 0, 0);
+      sr_stat_inc(pkt->ifindex, SR_STAT_DROP_NOROUTE);
+      return;
+    }
   }
-}
 
+  struct sr_pbuf *pb = sr_pbuf_alloc();
+  if(!pb){
+    sr_trace(SR_TR_NOBUF, out_interface->ifindex, 0, 0, 0, 0);
+    sr_stat_inc(out_interface->ifindex, SR_STAT_DROP_QUEUE);
+    return;
+  }
+  uint8_t *data = sr_pbuf_mtod(pb);
+  memcpy(data, out_interface->icmp_tmpl.frame, SR_ICMP_ERR_LEN);
+  pb->len = SR_ICMP_ERR_LEN;
+  pb->path = SR_LAT_ICMP;
+  pb->rx_ns = in_pb ? in_pb->rx_ns : 0;
+
+  sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
+  sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
+  sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
+
+  /* ip header: addresses, then fold them into the template's partial sum.
+     icmp code = unrachable_port = 3 answers from the address that was hit */
+  new_ihdr->ip_src = (type == 3 && code == 3) ? ihdr->ip_dst : out_interface->ip;
+  new_ihdr->ip_dst = ihdr->ip_src;
+  new_ihdr->ip_sum = cksum_fold(cksum_add(out_interface->icmp_tmpl.ip_sum,
+                                          &new_ihdr->ip_src, 2*sizeof(uint32_t)));
+
+  /* icmp header, quoting as much of the offending datagram as we have */
+  unsigned int quote = pkt->len - pkt->l3;
+  if(quote > ICMP_DATA_SIZE)
+    quote = ICMP_DATA_SIZE;
+  new_ichdr->icmp_type = type;
+  new_ichdr->icmp_code = code;
+  new_ichdr->next_mtu = htons(next_mtu);
+  memcpy(new_ichdr->data,ihdr,quote);
+  new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
+  sr_trace(SR_TR_ICMP_ERR, out_interface->ifindex, new_ihdr->ip_dst, type, code, 0);
+  sr_stat_inc(out_interface->ifindex, SR_STAT_ICMP_OUT);
+
+  if(!fe){
+    memcpy(new_ehdr->ether_dhost,ehdr->ether_shost,ETHER_ADDR_LEN);
+    sr_send_packet(sr,data,SR_ICMP_ERR_LEN,out_interface);
+  }else{
+    sr_sending(sr,data,SR_ICMP_ERR_LEN,out_interface,sr_fib_nexthop(fe, ihdr->ip_src),fe->adj);
+  }
+  sr_pbuf_free(pb);
+}/* end sr_send_icmp */
 
 
 void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len)
+                     struct sr_pkt *pkt)
 {
   assert(sr);
-  assert(packet);
-  printf("\n==== sr_icmp_handler() =====\n");
+  assert(pkt);
+
+  /* the message is checksummed over what ip_len says it holds, which
+     must be in the frame (sr_pkt_parse() zeroes ip_len otherwise) */
+  unsigned int icmp_len = sr_pkt_l4_len(pkt);
+  if(icmp_len < sizeof(sr_icmp_hdr_t)){
+    sr_trace(SR_TR_ICMP_BAD, pkt->ifindex, pkt->len, 0, 0, 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_CKSUM);
+    return;
+  }
 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t)+packet);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl * 4) + packet);
-  unsigned int check_len = sizeof(sr_icmp_hdr_t) + (ihdr->ip_hl*4) + sizeof(sr_ethernet_hdr_t);
+  sr_icmp_hdr_t *ichdr = sr_pkt_l4(pkt, sr_icmp_hdr_t);
   uint16_t sum = ichdr->icmp_sum;
   ichdr->icmp_sum = 0;
-  uint16_t check_sum = cksum(ichdr,ntohs(ihdr->ip_len) - (ihdr->ip_hl*4));
+  uint16_t check_sum = cksum(ichdr,icmp_len);
   ichdr->icmp_sum = sum;
 
-  if( len < check_len || sum != check_sum){
-    fprintf(stderr,"**** -> Faill to produce ICMP header , not enough length or check sum not mach \n");
+  if(sum != check_sum){
+    sr_trace(SR_TR_ICMP_BAD, pkt->ifindex, pkt->len, ntohs(sum), ntohs(check_sum), 0);
+    sr_stat_inc(pkt->ifindex, SR_STAT_DROP_CKSUM);
+    return;
   }
 
   /* when type is echo request = 8 , and code is echo request = 0*/
   if (ichdr->icmp_type == 8 && ichdr->icmp_code == 0){
-    printf("**** -> type is echo request = 8 , and code is echo request = 0\n");
     /* send echo replay type = 0 , echo reply code = 0*/
-    sr_send_icmp(sr,packet,len,0,0);
+    sr_send_icmp(sr,pkt,0,0,0);
   }
 }/* end sr_icmp_handler */
 
@@ -369,27 +675,42 @@ void sr_sending(struct sr_instance *sr,
                 uint8_t *packet,
                 unsigned int len,
                 struct sr_if *interface,
-                uint32_t ip){
+                uint32_t ip,
+                const struct sr_adj *adj){
   assert(sr);
   assert(packet);
   assert(interface);
-  printf("\n==== sr_sending() ==== \n");
+
+  /* a resolved adjacency has the whole header ready */
+  if(adj && sr_adj_rewrite(adj, packet)){
+    sr_trace(SR_TR_ARP_HIT, interface->ifindex, ip, len, 0, 0);
+    sr_stat_inc(interface->ifindex, SR_STAT_ARP_HIT);
+    sr_send_packet(sr,packet,len,interface);
+    return;
+  }
 
   struct sr_arpentry *arp = sr_arpcache_lookup(&(sr->cache),ip);
 
   if(arp){
-    printf("**** -> IP->MAC mapping is in the cache. L:369\n");
+    sr_trace(SR_TR_ARP_HIT, interface->ifindex, ip, len, 0, 0);
+    sr_stat_inc(interface->ifindex, SR_STAT_ARP_HIT);
     sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet;
 
     memcpy(ehdr->ether_dhost,arp->mac,ETHER_ADDR_LEN);
     memcpy(ehdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
+    free(arp);
 
-    sr_send_packet(sr,packet,len,interface->name);
+    sr_send_packet(sr,packet,len,interface);
 
   }else{
-    printf("**** -> IP->MAC mapping NOT in the cache. L:378\n");
-    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->name);
+    sr_trace(SR_TR_ARP_MISS, interface->ifindex, ip, len, 0, 0);
+    sr_stat_inc(interface->ifindex, SR_STAT_ARP_MISS);
+    /* the request must not be answered and freed under us by another
+       thread before we have looked at it */
+    pthread_mutex_lock(&(sr->cache.lock));
+    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->ifindex);
     sr_handle_arpreq(sr,request);
+    pthread_mutex_unlock(&(sr->cache.lock));
 
   }
 }/* end sr_sending */
@@ -398,40 +719,45 @@ void sr_sending(struct sr_instance *sr,
 void sr_handle_arp_packet(struct sr_instance *sr, 
                           uint8_t *packet,
                           unsigned int len,
-                          char *receiving_interface)
+                          struct sr_if *receive_interface)
 {
     /* REQUIRES */
     assert(sr);
     assert(packet);
-    assert(receiving_interface);
-    printf("\n==== handle_arp_packet() ====\n");
 
-    /*Check packet length*/
-    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
+    /*Check interface whether in router's IP address*/
+    if (!receive_interface)
     {
-      fprintf(stderr, "**** -> ERROR: Incorrect packet length\n");
       return;
     }
 
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
-    struct sr_if *receive_interface = sr_get_interface(sr, receiving_interface);
-    struct sr_if *sender_interface  = sr_get_interface_byIP(sr, arp_hdr->ar_tip); 
-
-    /*Check interface whether in router's IP address*/
-    if (!receive_interface)
+    /*Check packet length*/
+    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
     {
-      fprintf(stderr, "**** -> ERROR: Invalid interface\n");
+      sr_trace(SR_TR_ARP_BADLEN, receive_interface->ifindex, len, 0, 0, 0);
+      sr_stat_inc(receive_interface->ifindex, SR_STAT_DROP_SHORT);
       return;
     }
 
+    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
+    const struct sr_fib_entry *fe   = sr_fib_lookup(sr->fib, arp_hdr->ar_tip);
+    struct sr_if *sender_interface  = (fe && fe->type == SR_FIB_LOCAL) ?
+                                      sr_get_interface_byIndex(sr, fe->ifindex) : 0;
+
     /* Get arp_opcode: request or replay to me*/
     if (ntohs(arp_hdr->ar_op) == arp_op_request){           /* Request to me, send a reply*/
-        printf("***** -> this is a arp request, preparing a reply L:419\n");
+        sr_trace(SR_TR_ARP_REQ_IN, receive_interface->ifindex,
+                 arp_hdr->ar_sip, arp_hdr->ar_tip, 0, 0);
+        /* asking after an address that isn't one of ours */
+        if (!sender_interface){
+          sr_stat_inc(receive_interface->ifindex, SR_STAT_DROP_NOTUS);
+          return;
+        }
         sr_handle_arp_send_reply_to_requester(sr, packet, receive_interface, sender_interface);
   
     } else if (ntohs(arp_hdr->ar_op) == arp_op_reply){    /* Reply to me, cache it */
      
-        printf("***** -> This is a REPLY to me, CACHE it L:422 \n");
+        sr_trace(SR_TR_ARP_REP_IN, receive_interface->ifindex, arp_hdr->ar_sip, 0, 0, 0);
         sr_handle_arp_cache_reply(sr, packet, receive_interface);
     } 
 }/* end sr_handle_arp_packet */
@@ -441,14 +767,11 @@ void sr_handle_arp_cache_reply(struct sr_instance *sr,
                                uint8_t *packet,
                                struct sr_if *interface_info)
 {
-    printf("\n==== sr_handle_arp_cache_reply() ==== \n");
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
     sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
 
     /* Cache it */
     struct sr_arpreq *requests = sr_arpcache_insert(&(sr->cache), arp_hdr->ar_sha, arp_hdr->ar_sip); 
 
-    printf("*** -> Go through my request queue for this IP and send outstanding packets if there are any \n");
     /* Go through my request queue for this IP and send outstanding packets if there are any*/
     if(requests)
     {
@@ -459,14 +782,14 @@ void sr_handle_arp_cache_reply(struct sr_instance *sr,
       pkts = requests->packets;
       while(pkts)
       {
-	printf("**** -> Iterating request queue\n");
         pkt_eth_hdr = (sr_ethernet_hdr_t *)(pkts->buf);
-        dest_if = sr_get_interface(sr, pkts->iface);
+        dest_if = sr_get_interface_byIndex(sr, pkts->ifindex);
+        sr_trace(SR_TR_ARP_FLUSH, dest_if->ifindex, arp_hdr->ar_sip, pkts->len, 0, 0);
 
         /* source and desti mac addresss switched*/
         memcpy(pkt_eth_hdr->ether_shost, dest_if->addr, ETHER_ADDR_LEN);
         memcpy(pkt_eth_hdr->ether_dhost, arp_hdr->ar_sha, ETHER_ADDR_LEN);
-        sr_send_packet(sr, pkts->buf, pkts->len, pkts->iface);
+        sr_send_packet(sr, pkts->buf, pkts->len, dest_if);
         pkts = pkts->next;
       }
 
@@ -481,14 +804,21 @@ void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
                                            struct sr_if *receive_interface,
                                            struct sr_if *sender_interface)
 { 
-    printf("\n==== sr_handle_arp_send_reply_to_requester() =====\n");
-    printf("**** -> Preparing packet....\n");  
     sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
     sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
 
     /* Consttruct a ARP reply*/
     unsigned int packet_len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t); 
-    uint8_t *reply = (uint8_t *) malloc(packet_len); 
+    struct sr_pbuf *pb = sr_pbuf_alloc();
+    if(!pb){
+      sr_trace(SR_TR_NOBUF, receive_interface->ifindex, 0, 0, 0, 0);
+      sr_stat_inc(receive_interface->ifindex, SR_STAT_DROP_QUEUE);
+      return;
+    }
+    uint8_t *reply = sr_pbuf_mtod(pb);
+    pb->len = packet_len;
+    pb->path = SR_LAT_ARP_REPLY;
+    pb->rx_ns = sr_pbuf_of(packet) ? sr_pbuf_of(packet)->rx_ns : 0;
     sr_ethernet_hdr_t *new_ether_hdr = (sr_ethernet_hdr_t *) reply;
     sr_arp_hdr_t *new_arp_hdr = (sr_arp_hdr_t *)(reply + sizeof(sr_ethernet_hdr_t));
 
@@ -509,9 +839,9 @@ void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
     memcpy(new_arp_hdr->ar_tha, arp_hdr->ar_sha, ETHER_ADDR_LEN);  /* target hardware address      */
 
     /* ARP replies are sent directly to the requester?s MAC address*/
-    printf("***** -> Finsihed packeting, going sr_sr_send_packet()\n");
-    sr_send_packet(sr, reply, packet_len, sender_interface->name);
-    free(reply);
+    sr_trace(SR_TR_ARP_REP_OUT, receive_interface->ifindex, new_arp_hdr->ar_tip, 0, 0, 0);
+    sr_send_packet(sr, reply, packet_len, sender_interface);
+    sr_pbuf_free(pb);
 } /* end sr_handle_arp_manage_reply */
 
 
@@ -522,2301 +852,23 @@ struct sr_if *sr_get_interface_byIP(struct sr_instance *sr,
   assert(sr);
 
   if_walker = sr->if_list;
-  while(if_walker){/**********************************************************************
- * file:  sr_router.c
- * date:  Mon Feb 18 12:50:42 PST 2002
- * Contact: casado@stanford.edu
- *
- * Description:
- *
- * This file contains all the functions that interact directly
- * with the routing table, as well as the main entry method
- * for routing.
- *
- **********************************************************************/
-
-#include <stdio.h>
-#include <assert.h>
-#include <string.h>
-#include <stdlib.h>
-
-#include "sr_if.h"
-#include "sr_rt.h"
-#include "sr_router.h"
-#include "sr_protocol.h"
-#include "sr_arpcache.h"
-#include "sr_utils.h"
-
-
-/*---------------------------------------------------------------------
- * Method: sr_init(void)
- * Scope:  Global
- *
- * Initialize the routing subsystem
- *
- *---------------------------------------------------------------------*/
-
-void sr_init(struct sr_instance* sr)
-{
-    /* REQUIRES */
-    assert(sr);
-
-    /* Initialize cache and cache cleanup thread */
-    sr_arpcache_init(&(sr->cache));
-
-    pthread_attr_init(&(sr->attr));
-    pthread_attr_setdetachstate(&(sr->attr), PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_t thread;
-
-    pthread_create(&thread, &(sr->attr), sr_arpcache_timeout, sr);
-    
-    /* Add initialization code here! */
-
-} /* -- sr_init -- */
-
-/*---------------------------------------------------------------------
- * Method: sr_handlepacket(uint8_t* p,char* interface)
- * Scope:  Global
- *
- * This method is called each time the router receives a packet on the
- * interface.  The packet buffer, the packet length and the receiving
- * interface are passed in as parameters. The packet is complete with
- * ethernet headers.
- *
- * Note: Both the packet buffer and the character's memory are handled
- * by sr_vns_comm.c that means do NOT delete either.  Make a copy of the
- * packet instead if you intend to keep it around beyond the scope of
- * the method call.
- *
- *---------------------------------------------------------------------*/
-
-void sr_handlepacket(struct sr_instance* sr,
-                     uint8_t * packet/* lent */,
-                     unsigned int len,
-                     char* interface/* lent */)
-{
-  /* REQUIRES */
-  assert(sr);
-  assert(packet);
-  assert(interface);
-
-  printf("\n*** -> Received packet of length %d \n",len);
-
-  if (len <  sizeof(sr_ethernet_hdr_t)) {
-    fprintf(stderr, "***** -> Failed to process ETHERNET header, insufficient length\n");
-    return;
-  }
-    
-  sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet; 
-    
-  uint16_t ether_type = ntohs(eth_hdr->ether_type);
-  struct sr_if *interface_detail = sr_get_interface(sr, interface);
-    
-  if (ether_type == ethertype_arp) 
-  {
-      printf("***** -> Going to sr_handle_ARP_packet \n");
-      sr_handle_arp_packet(sr, packet, len, interface);
-
-  } else if (ether_type == ethertype_ip) {
-
-      printf("***** -> Going to sr_handle_IP_packet \n");
-      sr_handle_ip_packet(sr, packet, len, interface_detail);
-  }
-
-}/* end sr_ForwardPacket */
-
-
-void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-                         unsigned int len,
-                         struct sr_if *interface){
-
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_handle_ip_packet() ====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_if *dest_interface = sr_get_interface_byIP(sr,ihdr->ip_dst);
-
-  unsigned int check_len1 = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t);
-  unsigned int check_len2 = sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl*4);
-  uint16_t sum = ihdr->ip_sum;
-  ihdr->ip_sum = 0;
-  uint16_t ck_sum = cksum(ihdr,ihdr->ip_hl*4);
-  ihdr->ip_sum = sum;
-
-  if(len < check_len1 || len < check_len2){
-    printf("*** -> ERROR!!!! -> not enough length or check sum not mach\n");
-  }
-  if (sum != ck_sum){
-   printf("ERROR!!!!!!!!!!!!!!!!!!!!!1, check sum not match");}
-  /* find address , directly forward*/
-  if(!dest_interface){
-    printf("***** -> Find dest_interface address, Going to sr_ip_forward \n");
-    sr_ip_forward(sr,packet,len);
-  
-  /*if address is not found*/
-  } else {
-    printf("***** -> IP address not found, checking for ICMP \n");
-    
-    if(ihdr->ip_p == ip_protocol_icmp)
+  while(if_walker){
+    if (ip == if_walker->ip)
     {
-      printf("****** -> It's a ICMP message \n");
-      sr_icmp_handler(sr,packet,len);
-
-    } else if (ihdr->ip_p == 0x0006 || ihdr->ip_p == 0x0001){
-      /* icmp type   unreachable = 3
-         icmp code = unreachable = 3  */
-      printf("****** -> IP address not found and not a ICMP msg, Preparing icmp 3 3 \n");
-      sr_send_icmp(sr,packet, len, 3, 3);
+      return if_walker;
     }
+    if_walker = if_walker->next;
   }
-}/* end sr_handle_ip packets*/
-
-
-
-void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len){
+  return 0;
+}
 
+/* O(1), 0 for -1 and anything else out of range */
+struct sr_if *sr_get_interface_byIndex(struct sr_instance *sr,
+                                       int ifindex){
   assert(sr);
-  assert(packet);
-  printf("\n==== sr_ip_forward ====\n");
-
-  sr_ip_hdr_t *ihdr =(sr_ip_hdr_t *) (sizeof(sr_ethernet_hdr_t) + packet);
-  ihdr->ip_ttl--;
-  ihdr->ip_sum = 0;
-  ihdr->ip_sum = cksum(ihdr,ihdr->ip_hl*4);
-  struct sr_rt *lpm = sr_lpm(sr, ihdr->ip_dst);
 
-  if(ihdr->ip_ttl == 0){
-    /* 
-    icmp type : time excceded = 11
-    icmp code : time exceeded_ttl = 0
-    */
-    printf("**** -> IP packet TTL == 0 \n");
-    sr_send_icmp(sr,packet,len, 11, 0);
-    return;
-  }
-  
-  if (!lpm)
-  {
-    /*
-    icmp type : unreachable = 3
-    icmp code : unreachable-net = 0
-    */
-    printf("**** -> IP packet not LMP, preparing ICMP 3 0 Destination Net unreachable\n");
-    sr_send_icmp(sr, packet, len, 3, 0);
-    return;
-  }
-
-  printf("**** -> Sending ip Packet L:185\n");
-  struct sr_if *out_interface =  sr_get_interface(sr, lpm->interface);
-  sr_sending(sr, packet, len, out_interface, lpm->gw.s_addr);
-
-} /* end sr_ip_forward */
-
-
-void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
-                  uint8_t type,
-                  uint8_t code)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_send_icmp() ====\n");
-
-  sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet; 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_rt *lpm = sr_lpm(sr,ihdr->ip_src);
-  struct sr_if *out_interface = sr_get_interface(sr,lpm->interface);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t)+ sizeof(ihdr->ip_hl *4) + packet);
-  /*
-    handle ICMP according to following type and code. 
-    Type 
-    unreachable     3
-    time exceed     11
-    echo            0
-
-    code
-    unreachable_host = 1
-    unreachable_net = 0
-    unreachable_port = 3
-    time_exceed = 0
-    echo reply = 0 */
-
-  /* type = unreachable*/
-  if(type == 3){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-    /* icmp code = unrachable_port = 3*/
-    if(code == 3){
-      new_ihdr->ip_src = ihdr->ip_dst;
-    }else{
-      new_ihdr->ip_src = out_interface->ip;
-    }
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /*type = time exceed*/
-  }else if (type == 11){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_src = out_interface->ip;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /* echo reply*/
-  }else if (type == 0){
-
-    /*update ip hearder*/
-    uint32_t ip_dst = ihdr->ip_src;
-    ihdr->ip_src = ihdr->ip_dst;
-    ihdr->ip_dst = ip_dst;
-
-    /*update icmp header*/
-
-    ichdr->icmp_type = 0;
-    ichdr->icmp_code = 0;
-    ichdr->icmp_sum = 0;
-    ichdr->icmp_sum = cksum(ichdr,ntohs(ihdr->ip_len)-(ihdr->ip_hl*4));
-    /*update ethernet header*/
-    memset(ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(ehdr->ether_dhost,0,ETHER_ADDR_LEN);  
-
-    sr_sending(sr,packet,len,out_interface,lpm->gw.s_addr);
-  }
-}
-
-
-
-void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_icmp_handler() =====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t)+packet);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl * 4) + packet);
-  unsigned int check_len = sizeof(sr_icmp_hdr_t) + (ihdr->ip_hl*4) + sizeof(sr_ethernet_hdr_t);
-  uint16_t sum = ichdr->icmp_sum;
-  ichdr->icmp_sum = 0;
-  uint16_t check_sum = cksum(ichdr,ntohs(ihdr->ip_len) - (ihdr->ip_hl*4));
-  ichdr->icmp_sum = sum;
-
-  if( len < check_len || sum != check_sum){
-    fprintf(stderr,"**** -> Faill to produce ICMP header , not enough length or check sum not mach \n");
-  }
-
-  /* when type is echo request = 8 , and code is echo request = 0*/
-  if (ichdr->icmp_type == 8 && ichdr->icmp_code == 0){
-    printf("**** -> type is echo request = 8 , and code is echo request = 0\n");
-    /* send echo replay type = 0 , echo reply code = 0*/
-    sr_send_icmp(sr,packet,len,0,0);
-  }
-}/* end sr_icmp_handler */
-
-
-void sr_sending(struct sr_instance *sr,
-                uint8_t *packet,
-                unsigned int len,
-                struct sr_if *interface,
-                uint32_t ip){
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_sending() ==== \n");
-
-  struct sr_arpentry *arp = sr_arpcache_lookup(&(sr->cache),ip);
-
-  if(arp){
-    printf("**** -> IP->MAC mapping is in the cache. L:369\n");
-    sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet;
-
-    memcpy(ehdr->ether_dhost,arp->mac,ETHER_ADDR_LEN);
-    memcpy(ehdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
-
-    sr_send_packet(sr,packet,len,interface->name);
-
-  }else{
-    printf("**** -> IP->MAC mapping NOT in the cache. L:378\n");
-    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->name);
-    sr_handle_arpreq(sr,request);
-
-  }
-}/* end sr_sending */
-
-
-void sr_handle_arp_packet(struct sr_instance *sr, 
-                          uint8_t *packet,
-                          unsigned int len,
-                          char *receiving_interface)
-{
-    /* REQUIRES */
-    assert(sr);
-    assert(packet);
-    assert(receiving_interface);
-    printf("\n==== handle_arp_packet() ====\n");
-
-    /*Check packet length*/
-    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
-    {
-      fprintf(stderr, "**** -> ERROR: Incorrect packet length\n");
-      return;
-    }
-
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
-    struct sr_if *receive_interface = sr_get_interface(sr, receiving_interface);
-    struct sr_if *sender_interface  = sr_get_interface_byIP(sr, arp_hdr->ar_tip); 
-
-    /*Check interface whether in router's IP address*/
-    if (!receive_interface)
-    {
-      fprintf(stderr, "**** -> ERROR: Invalid inter/**********************************************************************
- * file:  sr_router.c
- * date:  Mon Feb 18 12:50:42 PST 2002
- * Contact: casado@stanford.edu
- *
- * Description:
- *
- * This file contains all the functions that interact directly
- * with the routing table, as well as the main entry method
- * for routing.
- *
- **********************************************************************/
-
-#include <stdio.h>
-#include <assert.h>
-#include <string.h>
-#include <stdlib.h>
-
-#include "sr_if.h"
-#include "sr_rt.h"
-#include "sr_router.h"
-#include "sr_protocol.h"
-#include "sr_arpcache.h"
-#include "sr_utils.h"
-
-
-/*---------------------------------------------------------------------
- * Method: sr_init(void)
- * Scope:  Global
- *
- * Initialize the routing subsystem
- *
- *---------------------------------------------------------------------*/
-
-void sr_init(struct sr_instance* sr)
-{
-    /* REQUIRES */
-    assert(sr);
-
-    /* Initialize cache and cache cleanup thread */
-    sr_arpcache_init(&(sr->cache));
-
-    pthread_attr_init(&(sr->attr));
-    pthread_attr_setdetachstate(&(sr->attr), PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_t thread;
-
-    pthread_create(&thread, &(sr->attr), sr_arpcache_timeout, sr);
-    
-    /* Add initialization code here! */
-
-} /* -- sr_init -- */
-
-/*---------------------------------------------------------------------
- * Method: sr_handlepacket(uint8_t* p,char* interface)
- * Scope:  Global
- *
- * This method is called each time the router receives a packet on the
- * interface.  The packet buffer, the packet length and the receiving
- * interface are passed in as parameters. The packet is complete with
- * ethernet headers.
- *
- * Note: Both the packet buffer and the character's memory are handled
- * by sr_vns_comm.c that means do NOT delete either.  Make a copy of the
- * packet instead if you intend to keep it around beyond the scope of
- * the method call.
- *
- *---------------------------------------------------------------------*/
-
-void sr_handlepacket(struct sr_instance* sr,
-                     uint8_t * packet/* lent */,
-                     unsigned int len,
-                     char* interface/* lent */)
-{
-  /* REQUIRES */
-  assert(sr);
-  assert(packet);
-  assert(interface);
-
-  printf("\n*** -> Received packet of length %d \n",len);
-
-  if (len <  sizeof(sr_ethernet_hdr_t)) {
-    fprintf(stderr, "***** -> Failed to process ETHERNET header, insufficient length\n");
-    return;
-  }
-    
-  sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet; 
-    
-  uint16_t ether_type = ntohs(eth_hdr->ether_type);
-  struct sr_if *interface_detail = sr_get_interface(sr, interface);
-    
-  if (ether_type == ethertype_arp) 
-  {
-      printf("***** -> Going to sr_handle_ARP_packet \n");
-      sr_handle_arp_packet(sr, packet, len, interface);
-
-  } else if (ether_type == ethertype_ip) {
-
-      printf("***** -> Going to sr_handle_IP_packet \n");
-      sr_handle_ip_packet(sr, packet, len, interface_detail);
-  }
-
-}/* end sr_ForwardPacket */
-
-
-void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-                         unsigned int len,
-                         struct sr_if *interface){
-
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_handle_ip_packet() ====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_if *dest_interface = sr_get_interface_byIP(sr,ihdr->ip_dst);
-
-  unsigned int check_len1 = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t);
-  unsigned int check_len2 = sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl*4);
-  uint16_t sum = ihdr->ip_sum;
-  ihdr->ip_sum = 0;
-  uint16_t ck_sum = cksum(ihdr,ihdr->ip_hl*4);
-  ihdr->ip_sum = sum;
-
-  if(len < check_len1 || len < check_len2){
-    printf("*** -> ERROR!!!! -> not enough length or check sum not mach\n");
-  }
-  if (sum != ck_sum){
-   printf("ERROR!!!!!!!!!!!!!!!!!!!!!1, check sum not match");}
-  /* find address , directly forward*/
-  if(!dest_interface){
-    printf("***** -> Find dest_interface address, Going to sr_ip_forward \n");
-    sr_ip_forward(sr,packet,len);
-  
-  /*if address is not found*/
-  } else {
-    printf("***** -> IP address not found, checking for ICMP \n");
-    
-    if(ihdr->ip_p == ip_protocol_icmp)
-    {
-      printf("****** -> It's a ICMP message \n");
-      sr_icmp_handler(sr,packet,len);
-
-    } else if (ihdr->ip_p == 0x0006 || ihdr->ip_p == 0x0001){
-      /* icmp type   unreachable = 3
-         icmp code = unreachable = 3  */
-      printf("****** -> IP address not found and not a ICMP msg, Preparing icmp 3 3 \n");
-      sr_send_icmp(sr,packet, len, 3, 3);
-    }
-  }
-}/* end sr_handle_ip packets*/
-
-
-
-void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len){
-
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_ip_forward ====\n");
-
-  sr_ip_hdr_t *ihdr =(sr_ip_hdr_t *) (sizeof(sr_ethernet_hdr_t) + packet);
-  ihdr->ip_ttl--;
-  ihdr->ip_sum = 0;
-  ihdr->ip_sum = cksum(ihdr,ihdr->ip_hl*4);
-  struct sr_rt *lpm = sr_lpm(sr, ihdr->ip_dst);
-
-  if(ihdr->ip_ttl == 0){
-    /* 
-    icmp type : time excceded = 11
-    icmp code : time exceeded_ttl = 0
-    */
-    printf("**** -> IP packet TTL == 0 \n");
-    sr_send_icmp(sr,packet,len, 11, 0);
-    return;
-  }
-  
-  if (!lpm)
-  {
-    /*
-    icmp type : unreachable = 3
-    icmp code : unreachable-net = 0
-    */
-    printf("**** -> IP packet not LMP, preparing ICMP 3 0 Destination Net unreachable\n");
-    sr_send_icmp(sr, packet, len, 3, 0);
-    return;
-  }
-
-  printf("**** -> Sending ip Packet L:185\n");
-  struct sr_if *out_interface =  sr_get_interface(sr, lpm->interface);
-  sr_sending(sr, packet, len, out_interface, lpm->gw.s_addr);
-
-} /* end sr_ip_forward */
-
-
-void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
-                  uint8_t type,
-                  uint8_t code)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_send_icmp() ====\n");
-
-  sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet; 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_rt *lpm = sr_lpm(sr,ihdr->ip_src);
-  struct sr_if *out_interface = sr_get_interface(sr,lpm->interface);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t)+ sizeof(ihdr->ip_hl *4) + packet);
-  /*
-    handle ICMP according to following type and code. 
-    Type 
-    unreachable     3
-    time exceed     11
-    echo            0
-
-    code
-    unreachable_host = 1
-    unreachable_net = 0
-    unreachable_port = 3
-    time_exceed = 0
-    echo reply = 0 */
-
-  /* type = unreachable*/
-  if(type == 3){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-    /* icmp code = unrachable_port = 3*/
-    if(code == 3){
-      new_ihdr->ip_src = ihdr->ip_dst;
-    }else{
-      new_ihdr->ip_src = out_interface->ip;
-    }
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /*type = time exceed*/
-  }else if (type == 11){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_src = out_interface->ip;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /* echo reply*/
-  }else if (type == 0){
-
-    /*update ip hearder*/
-    uint32_t ip_dst = ihdr->ip_src;
-    ihdr->ip_src = ihdr->ip_dst;
-    ihdr->ip_dst = ip_dst;
-
-    /*update icmp header*/
-
-    ichdr->icmp_type = 0;
-    ichdr->icmp_code = 0;
-    ichdr->icmp_sum = 0;
-    ichdr->icmp_sum = cksum(ichdr,ntohs(ihdr->ip_len)-(ihdr->ip_hl*4));
-    /*update ethernet header*/
-    memset(ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(ehdr->ether_dhost,0,ETHER_ADDR_LEN);  
-
-    sr_sending(sr,packet,len,out_interface,lpm->gw.s_addr);
-  }
-}
-
-
-
-void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_icmp_handler() =====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t)+packet);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl * 4) + packet);
-  unsigned int check_len = sizeof(sr_icmp_hdr_t) + (ihdr->ip_hl*4) + sizeof(sr_ethernet_hdr_t);
-  uint16_t sum = ichdr->icmp_sum;
-  ichdr->icmp_sum = 0;
-  uint16_t check_sum = cksum(ichdr,ntohs(ihdr->ip_len) - (ihdr->ip_hl*4));
-  ichdr->icmp_sum = sum;
-
-  if( len < check_len || sum != check_sum){
-    fprintf(stderr,"**** -> Faill to produce ICMP header , not enough length or check sum not mach \n");
-  }
-
-  /* when type is echo request = 8 , and code is echo request = 0*/
-  if (ichdr->icmp_type == 8 && ichdr->icmp_code == 0){
-    printf("**** -> type is echo request = 8 , and code is echo request = 0\n");
-    /* send echo replay type = 0 , echo reply code = 0*/
-    sr_send_icmp(sr,packet,len,0,0);
-  }
-}/* end sr_icmp_handler */
-
-
-void sr_sending(struct sr_instance *sr,
-                uint8_t *packet,
-                unsigned int len,
-                struct sr_if *interface,
-                uint32_t ip){
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_sending() ==== \n");
-
-  struct sr_arpentry *arp = sr_arpcache_lookup(&(sr->cache),ip);
-
-  if(arp){
-    printf("**** -> IP->MAC mapping is in the cache. L:369\n");
-    sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet;
-
-    memcpy(ehdr->ether_dhost,arp->mac,ETHER_ADDR_LEN);
-    memcpy(ehdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
-
-    sr_send_packet(sr,packet,len,interface->name);
-
-  }else{
-    printf("**** -> IP->MAC mapping NOT in the cache. L:378\n");
-    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->name);
-    sr_handle_arpreq(sr,request);
-
-  }
-}/* end sr_sending */
-
-
-void sr_handle_arp_packet(struct sr_instance *sr, 
-                          uint8_t *packet,
-                          unsigned int len,
-                          char *receiving_interface)
-{
-    /* REQUIRES */
-    assert(sr);
-    assert(packet);
-    assert(receiving_interface);
-    printf("\n==== handle_arp_packet() ====\n");
-
-    /*Check packet length*/
-    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
-    {
-      fprintf(stderr, "**** -> ERROR: Incorrect packet length\n");
-      return;
-    }
-
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
-    struct sr_if *receive_interface = sr_get_interface(sr, receiving_interface);
-    struct sr_if *sender_interface  = sr_get_interface_byIP(sr, arp_hdr->ar_tip); 
-
-    /*Check interface whether in router's IP address*/
-    if (!receive_interface)
-    {
-      fprintf(stderr, "**** -> ERROR: Invalid interface\n");
-      return;
-    }
-/**********************************************************************
- * file:  sr_router.c
- * date:  Mon Feb 18 12:50:42 PST 2002
- * Contact: casado@stanford.edu
- *
- * Description:
- *
- * This file contains all the functions that interact directly
- * with the routing table, as well as the main entry method
- * for routing.
- *
- **********************************************************************/
-
-#include <stdio.h>
-#include <assert.h>
-#include <string.h>
-#include <stdlib.h>
-
-#include "sr_if.h"
-#include "sr_rt.h"
-#include "sr_router.h"
-#include "sr_protocol.h"
-#include "sr_arpcache.h"
-#include "sr_utils.h"
-
-
-/*---------------------------------------------------------------------
- * Method: sr_init(void)
- * Scope:  Global
- *
- * Initialize the routing subsystem
- *
- *---------------------------------------------------------------------*/
-
-void sr_init(struct sr_instance* sr)
-{
-    /* REQUIRES */
-    assert(sr);
-
-    /* Initialize cache and cache cleanup thread */
-    sr_arpcache_init(&(sr->cache));
-
-    pthread_attr_init(&(sr->attr));
-    pthread_attr_setdetachstate(&(sr->attr), PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_t thread;
-
-    pthread_create(&thread, &(sr->attr), sr_arpcache_timeout, sr);
-    
-    /* Add initialization code here! */
-
-} /* -- sr_init -- */
-
-/*---------------------------------------------------------------------
- * Method: sr_handlepacket(uint8_t* p,char* interface)
- * Scope:  Global
- *
- * This method is called each time the router receives a packet on the
- * interface.  The packet buffer, the packet length and the receiving
- * interface are passed in as parameters. The packet is complete with
- * ethernet headers.
- *
- * Note: Both the packet buffer and the character's memory are handled
- * by sr_vns_comm.c that means do NOT delete either.  Make a copy of the
- * packet instead if you intend to keep it around beyond the scope of
- * the method call.
- *
- *---------------------------------------------------------------------*/
-
-void sr_handlepacket(struct sr_instance* sr,
-                     uint8_t * packet/* lent */,
-                     unsigned int len,
-                     char* interface/* lent */)
-{
-  /* REQUIRES */
-  assert(sr);
-  assert(packet);
-  assert(interface);
-
-  printf("\n*** -> Received packet of length %d \n",len);
-
-  if (len <  sizeof(sr_ethernet_hdr_t)) {
-    fprintf(stderr, "***** -> Failed to process ETHERNET header, insufficient length\n");
-    return;
-  }
-    
-  sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet; 
-    
-  uint16_t ether_type = ntohs(eth_hdr->ether_type);
-  struct sr_if *interface_detail = sr_get_interface(sr, interface);
-    
-  if (ether_type == ethertype_arp) 
-  {
-      printf("***** -> Going to sr_handle_ARP_packet \n");
-      sr_handle_arp_packet(sr, packet, len, interface);
-
-  } else if (ether_type == ethertype_ip) {
-
-      printf("***** -> Going to sr_handle_IP_packet \n");
-      sr_handle_ip_packet(sr, packet, len, interface_detail);
-  }
-
-}/* end sr_ForwardPacket */
-
-
-void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-                         unsigned int len,
-                         struct sr_if *interface){
-
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_handle_ip_packet() ====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_if *dest_interface = sr_get_interface_byIP(sr,ihdr->ip_dst);
-
-  unsigned int check_len1 = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t);
-  unsigned int check_len2 = sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl*4);
-  uint16_t sum = ihdr->ip_sum;
-  ihdr->ip_sum = 0;
-  uint16_t ck_sum = cksum(ihdr,ihdr->ip_hl*4);
-  ihdr->ip_sum = sum;
-
-  if(len < check_len1 || len < check_len2){
-    printf("*** -> ERROR!!!! -> not enough length or check sum not mach\n");
-  }
-  if (sum != ck_sum){
-   printf("ERROR!!!!!!!!!!!!!!!!!!!!!1, check sum not match");}
-  /* find address , directly forward*/
-  if(!dest_interface){
-    printf("***** -> Find dest_interface address, Going to sr_ip_forward \n");
-    sr_ip_forward(sr,packet,len);
-  
-  /*if address is not found*/
-  } else {
-    printf("***** -> IP address not found, checking for ICMP \n");
-    
-    if(ihdr->ip_p == ip_protocol_icmp)
-    {
-      printf("****** -> It's a ICMP message \n");
-      sr_icmp_handler(sr,packet,len);
-
-    } else if (ihdr->ip_p == 0x0006 || ihdr->ip_p == 0x0001){
-      /* icmp type   unreachable = 3
-         icmp code = unreachable = 3  */
-      printf("****** -> IP address not found and not a ICMP msg, Preparing icmp 3 3 \n");
-      sr_send_icmp(sr,packet, len, 3, 3);
-    }
-  }
-}/* end sr_handle_ip packets*/
-
-
-
-void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len){
-
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_ip_forward ====\n");
-
-  sr_ip_hdr_t *ihdr =(sr_ip_hdr_t *) (sizeof(sr_ethernet_hdr_t) + packet);
-  ihdr->ip_ttl--;
-  ihdr->ip_sum = 0;
-  ihdr->ip_sum = cksum(ihdr,ihdr->ip_hl*4);
-  struct sr_rt *lpm = sr_lpm(sr, ihdr->ip_dst);
-
-  if(ihdr->ip_ttl == 0){
-    /* 
-    icmp type : time excceded = 11
-    icmp code : time exceeded_ttl = 0
-    */
-    printf("**** -> IP packet TTL == 0 \n");
-    sr_send_icmp(sr,packet,len, 11, 0);
-    return;
-  }
-  
-  if (!lpm)
-  {
-    /*
-    icmp type : unreachable = 3
-    icmp code : unreachable-net = 0
-    */
-    printf("**** -> IP packet not LMP, preparing ICMP 3 0 Destination Net unreachable\n");
-    sr_send_icmp(sr, packet, len, 3, 0);
-    return;
-  }
-
-  printf("**** -> Sending ip Packet L:185\n");
-  struct sr_if *out_interface =  sr_get_interface(sr, lpm->interface);
-  sr_sending(sr, packet, len, out_interface, lpm->gw.s_addr);
-
-} /* end sr_ip_forward */
-
-
-void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
-                  uint8_t type,
-                  uint8_t code)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_send_icmp() ====\n");
-
-  sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet; 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_rt *lpm = sr_lpm(sr,ihdr->ip_src);
-  struct sr_if *out_interface = sr_get_interface(sr,lpm->interface);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t)+ sizeof(ihdr->ip_hl *4) + packet);
-  /*
-    handle ICMP according to following type and code. 
-    Type 
-    unreachable     3
-    time exceed     11
-    echo            0
-
-    code
-    unreachable_host = 1
-    unreachable_net = 0
-    unreachable_port = 3
-    time_exceed = 0
-    echo reply = 0 */
-
-  /* type = unreachable*/
-  if(type == 3){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-    /* icmp code = unrachable_port = 3*/
-    if(code == 3){
-      new_ihdr->ip_src = ihdr->ip_dst;
-    }else{
-      new_ihdr->ip_src = out_interface->ip;
-    }
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /*type = time exceed*/
-  }else if (type == 11){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_src = out_interface->ip;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /* echo reply*/
-  }else if (type == 0){
-
-    /*update ip hearder*/
-    uint32_t ip_dst = ihdr->ip_src;
-    ihdr->ip_src = ihdr->ip_dst;
-    ihdr->ip_dst = ip_dst;
-
-    /*update icmp header*/
-
-    ichdr->icmp_type = 0;
-    ichdr->icmp_code = 0;
-    ichdr->icmp_sum = 0;
-    ichdr->icmp_sum = cksum(ichdr,ntohs(ihdr->ip_len)-(ihdr->ip_hl*4));
-    /*update ethernet header*/
-    memset(ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(ehdr->ether_dhost,0,ETHER_ADDR_LEN);  
-
-    sr_sending(sr,packet,len,out_interface,lpm->gw.s_addr);
-  }
-}
-
-
-
-void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_icmp_handler() =====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t)+packet);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl * 4) + packet);
-  unsigned int check_len = sizeof(sr_icmp_hdr_t) + (ihdr->ip_hl*4) + sizeof(sr_ethernet_hdr_t);
-  uint16_t sum = ichdr->icmp_sum;
-  ichdr->icmp_sum = 0;
-  uint16_t check_sum = cksum(ichdr,ntohs(ihdr->ip_len) - (ihdr->ip_hl*4));
-  ichdr->icmp_sum = sum;
-
-  if( len < check_len || sum != check_sum){
-    fprintf(stderr,"**** -> Faill to produce ICMP header , not enough length or check sum not mach \n");
-  }
-
-  /* when type is echo request = 8 , and code is echo request = 0*/
-  if (ichdr->icmp_type == 8 && ichdr->icmp_code == 0){
-    printf("**** -> type is echo request = 8 , and code is echo request = 0\n");
-    /* send echo replay type = 0 , echo reply code = 0*/
-    sr_send_icmp(sr,packet,len,0,0);
-  }
-}/* end sr_icmp_handler */
-
-
-void sr_sending(struct sr_instance *sr,
-                uint8_t *packet,
-                unsigned int len,
-                struct sr_if *interface,
-                uint32_t ip){
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_sending() ==== \n");
-
-  struct sr_arpentry *arp = sr_arpcache_lookup(&(sr->cache),ip);
-
-  if(arp){
-    printf("**** -> IP->MAC mapping is in the cache. L:369\n");
-    sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet;
-
-    memcpy(ehdr->ether_dhost,arp->mac,ETHER_ADDR_LEN);
-    memcpy(ehdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
-
-    sr_send_packet(sr,packet,len,interface->name);
-
-  }else{
-    printf("**** -> IP->MAC mapping NOT in the cache. L:378\n");
-    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->name);
-    sr_handle_arpreq(sr,request);
-
-  }
-}/* end sr_sending */
-
-
-void sr_handle_arp_packet(struct sr_instance *sr, 
-                          uint8_t *packet,
-                          unsigned int len,
-                          char *receiving_interface)
-{
-    /* REQUIRES */
-    assert(sr);
-    assert(packet);
-    assert(receiving_interface);
-    printf("\n==== handle_arp_packet() ====\n");
-
-    /*Check packet length*/
-    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
-    {
-      fprintf(stderr, "**** -> ERROR: Incorrect packet length\n");
-      return;
-    }
-
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
-    struct sr_if *receive_interface = sr_get_interface(sr, receiving_interface);
-    struct sr_if *sender_interface  = sr_get_interface_byIP(sr, arp_hdr->ar_tip); 
-
-    /*Check interface whether in router's IP address*/
-    if (!receive_interface)
-    {
-      fprintf(stderr, "**** -> ERROR: Invalid interface\n");
-      return;
-    }
-
-    /* Get arp_opcode: request or replay to me*/
-    if (ntohs(arp_hdr->ar_op) == arp_op_request){           /* Request to me, send a reply*/
-        printf("***** -> this is a arp request, preparing a reply L:419\n");
-        sr_handle_arp_send_reply_to_requester(sr, packet, receive_interface, sender_interface);
-  
-    } else if (ntohs(arp_hdr->ar_op) == arp_op_reply){    /* Reply to me, cache it */
-     
-        printf("***** -> This is a REPLY to me, CACHE it L:422 \n");
-        sr_handle_arp_cache_reply(sr, packet, receive_interface);
-    } 
-}/* end sr_handle_arp_packet */
-
-
-void sr_handle_arp_cache_reply(struct sr_instance *sr,
-                               uint8_t *packet,
-                               struct sr_if *interface_info)
-{
-    printf("\n==== sr_handle_arp_cache_reply() ==== \n");
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Cache it */
-    struct sr_arpreq *requests = sr_arpcache_insert(&(sr->cache), arp_hdr->ar_sha, arp_hdr->ar_sip); 
-
-    printf("*** -> Go through my request queue for this IP and send outstanding packets if there are any \n");
-    /* Go through my request queue for this IP and send outstanding packets if there are any*/
-    if(requests)
-    {
-      struct sr_packet *pkts         = NULL;
-      struct sr_if *dest_if          = NULL;
-      sr_ethernet_hdr_t *pkt_eth_hdr = NULL; 
-      
-      pkts = requests->packets;
-      while(pkts)
-      {
-	printf("**** -> Iterating request queue\n");
-        pkt_eth_hdr = (sr_ethernet_hdr_t *)(pkts->buf);
-        dest_if = sr_get_interface(sr, pkts->iface);
-
-        /* source and desti mac addresss switched*/
-        memcpy(pkt_eth_hdr->ether_shost, dest_if->addr, ETHER_ADDR_LEN);
-        memcpy(pkt_eth_hdr->ether_dhost, arp_hdr->ar_sha, ETHER_ADDR_LEN);
-        sr_send_packet(sr, pkts->buf, pkts->len, pkts->iface);
-        pkts = pkts->next;
-      }
-
-      sr_arpreq_destroy(&(sr->cache), requests);
-    }
-
-}/* end sr_handle_arp_send_reply */
-
-
-void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
-                                           uint8_t *packet,
-                                           struct sr_if *receive_interface,
-                                           struct sr_if *sender_interface)
-{ 
-    printf("\n==== sr_handle_arp_send_reply_to_requester() =====\n");
-    printf("**** -> Preparing packet....\n");  
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Consttruct a ARP reply*/
-    unsigned int packet_len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t); 
-    uint8_t *reply = (uint8_t *) malloc(packet_len); 
-    sr_ethernet_hdr_t *new_ether_hdr = (sr_ethernet_hdr_t *) reply;
-    sr_arp_hdr_t *new_arp_hdr = (sr_arp_hdr_t *)(reply + sizeof(sr_ethernet_hdr_t));
-
-    /* Construct the ethernet header */
-    new_ether_hdr->ether_type = eth_hdr->ether_type;
-    memcpy(new_ether_hdr->ether_dhost, eth_hdr->ether_shost, ETHER_ADDR_LEN);
-    memcpy(new_ether_hdr->ether_shost, receive_interface->addr,ETHER_ADDR_LEN);
-
-    /* Construct the ARP header */
-    new_arp_hdr->ar_hrd = arp_hdr->ar_hrd;      /* format of hardware address   */
-    new_arp_hdr->ar_pro = arp_hdr->ar_pro;      /* format of protocol address   */
-    new_arp_hdr->ar_hln = arp_hdr->ar_hln;     /* length of hardware address   */
-    new_arp_hdr->ar_pln = arp_hdr->ar_pln;      /* length of protocol address   */
-    new_arp_hdr->ar_op  = htons(arp_op_reply);  /* ARP opcode (command)         */
-    new_arp_hdr->ar_sip = sender_interface->ip;   /* Sender IP address            */
-    new_arp_hdr->ar_tip = arp_hdr->ar_sip;      /* Target IP address            */
-    memcpy(new_arp_hdr->ar_sha, receive_interface->addr, ETHER_ADDR_LEN); /* sender hardware address      */
-    memcpy(new_arp_hdr->ar_tha, arp_hdr->ar_sha, ETHER_ADDR_LEN);  /* target hardware address      */
-
-    /* ARP replies are sent directly to the requester?s MAC address*/
-    printf("***** -> Finsihed packeting, going sr_sr_send_packet()\n");
-    sr_send_packet(sr, reply, packet_len, sender_interface->name);
-    free(reply);
-} /* end sr_handle_arp_manage_reply */
-
-
-/* HELPERS */
-struct sr_if *sr_get_interface_byIP(struct sr_insta/**********************************************************************
- * file:  sr_router.c
- * date:  Mon Feb 18 12:50:42 PST 2002
- * Contact: casado@stanford.edu
- *
- * Description:
- *
- * This file contains all the functions that interact directly
- * with the routing table, as well as the main entry method
- * for routing.
- *
- **********************************************************************/
-
-#include <stdio.h>
-#include <assert.h>
-#include <string.h>
-#include <stdlib.h>
-
-#include "sr_if.h"
-#include "sr_rt.h"
-#include "sr_router.h"
-#include "sr_protocol.h"
-#include "sr_arpcache.h"
-#include "sr_utils.h"
-
-
-/*---------------------------------------------------------------------
- * Method: sr_init(void)
- * Scope:  Global
- *
- * Initialize the routing subsystem
- *
- *---------------------------------------------------------------------*/
-
-void sr_init(struct sr_instance* sr)
-{
-    /* REQUIRES */
-    assert(sr);
-
-    /* Initialize cache and cache cleanup thread */
-    sr_arpcache_init(&(sr->cache));
-
-    pthread_attr_init(&(sr->attr));
-    pthread_attr_setdetachstate(&(sr->attr), PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_attr_setscope(&(sr->attr), PTHREAD_SCOPE_SYSTEM);
-    pthread_t thread;
-
-    pthread_create(&thread, &(sr->attr), sr_arpcache_timeout, sr);
-    
-    /* Add initialization code here! */
-
-} /* -- sr_init -- */
-
-/*---------------------------------------------------------------------
- * Method: sr_handlepacket(uint8_t* p,char* interface)
- * Scope:  Global
- *
- * This method is called each time the router receives a packet on the
- * interface.  The packet buffer, the packet length and the receiving
- * interface are passed in as parameters. The packet is complete with
- * ethernet headers.
- *
- * Note: Both the packet buffer and the character's memory are handled
- * by sr_vns_comm.c that means do NOT delete either.  Make a copy of the
- * packet instead if you intend to keep it around beyond the scope of
- * the method call.
- *
- *---------------------------------------------------------------------*/
-
-void sr_handlepacket(struct sr_instance* sr,
-                     uint8_t * packet/* lent */,
-                     unsigned int len,
-                     char* interface/* lent */)
-{
-  /* REQUIRES */
-  assert(sr);
-  assert(packet);
-  assert(interface);
-
-  printf("\n*** -> Received packet of length %d \n",len);
-
-  if (len <  sizeof(sr_ethernet_hdr_t)) {
-    fprintf(stderr, "***** -> Failed to process ETHERNET header, insufficient length\n");
-    return;
-  }
-    
-  sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet; 
-    
-  uint16_t ether_type = ntohs(eth_hdr->ether_type);
-  struct sr_if *interface_detail = sr_get_interface(sr, interface);
-    
-  if (ether_type == ethertype_arp) 
-  {
-      printf("***** -> Going to sr_handle_ARP_packet \n");
-      sr_handle_arp_packet(sr, packet, len, interface);
-
-  } else if (ether_type == ethertype_ip) {
-
-      printf("***** -> Going to sr_handle_IP_packet \n");
-      sr_handle_ip_packet(sr, packet, len, interface_detail);
-  }
-
-}/* end sr_ForwardPacket */
-
-
-void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-                         unsigned int len,
-                         struct sr_if *interface){
-
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_handle_ip_packet() ====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_if *dest_interface = sr_get_interface_byIP(sr,ihdr->ip_dst);
-
-  unsigned int check_len1 = sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t);
-  unsigned int check_len2 = sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl*4);
-  uint16_t sum = ihdr->ip_sum;
-  ihdr->ip_sum = 0;
-  uint16_t ck_sum = cksum(ihdr,ihdr->ip_hl*4);
-  ihdr->ip_sum = sum;
-
-  if(len < check_len1 || len < check_len2){
-    printf("*** -> ERROR!!!! -> not enough length or check sum not mach\n");
-  }
-  if (sum != ck_sum){
-   printf("ERROR!!!!!!!!!!!!!!!!!!!!!1, check sum not match");}
-  /* find address , directly forward*/
-  if(!dest_interface){
-    printf("***** -> Find dest_interface address, Going to sr_ip_forward \n");
-    sr_ip_forward(sr,packet,len);
-  
-  /*if address is not found*/
-  } else {
-    printf("***** -> IP address not found, checking for ICMP \n");
-    
-    if(ihdr->ip_p == ip_protocol_icmp)
-    {
-      printf("****** -> It's a ICMP message \n");
-      sr_icmp_handler(sr,packet,len);
-
-    } else if (ihdr->ip_p == 0x0006 || ihdr->ip_p == 0x0001){
-      /* icmp type   unreachable = 3
-         icmp code = unreachable = 3  */
-      printf("****** -> IP address not found and not a ICMP msg, Preparing icmp 3 3 \n");
-      sr_send_icmp(sr,packet, len, 3, 3);
-    }
-  }
-}/* end sr_handle_ip packets*/
-
-
-
-void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len){
-
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_ip_forward ====\n");
-
-  sr_ip_hdr_t *ihdr =(sr_ip_hdr_t *) (sizeof(sr_ethernet_hdr_t) + packet);
-  ihdr->ip_ttl--;
-  ihdr->ip_sum = 0;
-  ihdr->ip_sum = cksum(ihdr,ihdr->ip_hl*4);
-  struct sr_rt *lpm = sr_lpm(sr, ihdr->ip_dst);
-
-  if(ihdr->ip_ttl == 0){
-    /* 
-    icmp type : time excceded = 11
-    icmp code : time exceeded_ttl = 0
-    */
-    printf("**** -> IP packet TTL == 0 \n");
-    sr_send_icmp(sr,packet,len, 11, 0);
-    return;
-  }
-  
-  if (!lpm)
-  {
-    /*
-    icmp type : unreachable = 3
-    icmp code : unreachable-net = 0
-    */
-    printf("**** -> IP packet not LMP, preparing ICMP 3 0 Destination Net unreachable\n");
-    sr_send_icmp(sr, packet, len, 3, 0);
-    return;
-  }
-
-  printf("**** -> Sending ip Packet L:185\n");
-  struct sr_if *out_interface =  sr_get_interface(sr, lpm->interface);
-  sr_sending(sr, packet, len, out_interface, lpm->gw.s_addr);
-
-} /* end sr_ip_forward */
-
-
-void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
-                  uint8_t type,
-                  uint8_t code)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_send_icmp() ====\n");
-
-  sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet; 
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + packet);
-  struct sr_rt *lpm = sr_lpm(sr,ihdr->ip_src);
-  struct sr_if *out_interface = sr_get_interface(sr,lpm->interface);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t)+ sizeof(ihdr->ip_hl *4) + packet);
-  /*
-    handle ICMP according to following type and code. 
-    Type 
-    unreachable     3
-    time exceed     11
-    echo            0
-
-    code
-    unreachable_host = 1
-    unreachable_net = 0
-    unreachable_port = 3
-    time_exceed = 0
-    echo reply = 0 */
-
-  /* type = unreachable*/
-  if(type == 3){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-    /* icmp code = unrachable_port = 3*/
-    if(code == 3){
-      new_ihdr->ip_src = ihdr->ip_dst;
-    }else{
-      new_ihdr->ip_src = out_interface->ip;
-    }
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /*type = time exceed*/
-  }else if (type == 11){
-    uint8_t *data = (uint8_t *)malloc(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t));
-    assert(data);
-
-    sr_ip_hdr_t *new_ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t) + data);
-    sr_ethernet_hdr_t *new_ehdr = (sr_ethernet_hdr_t *)data;
-    sr_icmp_t3_hdr_t *new_ichdr = (sr_icmp_t3_hdr_t *)(sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + data);
-
-    /*crate ip header*/
-    new_ihdr->ip_p = ip_protocol_icmp;
-    new_ihdr->ip_hl = sizeof(sr_ip_hdr_t)/4;
-    new_ihdr->ip_tos = 0;
-    new_ihdr->ip_len = htons(sizeof(sr_icmp_t3_hdr_t) + sizeof(sr_ip_hdr_t));
-    new_ihdr->ip_id = htons(0);
-    new_ihdr->ip_off = htons(IP_DF);
-    new_ihdr->ip_ttl = 64;
-    new_ihdr->ip_v = 4;
-    new_ihdr->ip_dst = ihdr->ip_src;
-    new_ihdr->ip_src = out_interface->ip;
-    new_ihdr->ip_sum = 0;
-    new_ihdr->ip_sum = cksum(new_ihdr,sizeof(sr_ip_hdr_t));
-
-    /*create icmp header*/
-    new_ichdr->icmp_type = type;
-    new_ichdr->icmp_code = code;
-    new_ichdr->unused = 0;
-    new_ichdr->next_mtu = 0;
-    new_ichdr->icmp_sum = 0;
-    new_ichdr->icmp_sum = cksum(new_ichdr,sizeof(sr_icmp_t3_hdr_t));
-    memcpy(new_ichdr->data,ihdr,ICMP_DATA_SIZE);
-
-    /*create ethernet header*/
-    new_ehdr->ether_type = htons(ethertype_ip);
-    memset(new_ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(new_ehdr->ether_dhost,0,ETHER_ADDR_LEN);
-
-    uint32_t new_length = sizeof(sr_ip_hdr_t) + sizeof(sr_ethernet_hdr_t) + sizeof(sr_icmp_t3_hdr_t);
-    sr_sending(sr,data,new_length,out_interface,lpm->gw.s_addr);
-    free(data);
-
-    /* echo reply*/
-  }else if (type == 0){
-
-    /*update ip hearder*/
-    uint32_t ip_dst = ihdr->ip_src;
-    ihdr->ip_src = ihdr->ip_dst;
-    ihdr->ip_dst = ip_dst;
-
-    /*update icmp header*/
-
-    ichdr->icmp_type = 0;
-    ichdr->icmp_code = 0;
-    ichdr->icmp_sum = 0;
-    ichdr->icmp_sum = cksum(ichdr,ntohs(ihdr->ip_len)-(ihdr->ip_hl*4));
-    /*update ethernet header*/
-    memset(ehdr->ether_shost,0,ETHER_ADDR_LEN);
-    memset(ehdr->ether_dhost,0,ETHER_ADDR_LEN);  
-
-    sr_sending(sr,packet,len,out_interface,lpm->gw.s_addr);
-  }
-}
-
-
-
-void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len)
-{
-  assert(sr);
-  assert(packet);
-  printf("\n==== sr_icmp_handler() =====\n");
-
-  sr_ip_hdr_t *ihdr = (sr_ip_hdr_t *)(sizeof(sr_ethernet_hdr_t)+packet);
-  sr_icmp_hdr_t *ichdr = (sr_icmp_hdr_t *)(sizeof(sr_ethernet_hdr_t) + (ihdr->ip_hl * 4) + packet);
-  unsigned int check_len = sizeof(sr_icmp_hdr_t) + (ihdr->ip_hl*4) + sizeof(sr_ethernet_hdr_t);
-  uint16_t sum = ichdr->icmp_sum;
-  ichdr->icmp_sum = 0;
-  uint16_t check_sum = cksum(ichdr,ntohs(ihdr->ip_len) - (ihdr->ip_hl*4));
-  ichdr->icmp_sum = sum;
-
-  if( len < check_len || sum != check_sum){
-    fprintf(stderr,"**** -> Faill to produce ICMP header , not enough length or check sum not mach \n");
-  }
-
-  /* when type is echo request = 8 , and code is echo request = 0*/
-  if (ichdr->icmp_type == 8 && ichdr->icmp_code == 0){
-    printf("**** -> type is echo request = 8 , and code is echo request = 0\n");
-    /* send echo replay type = 0 , echo reply code = 0*/
-    sr_send_icmp(sr,packet,len,0,0);
-  }
-}/* end sr_icmp_handler */
-
-
-void sr_sending(struct sr_instance *sr,
-                uint8_t *packet,
-                unsigned int len,
-                struct sr_if *interface,
-                uint32_t ip){
-  assert(sr);
-  assert(packet);
-  assert(interface);
-  printf("\n==== sr_sending() ==== \n");
-
-  struct sr_arpentry *arp = sr_arpcache_lookup(&(sr->cache),ip);
-
-  if(arp){
-    printf("**** -> IP->MAC mapping is in the cache. L:369\n");
-    sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)packet;
-
-    memcpy(ehdr->ether_dhost,arp->mac,ETHER_ADDR_LEN);
-    memcpy(ehdr->ether_shost,interface->addr,ETHER_ADDR_LEN);
-
-    sr_send_packet(sr,packet,len,interface->name);
-
-  }else{
-    printf("**** -> IP->MAC mapping NOT in the cache. L:378\n");
-    struct sr_arpreq *request = sr_arpcache_queuereq(&(sr->cache),ip,packet,len,interface->name);
-    sr_handle_arpreq(sr,request);
-
-  }
-}/* end sr_sending */
-
-
-void sr_handle_arp_packet(struct sr_instance *sr, 
-                          uint8_t *packet,
-                          unsigned int len,
-                          char *receiving_interface)
-{
-    /* REQUIRES */
-    assert(sr);
-    assert(packet);
-    assert(receiving_interface);
-    printf("\n==== handle_arp_packet() ====\n");
-
-    /*Check packet length*/
-    if (len <  sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
-    {
-      fprintf(stderr, "**** -> ERROR: Incorrect packet length\n");
-      return;
-    }
-
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)( packet + sizeof(sr_ethernet_hdr_t));
-    struct sr_if *receive_interface = sr_get_interface(sr, receiving_interface);
-    struct sr_if *sender_interface  = sr_get_interface_byIP(sr, arp_hdr->ar_tip); 
-
-    /*Check interface whether in router's IP address*/
-    if (!receive_interface)
-    {
-      fprintf(stderr, "**** -> ERROR: Invalid interface\n");
-      return;
-    }
-
-    /* Get arp_opcode: request or replay to me*/
-    if (ntohs(arp_hdr->ar_op) == arp_op_request){           /* Request to me, send a reply*/
-        printf("***** -> this is a arp request, preparing a reply L:419\n");
-        sr_handle_arp_send_reply_to_requester(sr, packet, receive_interface, sender_interface);
-  
-    } else if (ntohs(arp_hdr->ar_op) == arp_op_reply){    /* Reply to me, cache it */
-     
-        printf("***** -> This is a REPLY to me, CACHE it L:422 \n");
-        sr_handle_arp_cache_reply(sr, packet, receive_interface);
-    } 
-}/* end sr_handle_arp_packet */
-
-
-void sr_handle_arp_cache_reply(struct sr_instance *sr,
-                               uint8_t *packet,
-                               struct sr_if *interface_info)
-{
-    printf("\n==== sr_handle_arp_cache_reply() ==== \n");
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Cache it */
-    struct sr_arpreq *requests = sr_arpcache_insert(&(sr->cache), arp_hdr->ar_sha, arp_hdr->ar_sip); 
-
-    printf("*** -> Go through my request queue for this IP and send outstanding packets if there are any \n");
-    /* Go through my request queue for this IP and send outstanding packets if there are any*/
-    if(requests)
-    {
-      struct sr_packet *pkts         = NULL;
-      struct sr_if *dest_if          = NULL;
-      sr_ethernet_hdr_t *pkt_eth_hdr = NULL; 
-      
-      pkts = requests->packets;
-      while(pkts)
-      {
-	printf("**** -> Iterating request queue\n");
-        pkt_eth_hdr = (sr_ethernet_hdr_t *)(pkts->buf);
-        dest_if = sr_get_interface(sr, pkts->iface);
-
-        /* source and desti mac addresss switched*/
-        memcpy(pkt_eth_hdr->ether_shost, dest_if->addr, ETHER_ADDR_LEN);
-        memcpy(pkt_eth_hdr->ether_dhost, arp_hdr->ar_sha, ETHER_ADDR_LEN);
-        sr_send_packet(sr, pkts->buf, pkts->len, pkts->iface);
-        pkts = pkts->next;
-      }
-
-      sr_arpreq_destroy(&(sr->cache), requests);
-    }
-
-}/* end sr_handle_arp_send_reply */
-
-
-void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
-                                           uint8_t *packet,
-                                           struct sr_if *receive_interface,
-                                           struct sr_if *sender_interface)
-{ 
-    printf("\n==== sr_handle_arp_send_reply_to_requester() =====\n");
-    printf("**** -> Preparing packet....\n");  
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Consttruct a ARP reply*/
-    unsigned int packet_len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t); 
-    uint8_t *reply = (uint8_t *) malloc(packet_len); 
-    sr_ethernet_hdr_t *new_ether_hdr = (sr_ethernet_hdr_t *) reply;
-    sr_arp_hdr_t *new_arp_hdr = (sr_arp_hdr_t *)(reply + sizeof(sr_ethernet_hdr_t));
-
-    /* Construct the ethernet header */
-    new_ether_hdr->ether_type = eth_hdr->ether_type;
-    memcpy(new_ether_hdr->ether_dhost, eth_hdr->ether_shost, ETHER_ADDR_LEN);
-    memcpy(new_ether_hdr->ether_shost, receive_interface->addr,ETHER_ADDR_LEN);
-
-    /* Construct the ARP header */
-    new_arp_hdr->ar_hrd = arp_hdr->ar_hrd;      /* format of hardware address   */
-    new_arp_hdr->ar_pro = arp_hdr->ar_pro;      /* format of protocol address   */
-    new_arp_hdr->ar_hln = arp_hdr->ar_hln;     /* length of hardware address   */
-    new_arp_hdr->ar_pln = arp_hdr->ar_pln;      /* length of protocol address   */
-    new_arp_hdr->ar_op  = htons(arp_op_reply);  /* ARP opcode (command)         */
-    new_arp_hdr->ar_sip = sender_interface->ip;   /* Sender IP address            */
-    new_arp_hdr->ar_tip = arp_hdr->ar_sip;      /* Target IP address            */
-    memcpy(new_arp_hdr->ar_sha, receive_interface->addr, ETHER_ADDR_LEN); /* sender hardware address      */
-    memcpy(new_arp_hdr->ar_tha, arp_hdr->ar_sha, ETHER_ADDR_LEN);  /* target hardware address      */
-
-    /* ARP replies are sent directly to the requester?s MAC address*/
-    printf("***** -> Finsihed packeting, going sr_sr_send_packet()\n");
-    sr_send_packet(sr, reply, packet_len, sender_interface->name);
-    free(reply);
-} /* end sr_handle_arp_manage_reply */
-
-
-/* HELPERS */
-struct sr_if *sr_get_interface_byIP(struct sr_instance *sr,
-                                    uint32_t ip){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (ip == if_walker->ip)
-    {
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
-                                    const unsigned char *addr){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-  assert(addr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (!memcpy(if_walker->addr,addr,ETHER_ADDR_LEN)){
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip){
-
-  assert(sr);
-  
-  struct sr_rt *lpm = 0;
-  struct sr_rt *rt_walker = 0;
-  uint32_t lpm_len = 0;
-
-  rt_walker = sr->routing_table;
-
-  while(rt_walker){
-    if((rt_walker->mask.s_addr & ip ) == (rt_walker->mask.s_addr & rt_walker->dest.s_addr)){
-      if(rt_walker->mask.s_addr >= lpm_len){
-        lpm = rt_walker;
-        lpm_len = rt_walker->mask.s_addr;
-      }
-    }
-    rt_walker = rt_walker->next;
-  }
-  return lpm;
-}
-
-nce *sr,
-                                    uint32_t ip){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (ip == if_walker->ip)
-    {
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
-                                    const unsigned char *addr){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-  assert(addr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (!memcpy(if_walker->addr,addr,ETHER_ADDR_LEN)){
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip){
-
-  assert(sr);
-  
-  struct sr_rt *lpm = 0;
-  struct sr_rt *rt_walker = 0;
-  uint32_t lpm_len = 0;
-
-  rt_walker = sr->routing_table;
-
-  while(rt_walker){
-    if((rt_walker->mask.s_addr & ip ) == (rt_walker->mask.s_addr & rt_walker->dest.s_addr)){
-      if(rt_walker->mask.s_addr >= lpm_len){
-        lpm = rt_walker;
-        lpm_len = rt_walker->mask.s_addr;
-      }
-    }
-    rt_walker = rt_walker->next;
-  }
-  return lpm;
-}
-
-
-    /* Get arp_opcode: request or replay to me*/
-    if (ntohs(arp_hdr->ar_op) == arp_op_request){           /* Request to me, send a reply*/
-        printf("***** -> this is a arp request, preparing a reply L:419\n");
-        sr_handle_arp_send_reply_to_requester(sr, packet, receive_interface, sender_interface);
-  
-    } else if (ntohs(arp_hdr->ar_op) == arp_op_reply){    /* Reply to me, cache it */
-     
-        printf("***** -> This is a REPLY to me, CACHE it L:422 \n");
-        sr_handle_arp_cache_reply(sr, packet, receive_interface);
-    } 
-}/* end sr_handle_arp_packet */
-
-
-void sr_handle_arp_cache_reply(struct sr_instance *sr,
-                               uint8_t *packet,
-                               struct sr_if *interface_info)
-{
-    printf("\n==== sr_handle_arp_cache_reply() ==== \n");
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Cache it */
-    struct sr_arpreq *requests = sr_arpcache_insert(&(sr->cache), arp_hdr->ar_sha, arp_hdr->ar_sip); 
-
-    printf("*** -> Go through my request queue for this IP and send outstanding packets if there are any \n");
-    /* Go through my request queue for this IP and send outstanding packets if there are any*/
-    if(requests)
-    {
-      struct sr_packet *pkts         = NULL;
-      struct sr_if *dest_if          = NULL;
-      sr_ethernet_hdr_t *pkt_eth_hdr = NULL; 
-      
-      pkts = requests->packets;
-      while(pkts)
-      {
-	printf("**** -> Iterating request queue\n");
-        pkt_eth_hdr = (sr_ethernet_hdr_t *)(pkts->buf);
-        dest_if = sr_get_interface(sr, pkts->iface);
-
-        /* source and desti mac addresss switched*/
-        memcpy(pkt_eth_hdr->ether_shost, dest_if->addr, ETHER_ADDR_LEN);
-        memcpy(pkt_eth_hdr->ether_dhost, arp_hdr->ar_sha, ETHER_ADDR_LEN);
-        sr_send_packet(sr, pkts->buf, pkts->len, pkts->iface);
-        pkts = pkts->next;
-      }
-
-      sr_arpreq_destroy(&(sr->cache), requests);
-    }
-
-}/* end sr_handle_arp_send_reply */
-
-
-void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
-                                           uint8_t *packet,
-                                           struct sr_if *receive_interface,
-                                           struct sr_if *sender_interface)
-{ 
-    printf("\n==== sr_handle_arp_send_reply_to_requester() =====\n");
-    printf("**** -> Preparing packet....\n");  
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Consttruct a ARP reply*/
-    unsigned int packet_len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t); 
-    uint8_t *reply = (uint8_t *) malloc(packet_len); 
-    sr_ethernet_hdr_t *new_ether_hdr = (sr_ethernet_hdr_t *) reply;
-    sr_arp_hdr_t *new_arp_hdr = (sr_arp_hdr_t *)(reply + sizeof(sr_ethernet_hdr_t));
-
-    /* Construct the ethernet header */
-    new_ether_hdr->ether_type = eth_hdr->ether_type;
-    memcpy(new_ether_hdr->ether_dhost, eth_hdr->ether_shost, ETHER_ADDR_LEN);
-    memcpy(new_ether_hdr->ether_shost, receive_interface->addr,ETHER_ADDR_LEN);
-
-    /* Construct the ARP header */
-    new_arp_hdr->ar_hrd = arp_hdr->ar_hrd;      /* format of hardware address   */
-    new_arp_hdr->ar_pro = arp_hdr->ar_pro;      /* format of protocol address   */
-    new_arp_hdr->ar_hln = arp_hdr->ar_hln;     /* length of hardware address   */
-    new_arp_hdr->ar_pln = arp_hdr->ar_pln;      /* length of protocol address   */
-    new_arp_hdr->ar_op  = htons(arp_op_reply);  /* ARP opcode (command)         */
-    new_arp_hdr->ar_sip = sender_interface->ip;   /* Sender IP address            */
-    new_arp_hdr->ar_tip = arp_hdr->ar_sip;      /* Target IP address            */
-    memcpy(new_arp_hdr->ar_sha, receive_interface->addr, ETHER_ADDR_LEN); /* sender hardware address      */
-    memcpy(new_arp_hdr->ar_tha, arp_hdr->ar_sha, ETHER_ADDR_LEN);  /* target hardware address      */
-
-    /* ARP replies are sent directly to the requester?s MAC address*/
-    printf("***** -> Finsihed packeting, going sr_sr_send_packet()\n");
-    sr_send_packet(sr, reply, packet_len, sender_interface->name);
-    free(reply);
-} /* end sr_handle_arp_manage_reply */
-
-
-/* HELPERS */
-struct sr_if *sr_get_interface_byIP(struct sr_instance *sr,
-                                    uint32_t ip){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (ip == if_walker->ip)
-    {
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
-                                    const unsigned char *addr){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-  assert(addr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (!memcpy(if_walker->addr,addr,ETHER_ADDR_LEN)){
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip){
-
-  assert(sr);
-  
-  struct sr_rt *lpm = 0;
-  struct sr_rt *rt_walker = 0;
-  uint32_t lpm_len = 0;
-
-  rt_walker = sr->routing_table;
-
-  while(rt_walker){
-    if((rt_walker->mask.s_addr & ip ) == (rt_walker->mask.s_addr & rt_walker->dest.s_addr)){
-      if(rt_walker->mask.s_addr >= lpm_len){
-        lpm = rt_walker;
-        lpm_len = rt_walker->mask.s_addr;
-      }
-    }
-    rt_walker = rt_walker->next;
-  }
-  return lpm;
-}
-
-face\n");
-      return;
-    }
-
-    /* Get arp_opcode: request or replay to me*/
-    if (ntohs(arp_hdr->ar_op) == arp_op_request){           /* Request to me, send a reply*/
-        printf("***** -> this is a arp request, preparing a reply L:419\n");
-        sr_handle_arp_send_reply_to_requester(sr, packet, receive_interface, sender_interface);
-  
-    } else if (ntohs(arp_hdr->ar_op) == arp_op_reply){    /* Reply to me, cache it */
-     
-        printf("***** -> This is a REPLY to me, CACHE it L:422 \n");
-        sr_handle_arp_cache_reply(sr, packet, receive_interface);
-    } 
-}/* end sr_handle_arp_packet */
-
-
-void sr_handle_arp_cache_reply(struct sr_instance *sr,
-                               uint8_t *packet,
-                               struct sr_if *interface_info)
-{
-    printf("\n==== sr_handle_arp_cache_reply() ==== \n");
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Cache it */
-    struct sr_arpreq *requests = sr_arpcache_insert(&(sr->cache), arp_hdr->ar_sha, arp_hdr->ar_sip); 
-
-    printf("*** -> Go through my request queue for this IP and send outstanding packets if there are any \n");
-    /* Go through my request queue for this IP and send outstanding packets if there are any*/
-    if(requests)
-    {
-      struct sr_packet *pkts         = NULL;
-      struct sr_if *dest_if          = NULL;
-      sr_ethernet_hdr_t *pkt_eth_hdr = NULL; 
-      
-      pkts = requests->packets;
-      while(pkts)
-      {
-	printf("**** -> Iterating request queue\n");
-        pkt_eth_hdr = (sr_ethernet_hdr_t *)(pkts->buf);
-        dest_if = sr_get_interface(sr, pkts->iface);
-
-        /* source and desti mac addresss switched*/
-        memcpy(pkt_eth_hdr->ether_shost, dest_if->addr, ETHER_ADDR_LEN);
-        memcpy(pkt_eth_hdr->ether_dhost, arp_hdr->ar_sha, ETHER_ADDR_LEN);
-        sr_send_packet(sr, pkts->buf, pkts->len, pkts->iface);
-        pkts = pkts->next;
-      }
-
-      sr_arpreq_destroy(&(sr->cache), requests);
-    }
-
-}/* end sr_handle_arp_send_reply */
-
-
-void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
-                                           uint8_t *packet,
-                                           struct sr_if *receive_interface,
-                                           struct sr_if *sender_interface)
-{ 
-    printf("\n==== sr_handle_arp_send_reply_to_requester() =====\n");
-    printf("**** -> Preparing packet....\n");  
-    sr_ethernet_hdr_t *eth_hdr = (sr_ethernet_hdr_t *)packet;
-    sr_arp_hdr_t *arp_hdr = (sr_arp_hdr_t *)(packet + sizeof(sr_ethernet_hdr_t));
-
-    /* Consttruct a ARP reply*/
-    unsigned int packet_len = sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t); 
-    uint8_t *reply = (uint8_t *) malloc(packet_len); 
-    sr_ethernet_hdr_t *new_ether_hdr = (sr_ethernet_hdr_t *) reply;
-    sr_arp_hdr_t *new_arp_hdr = (sr_arp_hdr_t *)(reply + sizeof(sr_ethernet_hdr_t));
-
-    /* Construct the ethernet header */
-    new_ether_hdr->ether_type = eth_hdr->ether_type;
-    memcpy(new_ether_hdr->ether_dhost, eth_hdr->ether_shost, ETHER_ADDR_LEN);
-    memcpy(new_ether_hdr->ether_shost, receive_interface->addr,ETHER_ADDR_LEN);
-
-    /* Construct the ARP header */
-    new_arp_hdr->ar_hrd = arp_hdr->ar_hrd;      /* format of hardware address   */
-    new_arp_hdr->ar_pro = arp_hdr->ar_pro;      /* format of protocol address   */
-    new_arp_hdr->ar_hln = arp_hdr->ar_hln;     /* length of hardware address   */
-    new_arp_hdr->ar_pln = arp_hdr->ar_pln;      /* length of protocol address   */
-    new_arp_hdr->ar_op  = htons(arp_op_reply);  /* ARP opcode (command)         */
-    new_arp_hdr->ar_sip = sender_interface->ip;   /* Sender IP address            */
-    new_arp_hdr->ar_tip = arp_hdr->ar_sip;      /* Target IP address            */
-    memcpy(new_arp_hdr->ar_sha, receive_interface->addr, ETHER_ADDR_LEN); /* sender hardware address      */
-    memcpy(new_arp_hdr->ar_tha, arp_hdr->ar_sha, ETHER_ADDR_LEN);  /* target hardware address      */
-
-    /* ARP replies are sent directly to the requester?s MAC address*/
-    printf("***** -> Finsihed packeting, going sr_sr_send_packet()\n");
-    sr_send_packet(sr, reply, packet_len, sender_interface->name);
-    free(reply);
-} /* end sr_handle_arp_manage_reply */
-
-
-/* HELPERS */
-struct sr_if *sr_get_interface_byIP(struct sr_instance *sr,
-                                    uint32_t ip){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (ip == if_walker->ip)
-    {
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
-                                    const unsigned char *addr){
-  struct sr_if *if_walker = 0;
-  assert(sr);
-  assert(addr);
-
-  if_walker = sr->if_list;
-  while(if_walker){
-    if (!memcpy(if_walker->addr,addr,ETHER_ADDR_LEN)){
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
-  return 0;
-}
-
-struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip){
-
-  assert(sr);
-  
-  struct sr_rt *lpm = 0;
-  struct sr_rt *rt_walker = 0;
-  uint32_t lpm_len = 0;
-
-  rt_walker = sr->routing_table;
-
-  while(rt_walker){
-    if((rt_walker->mask.s_addr & ip ) == (rt_walker->mask.s_addr & rt_walker->dest.s_addr)){
-      if(rt_walker->mask.s_addr >= lpm_len){
-        lpm = rt_walker;
-        lpm_len = rt_walker->mask.s_addr;
-      }
-    }
-    rt_walker = rt_walker->next;
-  }
-  return lpm;
-}
-
-
-    if (ip == if_walker->ip)
-    {
-      return if_walker;
-    }
-    if_walker = if_walker->next;
-  }
+  if ((unsigned int)ifindex < (unsigned int)sr->nif)
+    return sr->if_table[ifindex];
   return 0;
 }
 
@@ -2828,7 +880,7 @@ struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
 
   if_walker = sr->if_list;
   while(if_walker){
-    if (!memcpy(if_walker->addr,addr,ETHER_ADDR_LEN)){
+    if (!memcmp(if_walker->addr,addr,ETHER_ADDR_LEN)){
       return if_walker;
     }
     if_walker = if_walker->next;
@@ -2836,6 +888,8 @@ struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
   return 0;
 }
 
+/* a walk of the routing table as configured; packets are looked up in
+   the forwarding table compiled from it, sr_fib_lookup() */
 struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip){
 
   assert(sr);
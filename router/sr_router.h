@@ -11,10 +11,13 @@
 
 #include <netinet/in.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <stdio.h>
 
 #include "sr_protocol.h"
+#include "sr_if.h"
 #include "sr_arpcache.h"
+#include "sr_ratelimit.h"
 
 /* we dont like this debug , but what to do for varargs ? */
 #ifdef _DEBUG_
@@ -23,16 +26,24 @@
   do { int ivyl; for(ivyl=0; ivyl<5; ivyl++) printf("%02x:", \
   (unsigned char)(x[ivyl])); printf("%02x",(unsigned char)(x[5])); } while (0)
 #else
-#define Debug(x, args...) do{}while(0)
+/* still type-checked, and its arguments still count as used */
+#define Debug(x, args...) do{ if (0) printf(x, ## args); }while(0)
 #define DebugMAC(x) do{}while(0)
 #endif
 
 #define INIT_TTL 255
 #define PACKET_DUMP_SIZE 1024
+#define SR_SENDV_MAX 4          /* pieces sr_send_packetv() takes */
 
 /* forward declare */
 struct sr_if;
 struct sr_rt;
+struct sr_fib;
+struct sr_fib_entry;
+struct sr_adj;
+struct sr_pkt;
+struct sr_capture;
+struct sr_slow;
 
 /* ----------------------------------------------------------------------------
  * struct sr_instance
@@ -50,26 +61,34 @@ struct sr_instance
     unsigned short topo_id;
     struct sockaddr_in sr_addr; /* address to server */
     struct sr_if* if_list; /* list of interfaces */
+    struct sr_if* if_table[SR_IF_MAX]; /* the same, by ifindex */
+    int nif;                    /* interfaces in if_table */
     struct sr_rt* routing_table; /* routing table */
+    struct sr_fib* fib;         /* forwarding table built from it */
     struct sr_arpcache cache;   /* ARP cache */
+    struct sr_icmp_rl icmp_rl;  /* ICMP error token buckets */
+    struct sr_slow* slow;       /* slow path thread, 0 handles inline */
     pthread_attr_t attr;
-    FILE* logfile;
+    struct sr_capture* logfile; /* -l packet capture */
+    const char* mtus;           /* -M, applied when the interfaces arrive */
 };
 
 /* -- sr_main.c -- */
 int sr_verify_routing_table(struct sr_instance* sr);
 
 /* -- sr_vns_comm.c -- */
-int sr_send_packet(struct sr_instance* , uint8_t* , unsigned int , const char*);
+int sr_send_packet(struct sr_instance* , uint8_t* , unsigned int , struct sr_if*);
+int sr_send_packetv(struct sr_instance* , const struct iovec* , int , struct sr_if*);
 int sr_connect_to_server(struct sr_instance* ,unsigned short , char* );
 int sr_read_from_server(struct sr_instance* );
 
 /* -- sr_router.c -- */
 void sr_init(struct sr_instance* );
+int  sr_init_interfaces(struct sr_instance* );
 void sr_handlepacket(struct sr_instance* , uint8_t * , unsigned int , char* );
 
 /* -- sr_if.c -- */
-void sr_add_interface(struct sr_instance* , const char* );
+int  sr_add_interface(struct sr_instance* , const char* );
 void sr_set_ether_ip(struct sr_instance* , uint32_t );
 void sr_set_ether_addr(struct sr_instance* , const unsigned char* );
 void sr_print_if_list(struct sr_instance* );
@@ -78,33 +97,33 @@ void sr_print_if_list(struct sr_instance* );
 /* all my headers */
 
 void sr_handle_ip_packet(struct sr_instance *sr, 
-                         uint8_t *packet,
-			 unsigned int len,
-                         struct sr_if *interface);
+                         struct sr_pkt *pkt);
 struct sr_if *sr_get_interface_byIP(struct sr_instance *sr,
                                   uint32_t ip);
 struct sr_rt *sr_lpm(struct sr_instance *sr, uint32_t ip);
+void sr_handle_ip_exception(struct sr_instance *sr,
+                            struct sr_pkt *pkt,
+                            int why);
 void sr_ip_forward(struct sr_instance *sr, 
-                   uint8_t *packet, 
-                   unsigned int len);
+                   struct sr_pkt *pkt,
+                   const struct sr_fib_entry *fe);
 void sr_send_icmp(struct sr_instance *sr,
-                  uint8_t *packet,
-                  unsigned int len,
+                  struct sr_pkt *pkt,
                   uint8_t type,
-                  uint8_t code);
-void sr_ip_forward(struct sr_instance *sr, uint8_t *packet, unsigned int len);
+                  uint8_t code,
+                  uint16_t next_mtu);
 void sr_sending(struct sr_instance *sr,
                 uint8_t *packet,
                 unsigned int len,
                 struct sr_if *interface,
-                uint32_t ip);
+                uint32_t ip,
+                const struct sr_adj *adj);
 void sr_icmp_handler(struct sr_instance *sr,
-                     uint8_t *packet,
-                     unsigned int len);
+                     struct sr_pkt *pkt);
 void sr_handle_arp_packet(struct sr_instance *sr, 
                           uint8_t *packet,
                           unsigned int len,
-                          char *receiving_interface);
+                          struct sr_if *receive_interface);
 void sr_handle_arp_send_reply_to_requester(struct sr_instance *sr,
                                            uint8_t *packet,
                                            struct sr_if *receive_interface,
@@ -114,6 +133,8 @@ void sr_handle_arp_cache_reply(struct sr_instance *sr,
                                struct sr_if *interface_info);
 struct sr_if *sr_get_interface_byAddr(struct sr_instance *sr,
                                     const unsigned char *addr);
+struct sr_if *sr_get_interface_byIndex(struct sr_instance *sr,
+                                       int ifindex);
   
 
 #endif /* SR_ROUTER_H */
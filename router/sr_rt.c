@@ -94,11 +94,16 @@ void sr_add_rt_entry(struct sr_instance* sr, struct in_addr dest,
 struct in_addr gw, struct in_addr mask,char* if_name)
 {
     struct sr_rt* rt_walker = 0;
+    struct sr_if* if_entry = 0;
 
     /* -- REQUIRES -- */
     assert(if_name);
     assert(sr);
 
+    /* -- tables are usually loaded before the hardware info arrives,
+          sr_rt_bind_interfaces() fills the index in then -- */
+    if_entry = sr_get_interface(sr,if_name);
+
     /* -- empty list special case -- */
     if(sr->routing_table == 0)
     {
@@ -108,7 +113,9 @@ struct in_addr gw, struct in_addr mask,char* if_name)
         sr->routing_table->dest = dest;
         sr->routing_table->gw   = gw;
         sr->routing_table->mask = mask;
-        strncpy(sr->routing_table->interface,if_name,sr_IFACE_NAMELEN);
+        strncpy(sr->routing_table->interface,if_name,sr_IFACE_NAMELEN - 1);
+        sr->routing_table->interface[sr_IFACE_NAMELEN - 1] = 0;
+        sr->routing_table->ifindex = if_entry ? if_entry->ifindex : -1;
 
         return;
     }
@@ -127,10 +134,36 @@ struct in_addr gw, struct in_addr mask,char* if_name)
     rt_walker->dest = dest;
     rt_walker->gw   = gw;
     rt_walker->mask = mask;
-    strncpy(rt_walker->interface,if_name,sr_IFACE_NAMELEN);
+    strncpy(rt_walker->interface,if_name,sr_IFACE_NAMELEN - 1);
+    rt_walker->interface[sr_IFACE_NAMELEN - 1] = 0;
+    rt_walker->ifindex = if_entry ? if_entry->ifindex : -1;
 
 } /* -- sr_add_entry -- */
 
+/*---------------------------------------------------------------------
+ * Method: sr_rt_bind_interfaces(..)
+ * Scope: Global
+ *
+ * Resolve every entry's interface name to its ifindex, -1 for names
+ * the router doesn't have.  Called once the interfaces are known.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rt_bind_interfaces(struct sr_instance* sr)
+{
+    struct sr_rt* rt_walker = 0;
+    struct sr_if* if_entry = 0;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+
+    for(rt_walker = sr->routing_table; rt_walker; rt_walker = rt_walker->next)
+    {
+        if_entry = sr_get_interface(sr,rt_walker->interface);
+        rt_walker->ifindex = if_entry ? if_entry->ifindex : -1;
+    }
+} /* -- sr_rt_bind_interfaces -- */
+
 /*---------------------------------------------------------------------
  * Method:
  *
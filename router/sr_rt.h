@@ -32,7 +32,8 @@ struct sr_rt
     struct in_addr dest;
     struct in_addr gw;
     struct in_addr mask;
-    char   interface[sr_IFACE_NAMELEN];
+    char   interface[sr_IFACE_NAMELEN]; /* as configured */
+    int    ifindex;             /* the same, once the interface exists */
     struct sr_rt* next;
 };
 
@@ -42,6 +43,7 @@ void sr_add_rt_entry(struct sr_instance*, struct in_addr,struct in_addr,
                   struct in_addr, char*);
 void sr_print_routing_table(struct sr_instance* sr);
 void sr_print_routing_entry(struct sr_rt* entry);
+void sr_rt_bind_interfaces(struct sr_instance* sr);
 
 
 #endif  /* --  sr_RT_H -- */
@@ -0,0 +1,147 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_slow.c
+ *
+ * Description:
+ *
+ * Slow path thread, see sr_slow.h
+ *
+ * head and tail count packets ever queued and ever taken; each is
+ * written by one side only and published with release stores.  The
+ * thread sleeps on a semaphore posted once per packet, which costs the
+ * producer no system call unless the thread is actually asleep.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+
+#include "sr_slow.h"
+#include "sr_pkt.h"
+#include "sr_pbuf.h"
+#include "sr_router.h"
+
+struct sr_slow_ent
+{
+    struct sr_pkt pkt;
+    int why;
+};
+
+struct sr_slow
+{
+    struct sr_instance* sr;
+    struct sr_slow_ent ring[SR_SLOW_QLEN];
+    unsigned long head;         /* packets ever queued */
+    unsigned long tail;         /* packets ever taken */
+    sem_t ready;
+    pthread_t thread;
+    volatile int run;
+};
+
+static void* sr_slow_run(void* arg)
+{
+    struct sr_slow* slow = arg;
+    struct sr_slow_ent* e;
+    struct sched_param sp;
+    unsigned long tail;
+
+    /* only ever gets the time forwarding leaves */
+    memset(&sp, 0, sizeof(sp));
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+
+    for (;;)
+    {
+        while (sem_wait(&(slow->ready)) != 0)
+        { ; }
+        tail = slow->tail;
+        if (tail == __atomic_load_n(&(slow->head), __ATOMIC_ACQUIRE))
+        {
+            if (!slow->run)
+            { break; }
+            continue;
+        }
+
+        e = &(slow->ring[tail & (SR_SLOW_QLEN - 1)]);
+        sr_handle_ip_exception(slow->sr, &(e->pkt), e->why);
+        sr_pbuf_free(sr_pbuf_of(e->pkt.buf));
+        __atomic_store_n(&(slow->tail), tail + 1, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_slow_open(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_slow* sr_slow_open(struct sr_instance* sr)
+{
+    struct sr_slow* slow = calloc(1, sizeof(struct sr_slow));
+
+    /* REQUIRES */
+    assert(sr);
+
+    if (!slow)
+    { return 0; }
+    slow->sr = sr;
+    slow->run = 1;
+    if (sem_init(&(slow->ready), 0, 0) != 0)
+    {
+        free(slow);
+        return 0;
+    }
+    if (pthread_create(&(slow->thread), 0, sr_slow_run, slow) != 0)
+    {
+        sem_destroy(&(slow->ready));
+        free(slow);
+        return 0;
+    }
+    return slow;
+} /* -- sr_slow_open -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_slow_enqueue(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_slow_enqueue(struct sr_slow* slow, const struct sr_pkt* pkt, int why)
+{
+    unsigned long head = slow->head;
+    struct sr_slow_ent* e;
+
+    /* REQUIRES */
+    assert(sr_pbuf_of(pkt->buf));
+
+    if (head - __atomic_load_n(&(slow->tail), __ATOMIC_ACQUIRE) == SR_SLOW_QLEN)
+    { return -1; }
+
+    e = &(slow->ring[head & (SR_SLOW_QLEN - 1)]);
+    e->pkt = *pkt;
+    e->why = why;
+    sr_pbuf_ref(sr_pbuf_of(pkt->buf));
+    __atomic_store_n(&(slow->head), head + 1, __ATOMIC_RELEASE);
+    sem_post(&(slow->ready));
+    return 0;
+} /* -- sr_slow_enqueue -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_slow_close(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_slow_close(struct sr_slow* slow)
+{
+    if (!slow)
+    { return; }
+    slow->run = 0;
+    sem_post(&(slow->ready));
+    pthread_join(slow->thread, 0);
+    sem_destroy(&(slow->ready));
+    free(slow);
+} /* -- sr_slow_close -- */
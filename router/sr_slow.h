@@ -0,0 +1,51 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_slow.h
+ *
+ * Description:
+ *
+ * Slow path: a thread of its own, at idle priority, for the IPv4
+ * packets the fast path in sr_handle_ip_packet() won't take.  Those are
+ * packets addressed to the router, packets with options or fragment
+ * bits, packets whose TTL runs out here, and packets with no usable
+ * route.  These are the ones that need ICMP built, a second lookup or
+ * per-packet decisions, so a burst of them (a traceroute sweep, a
+ * fragment flood) costs this thread time rather than forwarding's.
+ *
+ * Packets are passed by reference to their pool buffer over a single
+ * producer, single consumer ring: the producer is the thread that calls
+ * sr_handlepacket().  A full ring drops the packet and counts it.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_SLOW_H
+#define SR_SLOW_H
+
+#define SR_SLOW_QLEN 512            /* packets waiting, power of two */
+
+struct sr_instance;
+struct sr_pkt;
+struct sr_slow;
+
+/* Why a packet left the fast path */
+enum sr_slow_why
+{
+    SR_SLOW_LOCAL,              /* addressed to us */
+    SR_SLOW_OPTIONS,            /* IHL over 5 */
+    SR_SLOW_FRAGMENT,           /* MF or a fragment offset */
+    SR_SLOW_TTL,                /* expires here */
+    SR_SLOW_NOROUTE,            /* nothing to forward it by */
+    SR_SLOW_MTU                 /* too big for the way out */
+};
+
+/* Starts sr's slow path thread, 0 if it can't be. */
+struct sr_slow* sr_slow_open(struct sr_instance* sr);
+
+/* Queues pkt, whose frame must be in a pool buffer, for the slow path
+   thread to hand to sr_handle_ip_exception(), taking a reference to the
+   buffer.  -1 if the ring is full. */
+int sr_slow_enqueue(struct sr_slow* slow, const struct sr_pkt* pkt, int why);
+
+/* Stops the thread, after it has handled what is queued. */
+void sr_slow_close(struct sr_slow* slow);
+
+#endif /* -- SR_SLOW_H -- */
@@ -0,0 +1,88 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_stats.c
+ *
+ * Description:
+ *
+ * Per thread router counters, see sr_stats.h
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sr_stats.h"
+
+#define SR_ST(id, name) name,
+const char* const sr_stat_names[SR_NSTATS] = { SR_STATS };
+#undef SR_ST
+
+__thread struct sr_stats_block* sr_stats_self = 0;
+
+/* blocks are only ever added, and live until exit since their threads do */
+static struct sr_stats_block* blocks = 0;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* counted into when a block can't be allocated, never read */
+static struct sr_stats_block sr_stats_lost;
+
+/*---------------------------------------------------------------------
+ * Method: sr_stats_attach(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_stats_block* sr_stats_attach(void)
+{
+    struct sr_stats_block* b;
+
+    if (posix_memalign((void**)&b, 64, sizeof(struct sr_stats_block)) != 0)
+    { return &sr_stats_lost; }
+    memset(b, 0, sizeof(struct sr_stats_block));
+
+    pthread_mutex_lock(&blocks_lock);
+    b->next = blocks;
+    __atomic_store_n(&blocks, b, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&blocks_lock);
+
+    return sr_stats_self = b;
+} /* -- sr_stats_attach -- */
+
+static void sr_stats_sum(int row, uint64_t out[SR_NSTATS])
+{
+    struct sr_stats_block* b;
+    int i;
+
+    for (b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next)
+    {
+        for (i = 0; i < SR_NSTATS; i++)
+        { out[i] += __atomic_load_n(&(b->row[row].c[i]), __ATOMIC_RELAXED); }
+    }
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_stats_read(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_stats_read(int ifindex, uint64_t out[SR_NSTATS])
+{
+    memset(out, 0, SR_NSTATS * sizeof(uint64_t));
+    sr_stats_sum(SR_STATS_ROW(ifindex), out);
+} /* -- sr_stats_read -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_stats_total(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_stats_total(uint64_t out[SR_NSTATS])
+{
+    int row;
+
+    memset(out, 0, SR_NSTATS * sizeof(uint64_t));
+    for (row = 0; row <= SR_STATS_MAXIF; row++)
+    { sr_stats_sum(row, out); }
+} /* -- sr_stats_total -- */
@@ -0,0 +1,93 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_stats.h
+ *
+ * Description:
+ *
+ * Router counters, kept per thread and per interface.  Each thread that
+ * counts gets its own block of cache line aligned rows, one row per
+ * ifindex plus one for packets on no known interface, and bumps them
+ * with plain non-atomic adds.  Readers sum the blocks of every thread;
+ * a read may be a few increments behind but never blocks a writer.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_STATS_H
+#define SR_STATS_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include "sr_if.h"
+
+#define SR_STATS_MAXIF SR_IF_MAX   /* every interface counted separately */
+
+/* every counter: id, exported name */
+#define SR_STATS \
+  SR_ST(SR_STAT_RX_PKTS,       "rx_packets") \
+  SR_ST(SR_STAT_RX_BYTES,      "rx_bytes") \
+  SR_ST(SR_STAT_TX_PKTS,       "tx_packets") \
+  SR_ST(SR_STAT_TX_BYTES,      "tx_bytes") \
+  SR_ST(SR_STAT_DROP_SHORT,    "drop_short_frame") \
+  SR_ST(SR_STAT_DROP_CKSUM,    "drop_bad_checksum") \
+  SR_ST(SR_STAT_DROP_BADHDR,   "drop_bad_header") \
+  SR_ST(SR_STAT_DROP_TTL,      "drop_ttl_expired") \
+  SR_ST(SR_STAT_DROP_NOROUTE,  "drop_no_route") \
+  SR_ST(SR_STAT_DROP_BCAST,    "drop_broadcast") \
+  SR_ST(SR_STAT_DROP_NOIF,     "drop_unknown_interface") \
+  SR_ST(SR_STAT_DROP_ARP,      "drop_arp_failed") \
+  SR_ST(SR_STAT_DROP_NOTUS,    "drop_arp_not_ours") \
+  SR_ST(SR_STAT_DROP_QUEUE,    "drop_queue_overflow") \
+  SR_ST(SR_STAT_DROP_SLOW,     "drop_slow_path_full") \
+  SR_ST(SR_STAT_DROP_DF,       "drop_frag_needed") \
+  SR_ST(SR_STAT_SLOW_PATH,     "slow_path_packets") \
+  SR_ST(SR_STAT_FRAG_OK,       "ip_fragmented") \
+  SR_ST(SR_STAT_FRAG_CREATED,  "ip_fragments_out") \
+  SR_ST(SR_STAT_ICMP_OUT,      "icmp_generated") \
+  SR_ST(SR_STAT_ICMP_LIMITED,  "icmp_rate_limited") \
+  SR_ST(SR_STAT_ARP_HIT,       "arp_hits") \
+  SR_ST(SR_STAT_ARP_MISS,      "arp_misses")
+
+#define SR_ST(id, name) id,
+enum sr_stat { SR_STATS SR_NSTATS };
+#undef SR_ST
+
+extern const char* const sr_stat_names[SR_NSTATS];
+
+struct sr_stats_row
+{
+    uint64_t c[SR_NSTATS];
+} __attribute__ ((aligned (64)));
+
+struct sr_stats_block
+{
+    struct sr_stats_row row[SR_STATS_MAXIF + 1];
+    struct sr_stats_block* next;
+};
+
+/* the calling thread's block, 0 until it first counts something */
+extern __thread struct sr_stats_block* sr_stats_self;
+
+/* Allocates and registers the calling thread's block. */
+struct sr_stats_block* sr_stats_attach(void);
+
+#define SR_STATS_ROW(ifindex) \
+  ((unsigned int)(ifindex) < SR_STATS_MAXIF ? (ifindex) : SR_STATS_MAXIF)
+
+#define sr_stat_add(ifindex, stat, n) \
+  ((sr_stats_self ? sr_stats_self : sr_stats_attach()) \
+     ->row[SR_STATS_ROW(ifindex)].c[(stat)] += (n))
+
+#define sr_stat_inc(ifindex, stat) sr_stat_add((ifindex), (stat), 1)
+
+/* Sums one interface's counters (-1 for no interface) over all threads. */
+void sr_stats_read(int ifindex, uint64_t out[SR_NSTATS]);
+
+/* Sums every interface's counters over all threads. */
+void sr_stats_total(uint64_t out[SR_NSTATS]);
+
+#endif /* -- SR_STATS_H -- */
@@ -0,0 +1,241 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_trace.c
+ *
+ * Description:
+ *
+ * Binary per-packet event trace, see sr_trace.h
+ *
+ * Each ring has a single producer (its thread) and a single consumer (the
+ * writer thread).  The producer owns head, the writer owns tail, and each
+ * only reads the other's index, so the only ordering needed is a release
+ * store of the index after the records it covers and an acquire load
+ * before reading them.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sr_trace.h"
+
+#define SR_TRACE_MASK  (SR_TRACE_RING_SZ - 1)
+#define SR_TRACE_IDLE  1000000L    /* ns the writer sleeps when idle */
+
+struct sr_trace_ring
+{
+    struct sr_trace_rec rec[SR_TRACE_RING_SZ];
+    uint32_t head __attribute__ ((aligned (64)));  /* next slot to fill */
+    uint32_t tail __attribute__ ((aligned (64)));  /* next slot to drain */
+    unsigned long dropped;      /* events lost to a full ring */
+    unsigned long reported;     /* drops already written to the file */
+    uint16_t id;
+    struct sr_trace_ring* next;
+};
+
+volatile int sr_trace_on = 0;
+
+static __thread struct sr_trace_ring* my_ring = 0;
+
+/* rings are only ever added, and live until exit since their threads do */
+static struct sr_trace_ring* rings = 0;
+static uint16_t nrings = 0;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE* trace_fp = 0;
+static pthread_t writer;
+static volatile int writer_run = 0;
+
+static uint64_t sr_trace_now(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct sr_trace_ring* sr_trace_ring_new(void)
+{
+    struct sr_trace_ring* r = calloc(1, sizeof(struct sr_trace_ring));
+
+    if (!r)
+    { return 0; }
+
+    pthread_mutex_lock(&rings_lock);
+    r->id = nrings++;
+    r->next = rings;
+    __atomic_store_n(&rings, r, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&rings_lock);
+
+    return my_ring = r;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_trace_write(..)
+ * Scope:  Global
+ *
+ * Called through sr_trace() from any thread.  The first event a thread
+ * records allocates its ring.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_trace_write(uint16_t event, int ifindex,
+                    uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    struct sr_trace_ring* r = my_ring;
+    struct sr_trace_rec* rec;
+    uint32_t head;
+
+    if (!r && !(r = sr_trace_ring_new()))
+    { return; }
+
+    head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= SR_TRACE_RING_SZ)
+    {
+        __atomic_store_n(&r->dropped, r->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    rec = &(r->rec[head & SR_TRACE_MASK]);
+    rec->ts = sr_trace_now(CLOCK_MONOTONIC);
+    rec->event = event;
+    rec->ifindex = ifindex;
+    rec->thread = r->id;
+    rec->pad = 0;
+    rec->arg[0] = a0;
+    rec->arg[1] = a1;
+    rec->arg[2] = a2;
+    rec->arg[3] = a3;
+
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+} /* -- sr_trace_write -- */
+
+/*---------------------------------------------------------------------
+ * writer thread: copy whatever each ring holds to the file
+ *---------------------------------------------------------------------*/
+
+static unsigned long sr_trace_drain(void)
+{
+    struct sr_trace_ring* r;
+    unsigned long n = 0;
+
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next)
+    {
+        uint32_t tail = r->tail;
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        unsigned long dropped;
+
+        /* at most two runs, before and after the wrap */
+        while (tail != head)
+        {
+            uint32_t idx = tail & SR_TRACE_MASK;
+            uint32_t cnt = head - tail;
+            if (cnt > SR_TRACE_RING_SZ - idx)
+            { cnt = SR_TRACE_RING_SZ - idx; }
+
+            fwrite(&(r->rec[idx]), sizeof(struct sr_trace_rec), cnt, trace_fp);
+            tail += cnt;
+            n += cnt;
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+
+        dropped = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+        if (dropped != r->reported)
+        {
+            struct sr_trace_rec rec;
+
+            memset(&rec, 0, sizeof(rec));
+            rec.ts = sr_trace_now(CLOCK_MONOTONIC);
+            rec.event = SR_TR_DROPPED;
+            rec.ifindex = -1;
+            rec.thread = r->id;
+            rec.arg[0] = dropped - r->reported;
+            fwrite(&rec, sizeof(rec), 1, trace_fp);
+            r->reported = dropped;
+            n++;
+        }
+    }
+    return n;
+}
+
+static void* sr_trace_writer(void* arg)
+{
+    struct timespec idle;
+
+    idle.tv_sec = 0;
+    idle.tv_nsec = SR_TRACE_IDLE;
+
+    while (writer_run)
+    {
+        if (!sr_trace_drain())
+        {
+            fflush(trace_fp);
+            nanosleep(&idle, 0);
+        }
+    }
+
+    sr_trace_drain();
+    fflush(trace_fp);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_trace_open(..)
+ * Scope:  Global
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_trace_open(const char* path)
+{
+    struct sr_trace_file_hdr hdr;
+
+    if (trace_fp)
+    { return -1; }
+
+    if (!(trace_fp = fopen(path, "wb")))
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SR_TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.rec_size = sizeof(struct sr_trace_rec);
+    hdr.nevents = SR_TR_NEVENTS;
+    hdr.realtime = sr_trace_now(CLOCK_REALTIME) - sr_trace_now(CLOCK_MONOTONIC);
+    fwrite(&hdr, sizeof(hdr), 1, trace_fp);
+
+    writer_run = 1;
+    if (pthread_create(&writer, 0, sr_trace_writer, 0) != 0)
+    {
+        writer_run = 0;
+        fclose(trace_fp);
+        trace_fp = 0;
+        return -1;
+    }
+
+    sr_trace_on = 1;
+    return 0;
+} /* -- sr_trace_open -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_trace_close(..)
+ * Scope:  Global
+ *
+ * Events recorded concurrently with the close may be left in a ring.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_trace_close(void)
+{
+    if (!trace_fp)
+    { return; }
+
+    sr_trace_on = 0;
+    writer_run = 0;
+    pthread_join(writer, 0);
+
+    fclose(trace_fp);
+    trace_fp = 0;
+} /* -- sr_trace_close -- */
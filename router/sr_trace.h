@@ -0,0 +1,109 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_trace.h
+ *
+ * Description:
+ *
+ * Binary per-packet event trace.  Each event is a fixed size record
+ * (timestamp, event id, ifindex, four arguments) pushed onto a ring owned
+ * by the calling thread, so recording one is a clock read and a 32 byte
+ * store with no locks or formatting.  A background thread drains every
+ * ring to the trace file; sr_tracedump pretty prints it offline.
+ *
+ * When tracing is off an event costs one predictable branch, so trace
+ * points can stay in the forwarding path.  If a ring is full the event is
+ * dropped and counted; the writer records the count in the file.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_TRACE_H
+#define SR_TRACE_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_TRACE_RING_SZ 4096      /* records per thread, power of two */
+
+/*
+ * Every event: id, name, argument spec.  The spec names the arguments in
+ * order, with the format sr_tracedump prints them in: d decimal, x hex,
+ * i IPv4 address (network byte order).
+ */
+#define SR_TRACE_EVENTS \
+  SR_TR(SR_TR_DROPPED,      "trace-dropped",   "records=d") \
+  SR_TR(SR_TR_RX,           "rx",              "len=d ethertype=x") \
+  SR_TR(SR_TR_RX_SHORT,     "rx-short",        "len=d") \
+  SR_TR(SR_TR_IP_BADLEN,    "ip-bad-len",      "len=d hl=d") \
+  SR_TR(SR_TR_IP_BADSUM,    "ip-bad-cksum",    "got=x want=x") \
+  SR_TR(SR_TR_IP_LOCAL,     "ip-local",        "src=i dst=i proto=d") \
+  SR_TR(SR_TR_IP_FORWARD,   "ip-forward",      "src=i dst=i ttl=d") \
+  SR_TR(SR_TR_TTL_EXPIRED,  "ttl-expired",     "src=i dst=i") \
+  SR_TR(SR_TR_NO_ROUTE,     "no-route",        "dst=i") \
+  SR_TR(SR_TR_ICMP_BAD,     "icmp-bad",        "len=d got=x want=x") \
+  SR_TR(SR_TR_ICMP_ECHO,    "icmp-echo",       "src=i") \
+  SR_TR(SR_TR_ICMP_ERR,     "icmp-error",      "dst=i type=d code=d") \
+  SR_TR(SR_TR_ICMP_LIMITED, "icmp-limited",    "dst=i type=d code=d") \
+  SR_TR(SR_TR_NOBUF,        "no-buffer",       "") \
+  SR_TR(SR_TR_ARP_HIT,      "arp-hit",         "nexthop=i len=d") \
+  SR_TR(SR_TR_ARP_MISS,     "arp-miss",        "nexthop=i len=d") \
+  SR_TR(SR_TR_ARP_BADLEN,   "arp-bad-len",     "len=d") \
+  SR_TR(SR_TR_ARP_REQ_IN,   "arp-request-in",  "sender=i target=i") \
+  SR_TR(SR_TR_ARP_REP_IN,   "arp-reply-in",    "sender=i") \
+  SR_TR(SR_TR_ARP_REP_OUT,  "arp-reply-out",   "target=i") \
+  SR_TR(SR_TR_ARP_REQ_OUT,  "arp-request-out", "target=i tries=d") \
+  SR_TR(SR_TR_ARP_FLUSH,    "arp-flush",       "nexthop=i len=d") \
+  SR_TR(SR_TR_IP_BCAST,     "ip-broadcast",    "src=i dst=i") \
+  SR_TR(SR_TR_IP_BADHDR,    "ip-bad-header",   "ver=d hl=d len=d") \
+  SR_TR(SR_TR_IP_SLOW,      "ip-slow-path",    "src=i dst=i why=d") \
+  SR_TR(SR_TR_SLOW_FULL,    "slow-path-full",  "why=d") \
+  SR_TR(SR_TR_IP_FRAG,      "ip-fragment",     "dst=i len=d mtu=d frags=d") \
+  SR_TR(SR_TR_NEEDS_FRAG,   "ip-needs-frag",   "dst=i len=d mtu=d")
+
+#define SR_TR(id, name, spec) id,
+enum sr_trace_event { SR_TRACE_EVENTS SR_TR_NEVENTS };
+#undef SR_TR
+
+/* one event, as stored in the rings and the file */
+struct sr_trace_rec
+{
+    uint64_t ts;                /* CLOCK_MONOTONIC, ns */
+    uint16_t event;
+    int16_t  ifindex;           /* -1 if none */
+    uint16_t thread;            /* ring the record came from */
+    uint16_t pad;
+    uint32_t arg[4];
+};
+
+/* file layout: this header, then records in per-ring bursts */
+#define SR_TRACE_MAGIC "SRTRACE1"
+
+struct sr_trace_file_hdr
+{
+    char     magic[8];
+    uint32_t rec_size;          /* sizeof(struct sr_trace_rec) */
+    uint32_t nevents;           /* SR_TR_NEVENTS of the writer */
+    uint64_t realtime;          /* CLOCK_REALTIME - CLOCK_MONOTONIC, ns */
+};
+
+/* non zero while a trace file is open */
+extern volatile int sr_trace_on;
+
+#define sr_trace(ev, ifindex, a0, a1, a2, a3) \
+  do { if (sr_trace_on) \
+         sr_trace_write((ev), (ifindex), (a0), (a1), (a2), (a3)); } while (0)
+
+/* Records one event on the calling thread's ring. Use sr_trace(). */
+void sr_trace_write(uint16_t event, int ifindex,
+                    uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/* Opens the trace file and starts the writer thread, 0 on success. */
+int sr_trace_open(const char* path);
+
+/* Stops the writer after draining every ring and closes the file. */
+void sr_trace_close(void);
+
+#endif /* -- SR_TRACE_H -- */
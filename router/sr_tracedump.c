@@ -0,0 +1,166 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_tracedump.c
+ *
+ * Description:
+ *
+ * Pretty prints a binary trace written by sr -b (see sr_trace.h).  The
+ * writer emits each thread's records in bursts, so they are sorted back
+ * into time order first.  Times are seconds since the first record, or
+ * wall clock with -a.
+ *
+ *   sr_tracedump [-a] trace_file
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sr_trace.h"
+
+#define SR_TR(id, name, spec) { name, spec },
+static const struct { const char* name; const char* spec; } events[] =
+{ SR_TRACE_EVENTS };
+#undef SR_TR
+
+static int by_time(const void* a, const void* b)
+{
+    const struct sr_trace_rec* ra = a;
+    const struct sr_trace_rec* rb = b;
+
+    if (ra->ts != rb->ts)
+    { return ra->ts < rb->ts ? -1 : 1; }
+    return (int)ra->thread - (int)rb->thread;
+}
+
+/* print the arguments named by an event's spec, "name=k name=k ..." */
+static void print_args(const char* spec, const uint32_t* arg)
+{
+    int i = 0;
+
+    while (*spec && i < 4)
+    {
+        const char* eq = strchr(spec, '=');
+        uint32_t v = arg[i++];
+        const unsigned char* ip = (const unsigned char*)&v;
+
+        if (!eq)
+        { break; }
+        printf(" %.*s=", (int)(eq - spec), spec);
+        switch (eq[1])
+        {
+            case 'x':
+                printf("%#x", v);
+                break;
+            case 'i':
+                printf("%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+                break;
+            default:
+                printf("%u", v);
+                break;
+        }
+        spec = eq + 2;
+        while (*spec == ' ')
+        { spec++; }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    struct sr_trace_file_hdr hdr;
+    struct sr_trace_rec* recs = 0;
+    size_t n = 0, cap = 0, i;
+    int c, wall = 0;
+    FILE* fp;
+
+    while ((c = getopt(argc, argv, "a")) != EOF)
+    {
+        if (c == 'a')
+        { wall = 1; }
+        else
+        {
+            fprintf(stderr, "usage: %s [-a] trace_file\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        fprintf(stderr, "usage: %s [-a] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    if (!(fp = fopen(argv[optind], "rb")))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, SR_TRACE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.rec_size != sizeof(struct sr_trace_rec))
+    {
+        fprintf(stderr, "%s: not a trace file from this version\n", argv[optind]);
+        return 1;
+    }
+
+    for (;;)
+    {
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 4096;
+            if (!(recs = realloc(recs, cap * sizeof(*recs))))
+            {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+        }
+        if (fread(&recs[n], sizeof(*recs), 1, fp) != 1)
+        { break; }
+        n++;
+    }
+    fclose(fp);
+
+    qsort(recs, n, sizeof(*recs), by_time);
+
+    for (i = 0; i < n; i++)
+    {
+        const struct sr_trace_rec* r = &recs[i];
+
+        if (wall)
+        {
+            uint64_t t = r->ts + hdr.realtime;
+            time_t secs = t / 1000000000ULL;
+            char buf[32];
+            strftime(buf, sizeof(buf), "%H:%M:%S", localtime(&secs));
+            printf("%s.%09u", buf, (unsigned)(t % 1000000000ULL));
+        }
+        else
+        {
+            uint64_t t = r->ts - recs[0].ts;
+            printf("%6u.%09u", (unsigned)(t / 1000000000ULL),
+                   (unsigned)(t % 1000000000ULL));
+        }
+
+        printf(" t%-2u", r->thread);
+        if (r->ifindex >= 0)
+        { printf(" if%-2d", r->ifindex); }
+        else
+        { printf(" -   "); }
+
+        if (r->event < SR_TR_NEVENTS)
+        {
+            printf(" %-16s", events[r->event].name);
+            print_args(events[r->event].spec, r->arg);
+        }
+        else
+        {
+            printf(" event-%-10u %#x %#x %#x %#x", r->event,
+                   r->arg[0], r->arg[1], r->arg[2], r->arg[3]);
+        }
+        printf("\n");
+    }
+
+    free(recs);
+    return 0;
+}
@@ -3,16 +3,19 @@
 #include <string.h>
 #include "sr_protocol.h"
 #include "sr_utils.h"
+#include "sr_cksum.h"
 
 
 uint16_t cksum (const void *_data, int len) {
-  const uint8_t *data = _data;
-  uint32_t sum;
+  return cksum_fold(cksum_add(0, _data, len));
+}
+
+/* summing itself is done by whichever kernel sr_cksum_init() picked */
+uint32_t cksum_add (uint32_t sum, const void *_data, int len) {
+  return sr_cksum_add(sum, _data, len);
+}
 
-  for (sum = 0;len >= 2; data += 2, len -= 2)
-    sum += data[0] << 8 | data[1];
-  if (len > 0)
-    sum += data[0] << 8;
+uint16_t cksum_fold (uint32_t sum) {
   while (sum > 0xffff)
     sum = (sum >> 16) + (sum & 0xffff);
   sum = htons (~sum);
@@ -20,6 +23,16 @@ uint16_t cksum (const void *_data, int len) {
 }
 
 
+/* RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m'). One's complement sums don't
+   care about byte order, so fields are used exactly as stored. */
+uint16_t cksum_update16 (uint16_t sum, uint16_t old, uint16_t new) {
+  uint32_t s = (uint16_t)~sum + (uint16_t)~old + new;
+  s = (s >> 16) + (s & 0xffff);
+  s += s >> 16;
+  return ~s;
+}
+
+
 uint16_t ethertype(uint8_t *buf) {
   sr_ethernet_hdr_t *ehdr = (sr_ethernet_hdr_t *)buf;
   return ntohs(ehdr->ether_type);
@@ -30,6 +30,15 @@
 
 uint16_t cksum(const void *_data, int len);
 
+/* running one's complement sum of len bytes on top of sum, unfolded */
+uint32_t cksum_add(uint32_t sum, const void *_data, int len);
+/* folds a cksum_add() result into a checksum field, as cksum() returns it */
+uint16_t cksum_fold(uint32_t sum);
+
+/* RFC 1624 incremental update of checksum field sum after a 16 bit
+   field changed from old to new. All values as they sit in the packet. */
+uint16_t cksum_update16(uint16_t sum, uint16_t old, uint16_t new);
+
 uint16_t ethertype(uint8_t *buf);
 uint8_t ip_protocol(uint8_t *buf);
 
@@ -33,22 +33,30 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include "sr_dumper.h"
+#include "sr_capture.h"
+#include "sr_stats.h"
+#include "sr_latency.h"
+#include "sr_log.h"
 #include "sr_router.h"
 #include "sr_if.h"
 #include "sr_protocol.h"
+#include "sr_pbuf.h"
 
 #include "sha1.h"
 #include "vnscommand.h"
 
-static void sr_log_packet(struct sr_instance* , uint8_t* , int );
+static void sr_log_packet(struct sr_instance* , uint8_t* , int , const char* ,
+                          int , int );
 static int  sr_arp_req_not_for_us(struct sr_instance* sr,
                                   uint8_t * packet /* lent */,
                                   unsigned int len,
-                                  char* interface  /* lent */);
+                                  struct sr_if* iface  /* lent */);
 int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd);
 
 /*-----------------------------------------------------------------------------
@@ -81,6 +89,7 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
     c_open_template ot;
     char* buf;
     uint32_t buf_len;
+    int nodelay = 1;
 
     /* REQUIRES */
     assert(sr);
@@ -121,6 +130,10 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
         return -1;
     }
 
+    /* frames go out one send() each; don't let Nagle hold them back
+       waiting on the server's delayed ACKs */
+    setsockopt(sr->sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
     /* wait for authentication to be completed (server sends the first message) */
     if(sr_read_from_server_expect(sr, VNS_AUTH_REQUEST)!= 1 ||
        sr_read_from_server_expect(sr, VNS_AUTH_STATUS) != 1)
@@ -170,6 +183,7 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
  *
  *
  * Read, from the server, the hardware information for the reserved host.
+ * -1 if the router can't be set up from it.
  *
  *---------------------------------------------------------------------------*/
 
@@ -177,6 +191,8 @@ int sr_handle_hwinfo(struct sr_instance* sr, c_hwinfo* hwinfo)
 {
     int num_entries;
     int i = 0;
+    int skip = 0; /* -- the entries of an interface we had no room for -- */
+    struct sr_if* if_walker = 0;
 
     /* REQUIRES */
     assert(sr);
@@ -188,6 +204,9 @@ int sr_handle_hwinfo(struct sr_instance* sr, c_hwinfo* hwinfo)
 
     for ( i=0; i<num_entries; i++ )
     {
+        if ( skip && ntohl(hwinfo->mHWInfo[i].mKey) != HWINTERFACE )
+        { continue; }
+
         switch( ntohl(hwinfo->mHWInfo[i].mKey))
         {
             case HWFIXEDIP:
@@ -196,7 +215,8 @@ int sr_handle_hwinfo(struct sr_instance* sr, c_hwinfo* hwinfo)
                 break;
             case HWINTERFACE:
                 /*Debug("INTERFACE: %s\n",hwinfo->mHWInfo[i].value);*/
-                sr_add_interface(sr,hwinfo->mHWInfo[i].value);
+                /* -- one too many is left out, not the router -- */
+                skip = sr_add_interface(sr,hwinfo->mHWInfo[i].value) != 0;
                 break;
             case HWSPEED:
                 /* Debug("Speed: %d\n",
@@ -226,6 +246,16 @@ int sr_handle_hwinfo(struct sr_instance* sr, c_hwinfo* hwinfo)
         } /* -- switch -- */
     } /* -- for -- */
 
+    if(sr_init_interfaces(sr) != 0)
+    { return -1; }
+
+    /* -- describe the interfaces to the capture, in ifindex order -- */
+    if(sr->logfile)
+    {
+        for(if_walker = sr->if_list; if_walker; if_walker = if_walker->next)
+        { sr_capture_interface(sr->logfile, if_walker->name); }
+    }
+
     printf("Router interfaces:\n");
     sr_print_if_list(sr);
 
@@ -274,7 +304,7 @@ int sr_handle_auth_request(struct sr_instance* sr, c_auth_request* req) {
         SHA1Input(&sha1, req->salt, ntohl(req->mLen) - sizeof(*req));
         SHA1Input(&sha1, (unsigned char*)auth_key, AUTH_KEY_LEN);
         if(!SHA1Result(&sha1)) {
-            fprintf(stderr, "SHA1 result could not be computed\n");
+            sr_log(SR_LOG_ERR, "SHA1 result could not be computed\n");
             return 0;
         }
 
@@ -314,7 +344,7 @@ int sr_handle_auth_status(struct sr_instance* sr, c_auth_status* status) {
     if(status->auth_ok)
         printf("successfully authenticated as %s\n", sr->user);
     else
-        fprintf(stderr, "Authentication failed as %s: %s\n", sr->user, status->msg);
+        sr_log(SR_LOG_ERR, "Authentication failed as %s: %s\n", sr->user, status->msg);
     return status->auth_ok;
 }
 
@@ -335,7 +365,10 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 {
     int command, len;
     unsigned char *buf = 0;
+    struct sr_pbuf *pb = 0;
     c_packet_ethernet_header* sr_pkt = 0;
+    struct sr_if* iface = 0;
+    char ifname[sr_IFACE_NAMELEN];
     int ret = 0, bytes_read = 0;
 
     /* REQUIRES */
@@ -362,6 +395,10 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
                 perror("recv(..):sr_client.c::sr_read_from_server");
                 return -1;
             }
+            if ( ret == 0 )
+            { /* -- server (or our signal handler) closed the socket -- */
+                return -1;
+            }
             bytes_read += ret;
         } while ( errno == EINTR); /* be mindful of signals */
 
@@ -371,14 +408,22 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 
     if ( len > 10000 || len < 0 )
     {
-        fprintf(stderr,"Error: command length to large %d\n",len);
+        sr_log(SR_LOG_ERR, "Error: command length to large %d\n",len);
         close(sr->sockfd);
         return -1;
     }
 
-    if((buf = malloc(len)) == 0)
+    /* -- packets land straight in a pool buffer, the VNS header ends up
+          as headroom in front of the frame.  Oversized control messages
+          (HWINFO, RTABLE, ...) and an exhausted pool fall back to malloc -- */
+    if(len <= SR_PBUF_ROOM && (pb = sr_pbuf_alloc()) != 0)
+    {
+        pb->headroom = 0;
+        buf = pb->data;
+    }
+    else if((buf = malloc(len)) == 0)
     {
-        fprintf(stderr,"Error: out of memory (sr_read_from_server)\n");
+        sr_log(SR_LOG_ERR, "Error: out of memory (sr_read_from_server)\n");
         return -1;
     }
 
@@ -398,7 +443,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             {
                 if ( errno == EINTR )
                 { continue; }
-                fprintf(stderr,"Error: failed reading command body %d\n",ret);
+                sr_log(SR_LOG_ERR, "Error: failed reading command body %d\n",ret);
                 close(sr->sockfd);
                 return -1;
             }
@@ -406,6 +451,13 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
         } while (errno == EINTR); /* be mindful of signals */
     }
 
+    /* -- latency is measured from here to sr_send_packet() -- */
+    if(pb)
+    {
+        pb->rx_ns = sr_latency_now();
+        pb->path = SR_LAT_FORWARD;
+    }
+
     /* My entry for most unreadable line of code - guido */
     /* ... you win - mc                                  */
     command = *(((int *)buf)+1) = ntohl(*(((int *)buf)+1));
@@ -413,7 +465,7 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
     /* make sure the command is what we expected if we were expecting something */
     if(expected_cmd && command!=expected_cmd) {
         if(command != VNSCLOSE) { /* VNSCLOSE is always ok */
-            fprintf(stderr, "Error: expected command %d but got %d\n", expected_cmd, command);
+            sr_log(SR_LOG_ERR, "Error: expected command %d but got %d\n", expected_cmd, command);
             return -1;
         }
     }
@@ -426,35 +478,65 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
         case VNSPACKET:
             sr_pkt = (c_packet_ethernet_header *)buf;
 
+            /* -- the header is reused as headroom when the frame is sent
+                  back out, so keep our own copy of the interface name -- */
+            memcpy(ifname, sr_pkt->mInterfaceName, sizeof(sr_pkt->mInterfaceName));
+            ifname[sizeof(sr_pkt->mInterfaceName)] = 0;
+
+            /* -- the only name lookup per frame, the router and its
+                  sends work by interface and ifindex -- */
+            iface = sr_get_interface(sr, ifname);
+
+            /* -- one we left out (past SR_IF_MAX) or never heard of -- */
+            if ( !iface )
+            {
+                sr_stat_inc(-1, SR_STAT_DROP_NOIF);
+                break;
+            }
+
             /* -- check if it is an ARP to another router if so drop   -- */
             if ( sr_arp_req_not_for_us(sr,
                     (buf+sizeof(c_packet_header)),
                     len - sizeof(c_packet_ethernet_header) +
                     sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base))) )
+                    iface) )
             { break; }
 
+            sr_stat_inc(iface->ifindex, SR_STAT_RX_PKTS);
+            sr_stat_add(iface->ifindex, SR_STAT_RX_BYTES,
+                    len - sizeof(c_packet_header));
+
+            if(pb)
+            {
+                pb->headroom = sizeof(c_packet_header);
+                pb->len = len - sizeof(c_packet_header);
+                pb->ifindex = iface->ifindex;
+            }
+
             /* -- log packet -- */
             sr_log_packet(sr, buf + sizeof(c_packet_header),
-                    ntohl(sr_pkt->mLen) - sizeof(c_packet_header));
+                    ntohl(sr_pkt->mLen) - sizeof(c_packet_header),
+                    ifname, iface->ifindex, SR_DUMP_IN);
 
             /* -- pass to router, student's code should take over here -- */
             sr_handlepacket(sr,
                     (buf+sizeof(c_packet_header)),
                     len - sizeof(c_packet_ethernet_header) +
                     sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base)));
+                    ifname);
 
             break;
 
             /* -------------        VNSCLOSE      -------------------- */
 
         case VNSCLOSE:
-            fprintf(stderr,"VNS server closed session.\n");
-            fprintf(stderr,"Reason: %s\n",((c_close*)buf)->mErrorMessage);
+            sr_log(SR_LOG_ERR, "VNS server closed session.\n");
+            sr_log(SR_LOG_ERR, "Reason: %s\n",((c_close*)buf)->mErrorMessage);
             sr_session_closed_help();
 
-            if(buf)
+            if(pb)
+            { sr_pbuf_free(pb); }
+            else if(buf)
             { free(buf); }
             return 0;
             break;
@@ -468,10 +550,14 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             /* -------------     VNSHWINFO     -------------------- */
 
         case VNSHWINFO:
-            sr_handle_hwinfo(sr,(c_hwinfo*)buf);
+            if(sr_handle_hwinfo(sr,(c_hwinfo*)buf) < 0)
+            { return -1; }
+            /* -- VNS says nothing of MTUs, ethernet's is assumed unless told -- */
+            if(sr->mtus && sr_set_mtus(sr, sr->mtus) != 0)
+            { return -1; }
             if(sr_verify_routing_table(sr) != 0)
             {
-                fprintf(stderr,"Routing table not consistent with hardware\n");
+                sr_log(SR_LOG_ERR, "Routing table not consistent with hardware\n");
                 return -1;
             }
             printf(" <-- Ready to process packets --> \n");
@@ -496,12 +582,14 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             break;
 
         default:
-            Debug("unknown command: %d\n", command);
+            sr_log(SR_LOG_WARN, "unknown command: %d\n", command);
             break;
 
     }/* -- switch -- */
 
-    if(buf)
+    if(pb)
+    { sr_pbuf_free(pb); }
+    else if(buf)
     { free(buf); }
     return ret;
 }/* -- sr_read_from_server -- */
@@ -517,26 +605,19 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 static int
 sr_ether_addrs_match_interface( struct sr_instance* sr, /* borrowed */
                                 uint8_t* buf, /* borrowed */
-                                const char* name /* borrowed */ )
+                                struct sr_if* iface /* borrowed */ )
 {
     struct sr_ethernet_hdr* ether_hdr = 0;
-    struct sr_if* iface = 0;
 
     /* -- REQUIRES -- */
     assert(sr);
     assert(buf);
-    assert(name);
+    assert(iface);
 
     ether_hdr = (struct sr_ethernet_hdr*)buf;
-    iface = sr_get_interface(sr, name);
-
-    if ( iface == 0 ){
-        fprintf( stderr, "** Error, interface %s, does not exist\n", name);
-        return 0;
-    }
 
     if ( memcmp( ether_hdr->ether_shost, iface->addr, ETHER_ADDR_LEN) != 0 ){
-        fprintf( stderr, "** Error, source address does not match interface\n");
+        sr_log(SR_LOG_ERR, "** Error, source address does not match interface\n");
         return 0;
     }
 
@@ -557,15 +638,23 @@ sr_ether_addrs_match_interface( struct sr_instance* sr, /* borrowed */
  * Send a packet (ethernet header included!) of length 'len' to the server
  * to be injected onto the wire.
  *
+ * Frames held in a pool buffer with enough headroom get the VNS header
+ * written in place in front of them, anything else goes out with a
+ * gathered write.  Either way nothing is copied or allocated.
+ *
  *---------------------------------------------------------------------------*/
 
 int sr_send_packet(struct sr_instance* sr /* borrowed */,
                          uint8_t* buf /* borrowed */ ,
                          unsigned int len,
-                         const char* iface /* borrowed */)
+                         struct sr_if* iface /* borrowed */)
 {
     c_packet_header *sr_pkt;
+    c_packet_header hdr;
+    struct sr_pbuf *pb;
+    struct iovec iov[2];
     unsigned int total_len =  len + (sizeof(c_packet_header));
+    ssize_t written;
 
     /* REQUIRES */
     assert(sr);
@@ -574,65 +663,162 @@ int sr_send_packet(struct sr_instance* sr /* borrowed */,
 
     /* don't waste my time ... */
     if ( len < sizeof(struct sr_ethernet_hdr) ){
-        fprintf(stderr , "** Error: packet is wayy to short \n");
+        sr_log(SR_LOG_ERR, "** Error: packet is wayy to short \n");
         return -1;
     }
 
-    /* Create packet */
-    sr_pkt = (c_packet_header *)malloc(len +
-            sizeof(c_packet_header));
-    assert(sr_pkt);
-    sr_pkt->mLen  = htonl(total_len);
-    sr_pkt->mType = htonl(VNSPACKET);
-    strncpy(sr_pkt->mInterfaceName,iface,16);
-    memcpy(((uint8_t*)sr_pkt) + sizeof(c_packet_header),
-            buf,len);
-
     /* -- log packet -- */
-    sr_log_packet(sr,buf,len);
+    sr_log_packet(sr,buf,len,iface->name,iface->ifindex,SR_DUMP_OUT);
 
     if ( ! sr_ether_addrs_match_interface( sr, buf, iface) ){
-        fprintf( stderr, "*** Error: problem with ethernet header, check log\n");
-        free ( sr_pkt );
+        sr_log(SR_LOG_ERR, "*** Error: problem with ethernet header, check log\n");
         return -1;
     }
 
-    if( write(sr->sockfd, sr_pkt, total_len) < total_len ){
-        fprintf(stderr, "Error writing packet\n");
-        free(sr_pkt);
+    /* Create packet header, in the headroom if there is any */
+    pb = sr_pbuf_of(buf);
+    if ( pb && buf - pb->data >= sizeof(c_packet_header) )
+    { sr_pkt = (c_packet_header *)(buf - sizeof(c_packet_header)); }
+    else
+    { sr_pkt = &hdr; }
+
+    sr_pkt->mLen  = htonl(total_len);
+    sr_pkt->mType = htonl(VNSPACKET);
+    /* a fixed 16 byte field, only NUL padded when there is room */
+    memset(sr_pkt->mInterfaceName, 0, sizeof(sr_pkt->mInterfaceName));
+    memcpy(sr_pkt->mInterfaceName, iface->name, strnlen(iface->name, sizeof(sr_pkt->mInterfaceName)));
+
+    if ( sr_pkt != &hdr )
+    { written = write(sr->sockfd, sr_pkt, total_len); }
+    else
+    {
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len  = sizeof(c_packet_header);
+        iov[1].iov_base = buf;
+        iov[1].iov_len  = len;
+        written = writev(sr->sockfd, iov, 2);
+    }
+
+    if( written < (ssize_t)total_len ){
+        sr_log(SR_LOG_ERR, "Error writing packet\n");
         return -1;
     }
 
-    free(sr_pkt);
+    sr_stat_inc(iface->ifindex, SR_STAT_TX_PKTS);
+    sr_stat_add(iface->ifindex, SR_STAT_TX_BYTES, len);
+
+    /* -- a timed frame counts once, on its first send -- */
+    if ( pb && pb->rx_ns )
+    {
+        sr_latency_record(pb->path, sr_latency_now() - pb->rx_ns);
+        pb->rx_ns = 0;
+    }
 
     return 0;
 } /* -- sr_send_packet -- */
 
+/*-----------------------------------------------------------------------------
+ * Method: sr_send_packetv(..)
+ * Scope: Global
+ *
+ * Send a frame held in pieces, the first of which starts with the
+ * ethernet header, as one VNS packet.  Fragments go out this way, their
+ * own headers in front of a slice of the original datagram, so the
+ * payload is never copied.  Only the capture log wants it flat.
+ *
+ *---------------------------------------------------------------------------*/
+
+int sr_send_packetv(struct sr_instance* sr /* borrowed */,
+                    const struct iovec* v /* borrowed */,
+                    int vcnt,
+                    struct sr_if* iface /* borrowed */)
+{
+    c_packet_header hdr;
+    struct iovec iov[SR_SENDV_MAX + 1];
+    unsigned int len = 0;
+    ssize_t written;
+    int i;
+
+    /* REQUIRES */
+    assert(sr);
+    assert(v);
+    assert(vcnt > 0 && vcnt <= SR_SENDV_MAX);
+    assert(iface);
+
+    for ( i = 0; i < vcnt; i++ )
+    { len += v[i].iov_len; }
+
+    if ( v[0].iov_len < sizeof(struct sr_ethernet_hdr) ){
+        sr_log(SR_LOG_ERR, "** Error: packet is wayy to short \n");
+        return -1;
+    }
+
+    /* -- log packet: the filter only reads the headers, so only those are
+          gathered (when split) to decide; the capture copies the pieces -- */
+    if ( sr->logfile )
+    {
+        uint8_t head[SR_FILTER_DEPTH];
+        const uint8_t *h = v[0].iov_base;
+        unsigned int hlen = min(len, SR_FILTER_DEPTH), n;
+
+        if ( v[0].iov_len < hlen )
+        {
+            for ( i = 0, n = 0; n < hlen; n += v[i].iov_len, i++ )
+            { memcpy(head + n, v[i].iov_base, min(v[i].iov_len, hlen - n)); }
+            h = head;
+        }
+        if ( sr_capture_wanted(sr->logfile, h, hlen, iface->name, SR_DUMP_OUT) )
+        { sr_capture_packetv(sr->logfile, v, vcnt, iface->ifindex, SR_DUMP_OUT); }
+    }
+
+    if ( ! sr_ether_addrs_match_interface( sr, v[0].iov_base, iface) ){
+        sr_log(SR_LOG_ERR, "*** Error: problem with ethernet header, check log\n");
+        return -1;
+    }
+
+    hdr.mLen  = htonl(len + sizeof(c_packet_header));
+    hdr.mType = htonl(VNSPACKET);
+    /* a fixed 16 byte field, only NUL padded when there is room */
+    memset(hdr.mInterfaceName, 0, sizeof(hdr.mInterfaceName));
+    memcpy(hdr.mInterfaceName, iface->name, strnlen(iface->name, sizeof(hdr.mInterfaceName)));
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len  = sizeof(c_packet_header);
+    memcpy(iov + 1, v, vcnt * sizeof(*v));
+    written = writev(sr->sockfd, iov, vcnt + 1);
+
+    if( written < (ssize_t)(len + sizeof(c_packet_header)) ){
+        sr_log(SR_LOG_ERR, "Error writing packet\n");
+        return -1;
+    }
+
+    sr_stat_inc(iface->ifindex, SR_STAT_TX_PKTS);
+    sr_stat_add(iface->ifindex, SR_STAT_TX_BYTES, len);
+
+    return 0;
+} /* -- sr_send_packetv -- */
+
 /*-----------------------------------------------------------------------------
  * Method: sr_log_packet()
  * Scope: Local
  *
  *---------------------------------------------------------------------------*/
 
-void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len )
+void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len,
+                   const char* iface, int ifindex, int dir)
 {
-    struct pcap_pkthdr h;
-    int size;
-
     /* REQUIRES */
     assert(sr);
 
     if(!sr->logfile)
     {return; }
 
-    size = min(PACKET_DUMP_SIZE, len);
-
-    gettimeofday(&h.ts, 0);
-    h.caplen = size;
-    h.len = (size < PACKET_DUMP_SIZE) ? size : PACKET_DUMP_SIZE;
+    /* -- filter and sampling decide before anything is looked up -- */
+    if(!sr_capture_wanted(sr->logfile, buf, len, iface, dir))
+    {return; }
 
-    sr_dump(sr->logfile, &h, buf);
-    fflush(sr->logfile);
+    /* -- snaplen (PACKET_DUMP_SIZE) is applied by the capture -- */
+    sr_capture_packet(sr->logfile, buf, len, ifindex, dir);
 } /* -- sr_log_packet -- */
 
 /*-----------------------------------------------------------------------------
@@ -644,9 +830,8 @@ void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len )
 int  sr_arp_req_not_for_us(struct sr_instance* sr,
                            uint8_t * packet /* lent */,
                            unsigned int len,
-                           char* interface  /* lent */)
+                           struct sr_if* iface  /* lent */)
 {
-    struct sr_if* iface = sr_get_interface(sr, interface);
     struct sr_ethernet_hdr* e_hdr = 0;
     struct sr_arp_hdr*       a_hdr = 0;
 
@@ -0,0 +1,893 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_vnsgen.c
+ *
+ * Description:
+ *
+ * A stand-in for the VNS server (POX, Mininet) that load tests sr end to
+ * end over the real socket path.  It listens where sr connects, goes
+ * through the handshake of vnscommand.h (auth request, auth status,
+ * VNSOPEN, HWINFO) and then plays every host of the topology at once:
+ * router ARP requests for a host are answered, and a mix of traffic is
+ * blasted in as VNSPACKETs while what comes back is matched to what was
+ * sent.
+ *
+ *   fwd      udp from the host behind one interface to the host behind
+ *            another, expected out of the other interface
+ *   ping     icmp echo to the router's own address, expecting the reply
+ *   ttl      udp with a ttl of 1, expecting icmp time exceeded
+ *   noroute  udp to 198.51.100.0/24, expecting icmp net unreachable
+ *            (needs a routing table without a default route)
+ *
+ * Every frame carries a sequence number (in the udp ports, or the echo
+ * id and sequence) that survives into icmp errors, so replies are matched
+ * exactly.  A frame not answered within -T ms (200) counts as lost; icmp
+ * errors sr's rate limit suppresses are lost too, and hold their place
+ * in the window until then.  At the end the session is closed, which
+ * ends sr, and the offered and delivered rates and per kind loss and
+ * round trip latency are reported.
+ *
+ *   sr_vnsgen [-p port] [-i iface file] [-R rtable out] [-m mix]
+ *             [-s frame size|imix] [-r pps] [-c count] [-d seconds]
+ *             [-w window] [-T timeout ms]
+ *
+ *   ./sr_vnsgen -R rtable -d 10 &
+ *   ./sr
+ *
+ * The interface file has one "name ip mac host_ip host_mac" line per
+ * interface, the router's side and then the single host behind it;
+ * without one the usual three interface lab topology is used.  -R
+ * writes the matching routing table, a host route per interface.  The
+ * mix is a list of weights, "fwd=80,ping=10,ttl=5,noroute=5"; frames go
+ * out as fast as the -w window of unanswered frames allows unless -r
+ * paces them.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "sr_protocol.h"
+#include "sr_utils.h"
+#include "sr_cksum.h"
+#include "vnscommand.h"
+
+#define GEN_MAXIF   16
+#define GEN_SLOTS   (1 << 20)               /* frames in flight, at most */
+#define GEN_OUTBUF  (16 * 1024)             /* queued towards sr */
+#define GEN_INBUF   (256 * 1024)
+#define GEN_MINLEN  (sizeof(sr_ethernet_hdr_t) + sizeof(sr_ip_hdr_t) + 8)
+#define GEN_MAXLEN  1514
+#define GEN_UDP     17
+
+enum { K_FWD, K_PING, K_TTL, K_NOROUTE, NKIND };
+
+static const char* kind_names[NKIND] = { "fwd", "ping", "ttl", "noroute" };
+
+struct gen_if
+{
+    char name[sr_IFACE_NAMELEN];
+    uint32_t ip;                        /* the router's side */
+    unsigned char mac[ETHER_ADDR_LEN];
+    uint32_t host_ip;                   /* the host behind it */
+    unsigned char host_mac[ETHER_ADDR_LEN];
+};
+
+struct slot
+{
+    uint32_t seq;
+    uint8_t kind;
+    uint8_t out;                        /* interface the answer is due on */
+    uint8_t done;
+    uint64_t t_ns;
+};
+
+struct kind_stats
+{
+    uint64_t sent, recv, lost;
+    uint64_t bytes_sent, bytes_recv;
+    uint32_t* lat;                      /* round trips in ns */
+    size_t nlat, caplat;
+};
+
+static struct gen_if ifs[GEN_MAXIF];
+static int nif = 0;
+
+static unsigned int weights[NKIND] = { 100, 0, 0, 0 };
+static unsigned int wtotal = 100;
+static unsigned int fixed_len = 98;     /* 0 for imix */
+
+static struct slot* slots;
+static uint32_t next_seq = 0;           /* next frame to send */
+static uint32_t tail = 0;               /* oldest frame not yet settled */
+static uint32_t inflight = 0;           /* sent and not yet settled */
+
+static struct kind_stats kstats[NKIND];
+static uint64_t arp_answered = 0, stale = 0, misrouted = 0, unexpected = 0;
+static uint64_t last_recv_ns = 0;
+
+static const char* default_ifs[][5] =
+{
+    { "eth1", "192.168.2.1", "02:00:00:00:01:01", "192.168.2.2", "02:00:00:00:01:02" },
+    { "eth2", "172.64.3.1",  "02:00:00:00:02:01", "172.64.3.10", "02:00:00:00:02:02" },
+    { "eth3", "10.0.1.1",    "02:00:00:00:03:01", "10.0.1.100",  "02:00:00:00:03:02" },
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* xorshift, so the same mix is generated every run */
+static uint32_t rnd_state = 2463534242U;
+static uint32_t rnd(void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/*---------------------------------------------------------------------
+ * setup
+ *---------------------------------------------------------------------*/
+
+static int parse_mac(const char* s, unsigned char* mac)
+{
+    unsigned int b[ETHER_ADDR_LEN];
+    int i;
+
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3],
+               &b[4], &b[5]) != ETHER_ADDR_LEN)
+    { return -1; }
+    for (i = 0; i < ETHER_ADDR_LEN; i++)
+    { mac[i] = b[i]; }
+    return 0;
+}
+
+static int add_if(const char* name, const char* ip, const char* mac,
+                  const char* host_ip, const char* host_mac)
+{
+    struct gen_if* gi = &(ifs[nif]);
+    struct in_addr in, host_in;
+
+    if (nif == GEN_MAXIF)
+    {
+        fprintf(stderr, "more than %d interfaces\n", GEN_MAXIF);
+        return -1;
+    }
+    if (strlen(name) >= sizeof(((c_packet_header*)0)->mInterfaceName) ||
+        !inet_aton(ip, &in) || parse_mac(mac, gi->mac) != 0 ||
+        !inet_aton(host_ip, &host_in) || parse_mac(host_mac, gi->host_mac) != 0)
+    {
+        fprintf(stderr, "bad interface %s %s %s %s %s\n", name, ip, mac,
+                host_ip, host_mac);
+        return -1;
+    }
+    strcpy(gi->name, name);
+    gi->ip = in.s_addr;
+    gi->host_ip = host_in.s_addr;
+    nif++;
+    return 0;
+}
+
+static int load_ifs(const char* fname)
+{
+    char line[256], name[64], ip[64], mac[64], hip[64], hmac[64];
+    FILE* fp;
+    unsigned int i;
+
+    if (!fname)
+    {
+        for (i = 0; i < sizeof(default_ifs) / sizeof(default_ifs[0]); i++)
+        {
+            add_if(default_ifs[i][0], default_ifs[i][1], default_ifs[i][2],
+                   default_ifs[i][3], default_ifs[i][4]);
+        }
+        return 0;
+    }
+
+    if (!(fp = fopen(fname, "r")))
+    {
+        perror(fname);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#' || sscanf(line, "%63s %63s %63s %63s %63s", name,
+                                     ip, mac, hip, hmac) != 5)
+        { continue; }
+        if (add_if(name, ip, mac, hip, hmac) != 0)
+        {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return nif ? 0 : -1;
+}
+
+static int write_rtable(const char* fname)
+{
+    FILE* fp = fopen(fname, "w");
+    struct in_addr in;
+    int i;
+
+    if (!fp)
+    {
+        perror(fname);
+        return -1;
+    }
+    for (i = 0; i < nif; i++)
+    {
+        in.s_addr = ifs[i].host_ip;
+        fprintf(fp, "%s ", inet_ntoa(in));
+        fprintf(fp, "%s 255.255.255.255 %s\n", inet_ntoa(in), ifs[i].name);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int parse_mix(char* s)
+{
+    char* tok;
+    char* eq;
+    int k;
+
+    memset(weights, 0, sizeof(weights));
+    wtotal = 0;
+    for (tok = strtok(s, ","); tok; tok = strtok(0, ","))
+    {
+        if (!(eq = strchr(tok, '=')))
+        { return -1; }
+        *eq = 0;
+        for (k = 0; k < NKIND; k++)
+        {
+            if (strcmp(tok, kind_names[k]) == 0)
+            { break; }
+        }
+        if (k == NKIND)
+        { return -1; }
+        weights[k] = atoi(eq + 1);
+        wtotal += weights[k];
+    }
+    return wtotal ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------
+ * the VNS side
+ *---------------------------------------------------------------------*/
+
+static int write_full(int fd, const void* buf, size_t n)
+{
+    const char* p = buf;
+    ssize_t w;
+
+    while (n > 0)
+    {
+        if ((w = send(fd, p, n, MSG_NOSIGNAL)) < 0)
+        {
+            if (errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        p += w;
+        n -= w;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void* buf, size_t n)
+{
+    char* p = buf;
+    ssize_t r;
+
+    while (n > 0)
+    {
+        if ((r = read(fd, p, n)) <= 0)
+        {
+            if (r < 0 && errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+static int send_msg(int fd, uint32_t type, const void* body, uint32_t len)
+{
+    c_base hdr;
+
+    hdr.mLen = htonl(sizeof(hdr) + len);
+    hdr.mType = htonl(type);
+    if (write_full(fd, &hdr, sizeof(hdr)) != 0 ||
+        (len && write_full(fd, body, len) != 0))
+    { return -1; }
+    return 0;
+}
+
+/* one whole message, blocking; its type, or -1 */
+static int read_msg(int fd, char* buf, uint32_t cap)
+{
+    c_base* hdr = (c_base*)buf;
+    uint32_t len;
+
+    if (read_full(fd, buf, sizeof(c_base)) != 0)
+    { return -1; }
+    len = ntohl(hdr->mLen);
+    if (len < sizeof(c_base) || len > cap ||
+        read_full(fd, buf + sizeof(c_base), len - sizeof(c_base)) != 0)
+    { return -1; }
+    return ntohl(hdr->mType);
+}
+
+static int handshake(int fd)
+{
+    static const char salt[] = "sr_vnsgen";
+    static const char ok[] = "\001ok";
+    c_hw_entry hw[3 * GEN_MAXIF];
+    char buf[4096];
+    int type, i, n = 0;
+
+    if (send_msg(fd, VNS_AUTH_REQUEST, salt, sizeof(salt) - 1) != 0 ||
+        read_msg(fd, buf, sizeof(buf)) != VNS_AUTH_REPLY ||
+        send_msg(fd, VNS_AUTH_STATUS, ok, sizeof(ok) - 1) != 0)
+    {
+        fprintf(stderr, "authentication failed\n");
+        return -1;
+    }
+    if ((type = read_msg(fd, buf, sizeof(buf))) != VNSOPEN)
+    {
+        fprintf(stderr, "expected VNSOPEN, got %d (templates are not served)\n",
+                type);
+        return -1;
+    }
+
+    memset(hw, 0, sizeof(hw));
+    for (i = 0; i < nif; i++)
+    {
+        hw[n].mKey = htonl(HWINTERFACE);
+        strcpy(hw[n++].value, ifs[i].name);
+        hw[n].mKey = htonl(HWETHER);
+        memcpy(hw[n++].value, ifs[i].mac, ETHER_ADDR_LEN);
+        hw[n].mKey = htonl(HWETHIP);
+        memcpy(hw[n++].value, &(ifs[i].ip), sizeof(uint32_t));
+    }
+    return send_msg(fd, VNSHWINFO, hw, n * sizeof(c_hw_entry));
+}
+
+/*---------------------------------------------------------------------
+ * traffic
+ *---------------------------------------------------------------------*/
+
+static unsigned int pick_len(void)
+{
+    unsigned int r;
+
+    if (fixed_len)
+    { return fixed_len; }
+    r = rnd() % 12;             /* simple imix, 7:4:1 */
+    return r < 7 ? 60 : r < 11 ? 590 : 1514;
+}
+
+static int pick_kind(void)
+{
+    unsigned int r = rnd() % wtotal;
+    int k;
+
+    for (k = 0; r >= weights[k]; k++)
+    { r -= weights[k]; }
+    return k;
+}
+
+/* the next frame into buf; its length, and the slot filled in */
+static unsigned int gen_frame(uint8_t* buf, struct slot* s, int* in)
+{
+    sr_ethernet_hdr_t* ehdr = (sr_ethernet_hdr_t*)buf;
+    sr_ip_hdr_t* ihdr = (sr_ip_hdr_t*)(buf + sizeof(sr_ethernet_hdr_t));
+    uint8_t* l4 = (uint8_t*)(ihdr + 1);
+    unsigned int len = pick_len();
+    uint16_t l4len = len - sizeof(sr_ethernet_hdr_t) - sizeof(sr_ip_hdr_t);
+    int a = rnd() % nif, b = (a + 1 + rnd() % (nif - 1 ? nif - 1 : 1)) % nif;
+    uint16_t v;
+
+    s->seq = next_seq;
+    s->kind = pick_kind();
+    s->out = s->kind == K_FWD ? b : a;
+    s->done = 0;
+    *in = a;
+
+    memset(buf, 0, len);
+    memcpy(ehdr->ether_dhost, ifs[a].mac, ETHER_ADDR_LEN);
+    memcpy(ehdr->ether_shost, ifs[a].host_mac, ETHER_ADDR_LEN);
+    ehdr->ether_type = htons(ethertype_ip);
+    ihdr->ip_v = 4;
+    ihdr->ip_hl = 5;
+    ihdr->ip_len = htons(len - sizeof(sr_ethernet_hdr_t));
+    ihdr->ip_id = htons(next_seq);
+    ihdr->ip_ttl = s->kind == K_TTL ? 1 : 64;
+    ihdr->ip_p = s->kind == K_PING ? ip_protocol_icmp : GEN_UDP;
+    ihdr->ip_src = ifs[a].host_ip;
+    ihdr->ip_dst = s->kind == K_PING ? ifs[a].ip :
+                   s->kind == K_NOROUTE ? htonl(0xc6336400 | (next_seq & 0xff)) :
+                   ifs[b].host_ip;
+    ihdr->ip_sum = cksum(ihdr, sizeof(sr_ip_hdr_t));
+
+    /* the sequence number goes where icmp errors quote it back */
+    v = htons(next_seq >> 16);
+    memcpy(l4 + (s->kind == K_PING ? 4 : 0), &v, 2);
+    v = htons(next_seq & 0xffff);
+    memcpy(l4 + (s->kind == K_PING ? 6 : 2), &v, 2);
+    if (s->kind == K_PING)
+    {
+        l4[0] = 8;              /* echo request */
+        v = cksum(l4, l4len);
+        memcpy(l4 + 2, &v, 2);
+    }
+    else
+    {
+        v = htons(l4len);
+        memcpy(l4 + 4, &v, 2);
+    }
+    return len;
+}
+
+static int find_if(const char* name)
+{
+    int i;
+
+    for (i = 0; i < nif; i++)
+    {
+        if (strncmp(ifs[i].name, name, sizeof(((c_packet_header*)0)->mInterfaceName)) == 0)
+        { return i; }
+    }
+    return -1;
+}
+
+static void add_sample(struct kind_stats* ks, uint64_t ns)
+{
+    if (ks->nlat == ks->caplat)
+    {
+        ks->caplat = ks->caplat ? ks->caplat * 2 : 4096;
+        if (!(ks->lat = realloc(ks->lat, ks->caplat * sizeof(uint32_t))))
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    ks->lat[ks->nlat++] = ns > 0xffffffffULL ? 0xffffffffU : (uint32_t)ns;
+}
+
+static void settle(uint32_t seq, int kind, int ifindex, unsigned int len,
+                   uint64_t now)
+{
+    struct slot* s = &(slots[seq & (GEN_SLOTS - 1)]);
+
+    if (seq - tail >= next_seq - tail || s->seq != seq || s->done)
+    {
+        stale++;                /* late, duplicated or never sent */
+        return;
+    }
+    if (s->kind != kind || s->out != ifindex)
+    {
+        misrouted++;
+        return;
+    }
+    s->done = 1;
+    inflight--;
+    kstats[kind].recv++;
+    kstats[kind].bytes_recv += len;
+    add_sample(&(kstats[kind]), now - s->t_ns);
+    last_recv_ns = now;
+}
+
+/* what the router sent out of interface i */
+static void handle_frame(int fd, int i, uint8_t* frame, unsigned int len,
+                         uint64_t now)
+{
+    sr_ethernet_hdr_t* ehdr = (sr_ethernet_hdr_t*)frame;
+    sr_ip_hdr_t* ihdr = (sr_ip_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+    uint8_t* l4;
+    uint16_t hi, lo;
+
+    if (i < 0 || len < sizeof(sr_ethernet_hdr_t))
+    {
+        unexpected++;
+        return;
+    }
+
+    if (ntohs(ehdr->ether_type) == ethertype_arp &&
+        len >= sizeof(sr_ethernet_hdr_t) + sizeof(sr_arp_hdr_t))
+    {
+        sr_arp_hdr_t* ahdr = (sr_arp_hdr_t*)(frame + sizeof(sr_ethernet_hdr_t));
+        struct
+        {
+            c_packet_header hdr;
+            sr_ethernet_hdr_t eth;
+            sr_arp_hdr_t arp;
+        } __attribute__ ((packed)) reply;
+
+        if (ntohs(ahdr->ar_op) != arp_op_request || ahdr->ar_tip != ifs[i].host_ip)
+        {
+            unexpected++;
+            return;
+        }
+        memset(&reply, 0, sizeof(reply));
+        reply.hdr.mLen = htonl(sizeof(reply));
+        reply.hdr.mType = htonl(VNSPACKET);
+        strcpy(reply.hdr.mInterfaceName, ifs[i].name);
+        memcpy(reply.eth.ether_dhost, ahdr->ar_sha, ETHER_ADDR_LEN);
+        memcpy(reply.eth.ether_shost, ifs[i].host_mac, ETHER_ADDR_LEN);
+        reply.eth.ether_type = htons(ethertype_arp);
+        reply.arp = *ahdr;
+        reply.arp.ar_op = htons(arp_op_reply);
+        memcpy(reply.arp.ar_sha, ifs[i].host_mac, ETHER_ADDR_LEN);
+        reply.arp.ar_sip = ifs[i].host_ip;
+        memcpy(reply.arp.ar_tha, ahdr->ar_sha, ETHER_ADDR_LEN);
+        reply.arp.ar_tip = ahdr->ar_sip;
+        /* small and rare, so sent straight away past the queue */
+        if (write_full(fd, &reply, sizeof(reply)) == 0)
+        { arp_answered++; }
+        return;
+    }
+
+    if (ntohs(ehdr->ether_type) != ethertype_ip || len < GEN_MINLEN ||
+        ihdr->ip_hl != 5 || cksum(ihdr, sizeof(sr_ip_hdr_t)) != 0xffff)
+    {
+        unexpected++;
+        return;
+    }
+    l4 = (uint8_t*)(ihdr + 1);
+
+    if (ihdr->ip_p == GEN_UDP)
+    {
+        memcpy(&hi, l4, 2);
+        memcpy(&lo, l4 + 2, 2);
+        settle(((uint32_t)ntohs(hi) << 16) | ntohs(lo), K_FWD, i, len, now);
+        return;
+    }
+    if (ihdr->ip_p == ip_protocol_icmp && l4[0] == 0)
+    {
+        memcpy(&hi, l4 + 4, 2);
+        memcpy(&lo, l4 + 6, 2);
+        settle(((uint32_t)ntohs(hi) << 16) | ntohs(lo), K_PING, i, len, now);
+        return;
+    }
+    if (ihdr->ip_p == ip_protocol_icmp && (l4[0] == 3 || l4[0] == 11) &&
+        len >= GEN_MINLEN + sizeof(sr_ip_hdr_t) + 4)
+    {
+        /* quoted ip header, then the udp ports */
+        memcpy(&hi, l4 + 8 + sizeof(sr_ip_hdr_t), 2);
+        memcpy(&lo, l4 + 10 + sizeof(sr_ip_hdr_t), 2);
+        settle(((uint32_t)ntohs(hi) << 16) | ntohs(lo),
+               l4[0] == 11 ? K_TTL : K_NOROUTE, i, len, now);
+        return;
+    }
+    unexpected++;
+}
+
+/* retire settled frames in order; one unanswered past the timeout is lost */
+static void expire(uint64_t now, uint64_t timeout_ns)
+{
+    struct slot* s;
+
+    while (tail != next_seq)
+    {
+        s = &(slots[tail & (GEN_SLOTS - 1)]);
+        if (!s->done)
+        {
+            if (now - s->t_ns < timeout_ns)
+            { break; }
+            kstats[s->kind].lost++;
+            inflight--;
+        }
+        tail++;
+    }
+}
+
+/*---------------------------------------------------------------------
+ * report
+ *---------------------------------------------------------------------*/
+
+static int cmp_u32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct(const struct kind_stats* ks, double q)
+{
+    size_t i = (size_t)(q * ks->nlat);
+
+    return ks->lat[i < ks->nlat ? i : ks->nlat - 1] / 1e3;
+}
+
+static void report(uint64_t start, uint64_t gen_end)
+{
+    uint64_t sent = 0, recv = 0, bsent = 0, brecv = 0;
+    double gen_s = (gen_end - start) / 1e9;
+    double recv_s = last_recv_ns > start ? (last_recv_ns - start) / 1e9 : 0;
+    struct kind_stats* ks;
+    int k;
+
+    for (k = 0; k < NKIND; k++)
+    {
+        sent += kstats[k].sent;
+        recv += kstats[k].recv;
+        bsent += kstats[k].bytes_sent;
+        brecv += kstats[k].bytes_recv;
+    }
+    printf("sent %llu frames in %.3fs: %.0f frames/s, %.1f Mbit/s offered\n",
+           (unsigned long long)sent, gen_s, gen_s ? sent / gen_s : 0,
+           gen_s ? bsent * 8 / gen_s / 1e6 : 0);
+    printf("answered %llu frames in %.3fs: %.0f frames/s, %.1f Mbit/s delivered\n",
+           (unsigned long long)recv, recv_s, recv_s ? recv / recv_s : 0,
+           recv_s ? brecv * 8 / recv_s / 1e6 : 0);
+
+    for (k = 0; k < NKIND; k++)
+    {
+        ks = &(kstats[k]);
+        if (ks->sent == 0)
+        { continue; }
+        printf("%-8s sent=%llu answered=%llu lost=%llu (%.2f%%)",
+               kind_names[k], (unsigned long long)ks->sent,
+               (unsigned long long)ks->recv, (unsigned long long)ks->lost,
+               100.0 * ks->lost / ks->sent);
+        if (ks->nlat)
+        {
+            qsort(ks->lat, ks->nlat, sizeof(uint32_t), cmp_u32);
+            printf(" rtt p50=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+                   pct(ks, 0.5), pct(ks, 0.99), pct(ks, 0.999),
+                   ks->lat[ks->nlat - 1] / 1e3);
+        }
+        printf("\n");
+    }
+    printf("arp requests answered=%llu misrouted=%llu stale=%llu unexpected=%llu\n",
+           (unsigned long long)arp_answered, (unsigned long long)misrouted,
+           (unsigned long long)stale, (unsigned long long)unexpected);
+}
+
+/*---------------------------------------------------------------------
+ * main loop
+ *---------------------------------------------------------------------*/
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [-p port] [-i iface file] [-R rtable out] [-m mix]\n"
+                    "          [-s frame size|imix] [-r pps] [-c count] [-d seconds]\n"
+                    "          [-w window] [-T timeout ms]\n", argv0);
+}
+
+static int listen_on(unsigned short port)
+{
+    struct sockaddr_in addr;
+    int fd, on = 1;
+
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned short port = 8888;
+    const char* iffile = 0;
+    const char* rtout = 0;
+    uint64_t count = 0, rate = 0, window = 256, timeout_ns = 200000000ULL;
+    double duration = 0;
+    uint64_t start, now, gen_end = 0, deadline;
+    static char outbuf[GEN_OUTBUF + sizeof(c_packet_header) + GEN_MAXLEN];
+    static char inbuf[GEN_INBUF];
+    size_t outlen = 0, inlen = 0;
+    int lfd, fd, c, on = 1, done = 0, in;
+    struct pollfd pfd;
+    c_close bye;
+    ssize_t r;
+
+    while ((c = getopt(argc, argv, "p:i:R:m:s:r:c:d:w:T:h")) != EOF)
+    {
+        switch (c)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 'i': iffile = optarg; break;
+            case 'R': rtout = optarg; break;
+            case 'm':
+                if (parse_mix(optarg) != 0)
+                {
+                    fprintf(stderr, "bad mix, want fwd=N,ping=N,ttl=N,noroute=N\n");
+                    return 1;
+                }
+                break;
+            case 's': fixed_len = strcmp(optarg, "imix") ? atoi(optarg) : 0; break;
+            case 'r': rate = strtoull(optarg, 0, 10); break;
+            case 'c': count = strtoull(optarg, 0, 10); break;
+            case 'd': duration = atof(optarg); break;
+            case 'w': window = strtoull(optarg, 0, 10); break;
+            case 'T': timeout_ns = strtoull(optarg, 0, 10) * 1000000ULL; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (count == 0 && duration <= 0)
+    { count = 100000; }
+    if (fixed_len && (fixed_len < GEN_MINLEN || fixed_len > GEN_MAXLEN))
+    {
+        fprintf(stderr, "frame size must be %u..%u\n", (unsigned int)GEN_MINLEN,
+                GEN_MAXLEN);
+        return 1;
+    }
+    if (window == 0 || window > GEN_SLOTS)
+    { window = GEN_SLOTS; }
+
+    sr_cksum_init();
+    if (load_ifs(iffile) != 0 || (rtout && write_rtable(rtout) != 0))
+    { return 1; }
+    if (nif < 2 && (weights[K_FWD] || weights[K_TTL]))
+    {
+        fprintf(stderr, "fwd and ttl need two interfaces\n");
+        return 1;
+    }
+    if (!(slots = calloc(GEN_SLOTS, sizeof(struct slot))))
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    if ((lfd = listen_on(port)) < 0)
+    { return 1; }
+    printf("waiting for sr on port %u\n", port);
+    fflush(stdout);
+    if ((fd = accept(lfd, 0, 0)) < 0)
+    {
+        perror("accept");
+        return 1;
+    }
+    close(lfd);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (handshake(fd) != 0)
+    { return 1; }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    start = now_ns();
+    deadline = start + (uint64_t)(duration * 1e9);
+    while (!done)
+    {
+        now = now_ns();
+        expire(now, timeout_ns);
+
+        /* -- generate while the window, the pacing and the queue allow -- */
+        while (!gen_end && outlen < GEN_OUTBUF && inflight < window &&
+               next_seq - tail < GEN_SLOTS &&
+               (!rate || next_seq < rate * (now - start) / 1000000000ULL + 1))
+        {
+            c_packet_header* ph = (c_packet_header*)(outbuf + outlen);
+            struct slot* s = &(slots[next_seq & (GEN_SLOTS - 1)]);
+            unsigned int len = gen_frame((uint8_t*)(ph + 1), s, &in);
+
+            ph->mLen = htonl(sizeof(c_packet_header) + len);
+            ph->mType = htonl(VNSPACKET);
+            memset(ph->mInterfaceName, 0, sizeof(ph->mInterfaceName));
+            strcpy(ph->mInterfaceName, ifs[in].name);
+            outlen += sizeof(c_packet_header) + len;
+            s->t_ns = now;
+            kstats[s->kind].sent++;
+            kstats[s->kind].bytes_sent += len;
+            next_seq++;
+            inflight++;
+            if ((count && next_seq == count) || (duration > 0 && now >= deadline))
+            { gen_end = now; }
+        }
+        if (!gen_end && duration > 0 && now >= deadline)
+        { gen_end = now; }
+        if (gen_end && tail == next_seq && outlen == 0)
+        { break; }
+
+        pfd.fd = fd;
+        pfd.events = POLLIN | (outlen ? POLLOUT : 0);
+        if (poll(&pfd, 1, 1) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        if ((pfd.revents & POLLOUT) && outlen)
+        {
+            if ((r = send(fd, outbuf, outlen, MSG_NOSIGNAL)) > 0)
+            {
+                memmove(outbuf, outbuf + r, outlen - r);
+                outlen -= r;
+            }
+            else if (r < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                perror("send");
+                break;
+            }
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            size_t off = 0;
+            uint32_t mlen;
+
+            if ((r = read(fd, inbuf + inlen, sizeof(inbuf) - inlen)) == 0)
+            {
+                fprintf(stderr, "sr closed the connection\n");
+                done = 1;
+            }
+            else if (r < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                perror("read");
+                done = 1;
+            }
+            else if (r > 0)
+            {
+                inlen += r;
+                now = now_ns();
+                while (inlen - off >= sizeof(c_packet_header))
+                {
+                    c_packet_header* ph = (c_packet_header*)(inbuf + off);
+
+                    mlen = ntohl(ph->mLen);
+                    if (mlen < sizeof(c_base) || mlen > sizeof(inbuf))
+                    {
+                        fprintf(stderr, "bad message length %u\n", mlen);
+                        return 1;
+                    }
+                    if (inlen - off < mlen)
+                    { break; }
+                    if (ntohl(ph->mType) == VNSPACKET)
+                    {
+                        handle_frame(fd, find_if(ph->mInterfaceName),
+                                     (uint8_t*)(ph + 1),
+                                     mlen - sizeof(c_packet_header), now);
+                    }
+                    off += mlen;
+                }
+                memmove(inbuf, inbuf + off, inlen - off);
+                inlen -= off;
+            }
+        }
+    }
+    if (!gen_end)
+    { gen_end = now_ns(); }
+
+    /* -- closing the session ends sr -- */
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    memset(&bye, 0, sizeof(bye));
+    bye.mLen = htonl(sizeof(bye));
+    bye.mType = htonl(VNSCLOSE);
+    strcpy(bye.mErrorMessage, "sr_vnsgen done");
+    write_full(fd, &bye, sizeof(bye));
+    close(fd);
+
+    report(start, gen_end);
+    return 0;
+}